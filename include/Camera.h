@@ -26,6 +26,8 @@ public:
     void yaw(float angle);
     void pitch(float angle);
     void roll(float angle);
+    // absolute orientation in degrees with up = +y: yaw 0 looks along +x, positive yaw turns towards +z, positive pitch looks up
+    void set_yaw_pitch(float yaw_degree, float pitch_degree);
 
     // data
     glm::vec3 pos, dir, up;             // camera coordinate system
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Camera.h"
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// ----------------------------------------------------
+// CameraPath
+// Scripted camera flight through position and yaw/pitch keyframes, linearly
+// interpolated. Text format, one keyframe per line, '#' starts a comment:
+//     time_s  x y z  yaw_degree pitch_degree
+
+class CameraPath {
+public:
+    struct Keyframe {
+        float time;
+        glm::vec3 pos;
+        float yaw, pitch;               // degrees, see Camera::set_yaw_pitch()
+    };
+
+    CameraPath() = default;
+    CameraPath(std::vector<Keyframe> keyframes);
+    virtual ~CameraPath();
+
+    static CameraPath load(const std::string& fileName);
+    void save(const std::string& fileName) const;
+
+    // circles the origin at the given radius and height, looking at the center
+    static CameraPath createOrbit(float radius, float height, float duration, int keyframeCount = 16);
+
+    // moves the camera to the pose at time (clamped to the path) and updates its matrices
+    void apply(Camera& camera, float time) const;
+
+    float getDuration() const { return keyframes.empty() ? 0.0f : keyframes.back().time - keyframes.front().time; }
+    float getStartTime() const { return keyframes.empty() ? 0.0f : keyframes.front().time; }
+    const std::vector<Keyframe>& getKeyframes() const { return keyframes; }
+
+private:
+    std::vector<Keyframe> keyframes;    // sorted by time
+};
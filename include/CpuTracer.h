@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Camera.h"
+#include "PacketTracer.h"
+#include "VoxelWorld.h"
+#include "TraceSettings.h"
+#include "Sampler.h"
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// ----------------------------------------------------
+// CpuTracer
+// C++ mirror of the per-pixel path in trace.glsl. Serves as golden-image
+// oracle for the GPU path and as fallback renderer without a usable Vulkan device.
+
+class CpuTracer {
+public:
+    // world has to outlive the tracer; threadCount 0: one worker per hardware thread
+    CpuTracer(const VoxelWorld& world, uint32_t threadCount = 0);
+    virtual ~CpuTracer();
+
+    // traces a full frame, image is linear RGBA with the top row first
+    void render(const Camera& camera, uint32_t width, uint32_t height, std::vector<glm::vec4>& image);
+
+    uint32_t getThreadCount() const { return threadCount; }
+
+    TraceSettings settings;
+    uint32_t tileSize = 16;             // tiles are square, edge length in pixels
+    SimdIsa isa = detectSimdIsa();      // SCALAR disables packet traversal
+    SamplerType sampler = SamplerType::SOBOL;
+    // frames traced before with the same settings.time, the samples continue their sequence
+    uint32_t accumulatedFrames = 0;
+
+    // state of a single ray between two iterations of the DDA loop
+    struct RayState {
+        glm::vec3 rayPos, rayDir;
+        glm::vec3 deltaDist, sideDist;
+        glm::ivec3 currentVoxel, step;
+        glm::bvec3 mask;
+        glm::vec3 throughput;
+        bool last_water;
+        int i;
+        int totalReflectionCount;
+        int diffuseBounces;
+        SampleStream samples;           // the jitter is drawn, the bounces draw the rest
+    };
+
+    // paths ended by the bounce cap or Russian roulette count as MISSED
+    enum class RayStatus { MARCHING, HIT, MISSED };
+
+private:
+    // per frame constants shared by all workers
+    struct FrameInfo {
+        glm::mat4 PInv, VInv;
+        glm::vec3 pos;
+        uint32_t sampleSeed;
+        uint32_t firstSample;           // index of the frame's first sample in the sequence of every pixel
+        uint32_t width, height;
+        uint32_t tilesX, tilesY;
+        MarchPacketFunc marchPacket;    // nullptr: scalar traversal
+        VoxelGridView grid;
+    };
+
+    // range of tiles owned by a worker, begin in the upper and end in the lower 32 bit
+    struct alignas(64) WorkQueue {
+        std::atomic<uint64_t> range{ 0 };
+    };
+
+    const VoxelWorld& world;
+    uint32_t threadCount;
+
+    std::vector<glm::uvec2> tileOrder;  // tile coordinates in Z-order
+    std::unique_ptr<WorkQueue[]> queues;
+
+    bool popTile(uint32_t worker, uint32_t& tile);
+    bool stealTiles(uint32_t worker);
+    void workerLoop(uint32_t worker, const FrameInfo& frame, glm::vec4* image);
+    void traceTile(const FrameInfo& frame, glm::uvec2 tile, glm::vec4* image) const;
+    void tracePacket(const FrameInfo& frame, glm::uvec2 from, glm::uvec2 to, uint32_t blockWidth, glm::vec4* image) const;
+    glm::vec4 tracePixel(const FrameInfo& frame, glm::uvec2 pixel) const;
+
+    static glm::vec2 pixelUV(const FrameInfo& frame, uint32_t x, uint32_t y);
+    // ray of the given sample through the jittered pixel
+    RayState startRay(const FrameInfo& frame, glm::uvec2 pixel, int sampling) const;
+    RayStatus iterate(RayState& ray) const;
+    RayStatus finishRay(RayState& ray) const;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <chrono>
+#include <cstdint>
+
+// ----------------------------------------------------
+// FrameRecorder
+// Writes a stream of captured frames to disk on worker threads, so encoding
+// never runs on the render loop. Frames are linear float RGBA as traced; PNG,
+// PPM and raw output are sRGB encoded, EXR keeps the linear values.
+
+enum class CaptureFormat {
+    PNG,
+    EXR,
+    PPM,
+    RAW,                // all frames appended to a single file as RGBA8, e.g. for ffmpeg -f rawvideo
+    COUNT
+};
+
+class FrameRecorder {
+public:
+    // pattern: file name with one printf integer conversion for the frame number ("frames/%05d.png"), a plain
+    // name for RAW; maxQueued bounds the frames held in memory, submit() blocks while that many wait
+    FrameRecorder(const std::string& pattern, CaptureFormat format, uint32_t threadCount = 0, size_t maxQueued = 8);
+    // writes all queued frames
+    virtual ~FrameRecorder();
+
+    // copies the frame and queues it, frames are numbered in submission order
+    void submit(const float* rgba, uint32_t width, uint32_t height);
+    // blocks until every submitted frame is on disk
+    void finish();
+
+    uint64_t getSubmittedFrames() const { return submitted; }
+    uint64_t getWrittenFrames() const;
+    // total time submit() waited for the encoders to catch up
+    double getStallMs() const { return stallMs; }
+    CaptureFormat getFormat() const { return format; }
+
+    // format from the extension of fileName (.png, .exr, .ppm, .raw/.rgba), false if unknown
+    static bool findFormat(const std::string& fileName, CaptureFormat& format);
+    static const char* getFormatName(CaptureFormat format);
+
+private:
+    struct Frame {
+        uint64_t number;
+        uint32_t width, height;
+        std::vector<float> pixels;
+    };
+
+    std::string pattern;
+    CaptureFormat format;
+    size_t maxQueued;
+    std::ofstream rawFile;              // RAW only
+
+    std::vector<std::thread> workers;
+    std::deque<Frame> jobs;
+    std::vector<std::vector<float>> freeBuffers; // pixel storage of written frames, reused by submit()
+    mutable std::mutex mutex;
+    std::condition_variable jobAdded, jobDone;
+    size_t busy = 0;                    // frames taken by workers and not written yet
+    uint64_t submitted = 0, written = 0;
+    uint64_t nextRawFrame = 0;          // RAW frames are appended in order
+    double stallMs = 0.0;
+    bool stopping = false;
+
+    void workerLoop();
+    void write(const Frame& frame, std::vector<uint8_t>& srgb);
+    // lets the RAW frames after a failed one append
+    void skipRawFrame(uint64_t number);
+    std::string getFileName(uint64_t number) const;
+};
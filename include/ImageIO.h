@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+
+// ----------------------------------------------------
+// Image output
+
+// writes tightly packed RGBA8 pixels as binary PPM (alpha is dropped)
+void writePPM(const std::string& fileName, const uint8_t* rgba, uint32_t width, uint32_t height);
+
+// writes tightly packed RGBA8 pixels as PNG; the deflate stream is stored without compression,
+// so writing costs little more than a copy
+void writePNG(const std::string& fileName, const uint8_t* rgba, uint32_t width, uint32_t height);
+
+// writes linear float RGBA as scanline OpenEXR with 32 bit float channels and no compression
+void writeEXR(const std::string& fileName, const float* rgba, uint32_t width, uint32_t height);
+
+// converts linear float RGBA to RGBA8 with sRGB encoding, like writing to an *_SRGB attachment
+void linearToSRGB8(const float* rgba, size_t pixelCount, uint8_t* out);
+
+// ----------------------------------------------------
+// PPMTileFile
+// Binary PPM on disk that is filled rectangle by rectangle, only the rectangle
+// being written is ever held in memory.
+
+class PPMTileFile {
+public:
+    // create: writes the header and sizes the file, otherwise an existing file of the same size is opened for updating
+    PPMTileFile(const std::string& fileName, uint32_t width, uint32_t height, bool create);
+    virtual ~PPMTileFile();
+
+    // writes the w x h rectangle at x, y from tightly packed RGBA8 rows of pitch pixels (alpha is dropped)
+    void write(uint32_t x, uint32_t y, uint32_t w, uint32_t h, const uint8_t* rgba, uint32_t pitch);
+    // pushes written rectangles to the OS
+    void flush();
+
+    uint32_t getWidth() const { return width; }
+    uint32_t getHeight() const { return height; }
+
+private:
+    std::fstream file;
+    std::string fileName;
+    uint32_t width, height;
+    std::streamoff dataOffset = 0;      // first byte after the header
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "VoxelWorld.h"
+
+#include <string>
+
+// ----------------------------------------------------
+// MagicaVoxel
+// Imports .vox files. All models are placed by the scene graph (translations
+// and rotations, hidden layers are left out) with MagicaVoxel's z axis turned
+// into y. Palette entries with a glass, blend or media material become water,
+// all others solid; the colors are dropped. The scene is centered on the view
+// axis of the default camera, 16 voxels in front of it.
+
+VoxelWorld importMagicaVoxel(const std::string& fileName);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// ----------------------------------------------------
+// MappedFile
+// Read-only memory mapping of a whole file. Pages are read from disk on first
+// access, prefetch() asks the OS to start reading them early.
+
+class MappedFile {
+public:
+    // throws if the file cannot be opened or mapped
+    explicit MappedFile(const std::string& fileName);
+    virtual ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return mapping; }
+    size_t size() const { return length; }
+
+    // hints that the range will be read soon
+    void prefetch(size_t offset, size_t size) const;
+
+private:
+    const uint8_t* mapping = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mappingObject = nullptr;
+#endif
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include "VoxelWorld.h"
+
+// ----------------------------------------------------
+// Packet traversal
+// Marches up to 16 coherent rays through the voxel grid in lockstep. The kernels
+// only cover the DDA stepping and the voxel classification; everything that
+// changes a ray's direction is left to the scalar code in CpuTracer.
+
+// value is the packet width of the instruction set
+enum class SimdIsa {
+    SCALAR = 1,
+    SSE41 = 4,
+    AVX2 = 8,
+    AVX512 = 16
+};
+
+constexpr int MAX_PACKET_SIZE = 16;
+
+// structure of arrays, only the first packet width lanes are used
+struct alignas(64) RayPacket {
+    float sideDistX[MAX_PACKET_SIZE], sideDistY[MAX_PACKET_SIZE], sideDistZ[MAX_PACKET_SIZE];
+    float deltaDistX[MAX_PACKET_SIZE], deltaDistY[MAX_PACKET_SIZE], deltaDistZ[MAX_PACKET_SIZE];
+    int32_t voxelX[MAX_PACKET_SIZE], voxelY[MAX_PACKET_SIZE], voxelZ[MAX_PACKET_SIZE];
+    int32_t stepX[MAX_PACKET_SIZE], stepY[MAX_PACKET_SIZE], stepZ[MAX_PACKET_SIZE];
+    int32_t axis[MAX_PACKET_SIZE];          // axis of the last DDA step (0 = x, 1 = y, 2 = z), -1 before the first one
+    int32_t steps[MAX_PACKET_SIZE];         // DDA iterations done so far
+    int32_t lastWater[MAX_PACKET_SIZE];     // 0 or ~0
+    uint32_t active;                        // bit per lane still marching in the packet
+};
+
+// plain view of a VoxelWorld for the kernels
+struct VoxelGridView {
+    int32_t originX, originY, originZ;
+    int32_t outsideMaterial;
+    int32_t dimsX, dimsY, dimsZ;            // in bricks
+    int32_t coarseDimsX, coarseDimsY, coarseDimsZ;
+    const uint32_t* brickTable;
+    const uint8_t* brickPool;
+    const uint32_t* coarseTable;
+};
+
+// Steps all active lanes until at least one of them reaches a voxel that needs
+// scalar handling (solid hit or water boundary). Those lanes are returned as bit
+// mask without having taken the step. Lanes that run out of steps leave `active`.
+// Empty cells of the world are crossed in a single step like on the scalar path.
+using MarchPacketFunc = uint32_t(*)(RayPacket& packet, const VoxelGridView& grid, int maxSteps);
+
+SimdIsa detectSimdIsa();
+const char* getSimdIsaName(SimdIsa isa);
+// nullptr for SCALAR or instruction sets not compiled in
+MarchPacketFunc getMarchPacketFunc(SimdIsa isa);
+
+#ifdef GRAYV_SIMD_X86
+uint32_t marchPacketSSE41(RayPacket& packet, const VoxelGridView& grid, int maxSteps);
+uint32_t marchPacketAVX2(RayPacket& packet, const VoxelGridView& grid, int maxSteps);
+uint32_t marchPacketAVX512(RayPacket& packet, const VoxelGridView& grid, int maxSteps);
+#endif
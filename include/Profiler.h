@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+// ----------------------------------------------------
+// Profiler
+// Per frame CPU timings of the render loop and GPU timings from timestamp
+// queries. Keeps a rolling history for the GUI and writes it as CSV or JSON.
+
+enum class CpuSection {
+    WAIT,               // fence wait and swap chain image acquisition
+    UBO_UPLOAD,
+    STREAM,             // taking streamed voxel chunks or edits and staging their uploads
+    RECORD,             // command buffer recording
+    SUBMIT_PRESENT,
+    COUNT
+};
+
+enum class GpuSection {
+    TRACE,              // tracing (and denoising and presenting the result on the compute path)
+    DENOISE,
+    GUI,
+    COUNT
+};
+
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t HISTORY_SIZE = 256;
+
+    // queueFamily is the family the timestamps are written on
+    Profiler(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight);
+    virtual ~Profiler();
+
+    // starts a new row in the history
+    void beginFrame();
+    // drops all rows (call between frames), the history keeps the last size frames from now on
+    void resetHistory(size_t size = HISTORY_SIZE);
+    // adds end - begin to the section of the current frame
+    void addCpuTime(CpuSection section, Clock::time_point begin, Clock::time_point end);
+
+    // reads back the timestamps of the last frame that used the slot, its fence has to be signaled,
+    // true if that frame had results
+    bool collectGpuTimes(uint32_t frameInFlight);
+    // has to be recorded outside of a render pass before the timestamps of the slot
+    void resetQueries(VkCommandBuffer commandBuffer, uint32_t frameInFlight);
+    void writeTimestamp(VkCommandBuffer commandBuffer, uint32_t frameInFlight, GpuSection section, bool end);
+
+    bool hasGpuTimes() const { return gpuTimestamps; }
+
+    // mean over the history in milliseconds, only frames with GPU results count for GPU sections
+    float getCpuMean(CpuSection section) const;
+    float getGpuMean(GpuSection section) const;
+    // per frame times in the history, oldest first, frames without GPU results are left out
+    std::vector<float> getGpuTimes(GpuSection section) const;
+    // time of the most recently collected frame with GPU results, 0 if there is none yet
+    float getLatestGpuTime(GpuSection section) const { return latestGpu[size_t(section)]; }
+
+    // histograms of all sections, to be called inside an ImGui window
+    void drawGUI();
+
+    void writeCSV(const std::string& fileName) const;
+    void writeJSON(const std::string& fileName) const;
+    // JSON for a .json file name, CSV otherwise
+    void writeFile(const std::string& fileName) const;
+
+    static const char* getName(CpuSection section);
+    static const char* getName(GpuSection section);
+
+private:
+    struct FrameTimes {
+        uint64_t frame = 0;
+        float cpu[size_t(CpuSection::COUNT)] = {};
+        float gpu[size_t(GpuSection::COUNT)] = {};
+        bool gpuValid = false;
+    };
+
+    VkDevice device;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    bool gpuTimestamps = false;         // false if the queue family has no timestamp support
+    float timestampPeriod = 1.0f;       // nanoseconds per tick
+    uint64_t timestampMask = ~0ull;
+
+    uint64_t frameCount = 0;
+    std::vector<FrameTimes> history;    // ring buffer, frameCount % history.size() is the current row
+    std::vector<uint64_t> slotFrames;   // frame whose timestamps a slot holds, 0 if none
+    float latestGpu[size_t(GpuSection::COUNT)] = {};
+
+    static constexpr uint32_t QUERIES_PER_FRAME = uint32_t(GpuSection::COUNT) * 2;
+
+    FrameTimes* findFrame(uint64_t frame);
+    template<typename Func> void forEachFrame(Func func) const;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+// ----------------------------------------------------
+// RenderScaleController
+// Picks the fraction of the swap chain resolution to trace at, so that the
+// measured GPU time of a frame stays close to a budget. Trace cost grows with
+// the pixel count, i.e. with the square of the scale.
+
+class RenderScaleController {
+public:
+    float targetMs = 16.6f;
+    float minScale = 0.25f;
+    float maxScale = 1.0f;
+
+    // feeds the GPU time of a finished frame, returns the scale to trace the next frames at
+    float update(float gpuMs);
+    // the next count frames were already recorded at the previous scale, their times are ignored
+    void skipSamples(uint32_t count) { skip = count; }
+
+    float getScale() const { return scale; }
+    void reset(float newScale = 1.0f);
+
+private:
+    static constexpr float STEPS = 64.0f;       // the scale is a multiple of 1 / STEPS
+    static constexpr float SMOOTHING = 0.3f;    // weight of a new sample in the filtered time
+
+    float scale = 1.0f;
+    float filteredMs = 0.0f;                    // 0: no sample at the current scale yet
+    uint32_t skip = 0;
+};
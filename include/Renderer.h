@@ -2,33 +2,157 @@
 
 #include "Shader.h"
 #include "Camera.h"
+#include "VoxelWorld.h"
+#include "VoxelStreamer.h"
+#include "VoxelFile.h"
+#include "Profiler.h"
+#include "TraceSettings.h"
+#include "ShaderCompiler.h"
+#include "RenderScale.h"
+#include "Sampler.h"
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
-#include <Vulkan/Vulkan.h>
+#include <vulkan/vulkan.h>
 #include <vector>
 #include <set>
 #include <string>
 #include <limits>
 #include <algorithm>
+#include <functional>
+#include <future>
+#include <map>
+#include <chrono>
 
 #define GLSL_450( x ) "#version 450\n" #x
 
+// FRAGMENT traces in the screen quad pass, COMPUTE in a compute dispatch that the screen quad only shows,
+// WAVEFRONT in compute kernels that each do one step of all paths (see wavefront.comp)
+enum class TracePath {
+	FRAGMENT,
+	COMPUTE,
+	WAVEFRONT
+};
+
 class Renderer {
 public:
 	Renderer(GLFWwindow* window);
+	// headless: no window or surface, frames are rendered offscreen and read back to host memory
+	Renderer(uint32_t width, uint32_t height);
 	~Renderer();
 
 	void render();
+	// recompiles changed shaders (and their includes) in the background and swaps in the
+	// rebuilt pipelines once ready, call once per frame
 	void reloadModifiedShaders();
 
 	void setCamera(Camera* cam) { camera = cam; }
+	// replaces the scene, blocks until the upload is done
+	void setVoxelWorld(const VoxelWorld& world);
+	// same for a scene file, decoded from the mapped file straight into the staging buffer
+	void setVoxelFile(const VoxelFile& file);
+	// streams the scene around the camera instead, every frame uploads what changed; the streamer is not
+	// owned and has to outlive the renderer or be replaced by setVoxelWorld, blocks until its tables are up
+	void setVoxelStreamer(VoxelStreamer* voxelStreamer);
+	VoxelStreamer* getVoxelStreamer() const { return streamer; }
+	// uploads the world and follows its edits: every frame uploads the bricks edited since the last one and only
+	// the pixels near them start to accumulate anew. Not owned, has to outlive the renderer or be replaced
+	void setEditableVoxelWorld(VoxelWorld* world);
+	VoxelWorld* getEditableVoxelWorld() const { return editedWorld; }
+	// drops the accumulated frames, camera and setting changes are detected automatically
+	void resetAccumulation() { accumulatedFrames = 0; resetRect = glm::ivec4(0); }
+
+	// called with the tightly packed RGBA8 (sRGB) pixels of every finished headless frame
+	using FrameCallback = std::function<void(const uint8_t* pixels, uint32_t width, uint32_t height)>;
+	void setFrameCallback(FrameCallback callback) { frameCallback = callback; }
+	// called with the linear RGBA32F traced image (render extent, top row first, no GUI) of every frame while set,
+	// in windowed mode as well; the copy is read once the frame's fence has signaled, so capturing never stalls the GPU
+	using CaptureCallback = std::function<void(const float* pixels, uint32_t width, uint32_t height)>;
+	void setCaptureCallback(CaptureCallback callback);
+	bool isCapturing() const { return bool(captureCallback); }
+	// waits for all frames in flight and hands them to the frame and capture callbacks
+	void finish();
+
+	bool isHeadless() const { return headless; }
+
+	void setTracePath(TracePath path) { tracePath = path; }
+	TracePath getTracePath() const { return tracePath; }
+	// extend and shade rounds a wavefront wave runs, and the paths of the last finished wavefront frame that were
+	// still marching after them (counted as misses); the rounds double while paths get cut short, up to max_steps + 1
+	int32_t getWavefrontRounds() const { return wavefrontRounds; }
+	uint32_t getWavefrontTruncatedPaths() const { return wavefrontTruncatedPaths; }
+	// workgroup size of the compute trace path, rebuilds its pipeline; not to be called while a frame is recorded
+	void setWorkgroupSize(uint32_t x, uint32_t y);
+	glm::uvec2 getWorkgroupSize() const { return workgroupSize; }
+
+	Profiler& getProfiler() { return *profiler; }
+
+	// frames the CPU may record ahead of the GPU (1 to MAX_FRAMES_IN_FLIGHT), fewer lowers the latency, more
+	// keeps the GPU busier; waits for the GPU, call between frames
+	void setFramesInFlight(uint32_t count);
+	uint32_t getFramesInFlight() const { return framesInFlight; }
+	// recreates the swap chain with a mode from getSupportedPresentModes(), call between frames
+	void setPresentMode(VkPresentModeKHR mode);
+	VkPresentModeKHR getPresentMode() const { return presentMode; }
+	// the modes of the surface the renderer knows, empty when headless
+	std::vector<VkPresentModeKHR> getSupportedPresentModes();
+	static const char* getPresentModeName(VkPresentModeKHR mode);
+
+	// traces at a fraction (0.25 to 1) of the swap chain resolution and scales the result up, turns adaptive resolution off
+	void setRenderScale(float scale);
+	float getRenderScale() const { return scaleController.getScale(); }
+	// adjusts the render scale every frame so the GPU trace time stays close to targetMs
+	void setAdaptiveResolution(bool enabled, float targetMs = 16.6f);
+	bool isAdaptiveResolution() const { return adaptiveResolution; }
+	VkExtent2D getRenderExtent() const { return renderExtent; }
+
+	// while the camera moves (or always without accumulation) only every 2nd (checkerboard) or 4th pixel is
+	// traced per frame, the others are reprojected from the previous frame; 1 traces every pixel
+	void setInterleave(uint32_t n);
+	uint32_t getInterleave() const { return interleave; }
+
+	// filters the traced image with passes of an edge-avoiding a-trous wavelet (0 shows it as it is), guided by
+	// the first hit of every pixel; strength is the color tolerance for a single frame, it shrinks as frames
+	// accumulate. While the camera moves, traced pixels are blended with their reprojected history first
+	void setDenoise(uint32_t passes, float strength = 1.0f);
+	uint32_t getDenoisePasses() const { return denoisePasses; }
+	static constexpr uint32_t MAX_DENOISE_PASSES = 5;
+
+	// CUSTOM traces with settings, the other tiers use their own settings compiled into the shaders
+	void setQualityTier(QualityTier tier) { qualityTier = tier; }
+	QualityTier getQualityTier() const { return qualityTier; }
+	// the settings the current tier traces with
+	const TraceSettings& getTraceSettings() const;
+
+	// seeds the noise with seed + number of frames since the call, for reproducible runs
+	void setFixedSeed(int32_t seed) { settings.time = seed; seedFrame = 0; }
+
+	// how the path tracer draws its random numbers, see Sampler.h
+	void setSampler(SamplerType type) { samplerType = type; resetAccumulation(); }
+	SamplerType getSampler() const { return samplerType; }
+
+	// settings.time is the seed of the first frame
+	TraceSettings settings;
+	bool accumulate = true;
+
+	// per frame resources are created for this many frames, framesInFlight of them are used
+	static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+	// the wavefront path traces waves of at most this many paths (128 bytes of state each)
+	static constexpr uint32_t MAX_WAVEFRONT_PATHS = 1u << 20;
+	// frames after the last edit of the scene before the whole image starts over, the pixels outside the
+	// edited region would otherwise keep the old look of shadows and bounced light forever
+	static constexpr uint32_t EDIT_SETTLE_FRAMES = 16;
 
 private:
-	const int MAX_FRAMES_IN_FLIGHT = 2;
+	uint32_t framesInFlight = 2;
 	uint32_t currentFrame = 0;
+	// changes made in the GUI, applied at the start of the next frame
+	uint32_t requestedFramesInFlight = 0;
+	VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+	glm::uvec2 requestedWorkgroupSize{ 0, 0 };
 
 	GLFWwindow* window;
+	bool headless = false;
 
 	VkInstance instance = VK_NULL_HANDLE;
 	// Vulkan physical device
@@ -37,6 +161,7 @@ private:
 	VkDevice device = VK_NULL_HANDLE;
 
 	VkSurfaceKHR surface;
+	uint32_t graphicsFamily = -1, presentFamily = -1;
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
 
@@ -46,18 +171,121 @@ private:
 	std::vector<VkImageView> swapChainImageViews;
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR; // this one is on every device
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 
+	// headless render target and host visible copies of it
+	VkImage offscreenImage = VK_NULL_HANDLE;
+	VkDeviceMemory offscreenImageMemory = VK_NULL_HANDLE;
+	std::vector<VkBuffer> readbackBuffers;
+	std::vector<VkDeviceMemory> readbackBuffersMemory;
+	std::vector<void*> readbackBuffersMapped;
+	std::vector<bool> readbackPending;
+	FrameCallback frameCallback;
+
+	// host visible copies of the traced image, one per frame in flight, created for the first capture callback
+	std::vector<VkBuffer> captureBuffers;
+	std::vector<VkDeviceMemory> captureBuffersMemory;
+	std::vector<void*> captureBuffersMapped;
+	std::vector<VkExtent2D> captureExtents;            // extent of the copy a slot waits for, 0x0 if none
+	CaptureCallback captureCallback;
+	// the traced image scaled up to the output size, captures keep that size whatever the render scale
+	VkImage captureImage = VK_NULL_HANDLE;
+	VkDeviceMemory captureImageMemory = VK_NULL_HANDLE;
+	VkImageView captureImageView = VK_NULL_HANDLE;
+	VkFilter captureFilter = VK_FILTER_NEAREST;
+
 	VkRenderPass renderPass;
-	VkPipeline graphicsPipeline;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkPipelineLayout pipelineLayout;
-	VkPipeline screenQuadPipeline;
+	VkPipeline presentPipeline = VK_NULL_HANDLE;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;     // persisted in the shader cache directory
+	TracePath tracePath = TracePath::FRAGMENT;
+	glm::uvec2 workgroupSize{ 8, 8 };
+
+	// the trace covers the top left renderExtent of the accumulation image
+	VkExtent2D renderExtent{};
+	RenderScaleController scaleController;
+	bool adaptiveResolution = false;
+
+	// replaced pipelines wait here until the frames in flight that may use them are done
+	struct RetiredPipeline {
+		VkPipeline pipeline;
+		uint64_t lastFrame;             // destroyed once frameNumber reaches it
+	};
+	std::vector<RetiredPipeline> retiredPipelines;
+	uint64_t frameNumber = 0;           // frames whose fence wait has passed
+	std::map<Shader*, std::future<VkShaderModule>> pendingShaders;
+	std::chrono::steady_clock::time_point lastShaderCheck{};
 
 	std::vector<VkBuffer> uniformBuffers;
 	std::vector<VkDeviceMemory> uniformBuffersMemory;
 	std::vector<void*> uniformBuffersMapped;
 
+	VkBuffer voxelBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory voxelBufferMemory = VK_NULL_HANDLE;
+	VkDeviceSize voxelBufferSize = 0;
+
+	// streamed or edited scene: each frame in flight stages its uploads in a slice of its own, copied before the trace
+	VoxelStreamer* streamer = nullptr;
+	VoxelWorld* editedWorld = nullptr;
+	size_t editedBricks = 0;            // uploaded by the last frame
+	std::vector<VkBuffer> voxelUploadBuffers;
+	std::vector<VkDeviceMemory> voxelUploadBuffersMemory;
+	std::vector<void*> voxelUploadBuffersMapped;
+	std::vector<std::vector<VkBufferCopy>> voxelUploadCopies;
+	VkDeviceSize voxelUploadSliceSize = 0;
+
+	// progressive accumulation while camera and settings stay the same
+	VkImage accumulationImage = VK_NULL_HANDLE;
+	VkDeviceMemory accumulationImageMemory = VK_NULL_HANDLE;
+	VkImageView accumulationImageView = VK_NULL_HANDLE;
+	// two layers, one written per frame, the other one holds the frame before
+	VkImage historyImage = VK_NULL_HANDLE;
+	VkDeviceMemory historyImageMemory = VK_NULL_HANDLE;
+	VkImageView historyImageView = VK_NULL_HANDLE;
+	// denoising: normal, material and distance of the first hits, and two layers the passes take turns on
+	VkImage surfacesImage = VK_NULL_HANDLE;
+	VkDeviceMemory surfacesImageMemory = VK_NULL_HANDLE;
+	VkImageView surfacesImageView = VK_NULL_HANDLE;
+	VkImage denoisedImage = VK_NULL_HANDLE;
+	VkDeviceMemory denoisedImageMemory = VK_NULL_HANDLE;
+	VkImageView denoisedImageView = VK_NULL_HANDLE;
+	VkPipeline denoisePipeline = VK_NULL_HANDLE;
+	uint32_t denoisePasses = 0;
+	float denoiseStrength = 1.0f;
+	uint32_t interleave = 1;
+	uint32_t interleaveFrame = 0;
+	bool historyValid = false;          // the last frame wrote the history with the current extent and settings
+	bool lastFrameInterleaved = false;
+	uint32_t accumulatedFrames = 0;
+	// pixels near edits accumulate anew while the rest keeps its frames: left, top, right, bottom (exclusive)
+	glm::ivec4 resetRect{ 0 };
+	uint32_t resetFrames = 0;
+	glm::mat4 accumulationView{}, accumulationProj{};
+	TraceSettings accumulationSettings{};
+	glm::uvec2 accumulationExtent{};
+	int32_t accumulationRounds = 0;     // wavefront rounds the accumulated frames were traced with
+	uint32_t seedFrame = 0;
+	uint32_t sampleSeed = 0;            // seed of the frame the accumulation started with
+	SamplerType samplerType = SamplerType::SOBOL;
+	VkBuffer blueNoiseBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory blueNoiseBufferMemory = VK_NULL_HANDLE;
+	// wavefront path: the state of up to wavefrontCapacity paths, and their queues with the indirect dispatches
+	// of the kernels that consume them; created when the path is first used
+	VkBuffer wavefrontPathBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory wavefrontPathBufferMemory = VK_NULL_HANDLE;
+	VkBuffer wavefrontQueueBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory wavefrontQueueBufferMemory = VK_NULL_HANDLE;
+	uint32_t wavefrontCapacity = 0;
+	// the truncated path count of every frame slot, copied from the queue header behind the last wave
+	VkBuffer wavefrontStatsBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory wavefrontStatsBufferMemory = VK_NULL_HANDLE;
+	uint32_t* wavefrontStatsMapped = nullptr;
+	int32_t wavefrontFrameRounds[MAX_FRAMES_IN_FLIGHT] = {};  // rounds the slot's frame ran, 0: no wavefront frame
+	int32_t wavefrontRounds = 0;        // 0: not estimated for the settings yet
+	uint32_t wavefrontTruncatedPaths = 0;
+
 	VkDescriptorPool imguiPool;
 	VkDescriptorPool descriptorPool;
 	std::vector<VkDescriptorSet> descriptorSets;
@@ -69,18 +297,91 @@ private:
 	std::vector<VkSemaphore> renderFinishedSemaphores;
 	std::vector<VkFence> inFlightFences;
 
+	// kernels of the wavefront path, WAVEFRONT_KERNEL in wavefront.comp
+	enum WavefrontKernel {
+		WAVEFRONT_GENERATE,
+		WAVEFRONT_EXTEND,
+		WAVEFRONT_SHADE,
+		WAVEFRONT_PREPARE,
+		WAVEFRONT_RESOLVE,
+		WAVEFRONT_KERNEL_COUNT
+	};
+
+	// the tracing shaders and pipelines of one quality tier
+	struct TierVariant {
+		Shader* screenQuadFS = nullptr;
+		Shader* traceCS = nullptr;
+		Shader* wavefrontCS[WAVEFRONT_KERNEL_COUNT] = {};
+		VkPipeline graphicsPipeline = VK_NULL_HANDLE;
+		VkPipeline tracePipeline = VK_NULL_HANDLE;
+		VkPipeline wavefrontPipelines[WAVEFRONT_KERNEL_COUNT] = {};
+	};
+	std::vector<TierVariant> tiers;     // indexed by QualityTier
+	QualityTier qualityTier = QualityTier::CUSTOM;
+
 	Shader* screenQuadVS;
-	Shader* screenQuadFS;
+	Shader* presentFS;
+	Shader* denoiseCS;
+	std::vector<Shader*> shaders;       // all of the above and the shaders of every tier
+	ShaderCompiler* shaderCompiler = nullptr;
 
 	Camera* camera;
+	Profiler* profiler = nullptr;
+
+	void init();
+	void createSwapChain();
+	void createImageViews();
+	void createFramebuffers();
+	void recreateSwapChain();
+	void createOffscreenTarget();
+	void createStorageImage(uint32_t layers, VkImage& image, VkDeviceMemory& memory, VkImageView& view);
+	void checkWorkgroupSize(glm::uvec2 size);
+	void createTracePipeline(TierVariant& tier);
+	void createDenoisePipeline();
+	void createWavefrontPipeline(TierVariant& tier, WavefrontKernel kernel);
+	void createWavefrontBuffers();
+	// creates the pipelines of the current trace path that do not exist yet, waiting for their shaders if needed
+	void preparePipelines();
+	void updateRenderExtent();
+	bool isRenderScaled() const { return renderExtent.width != swapChainExtent.width || renderExtent.height != swapChainExtent.height; }
+	// the compute paths, scaled fragment tracing and denoising show the result with present.frag
+	bool usesPresentPass() const { return tracePath != TracePath::FRAGMENT || isRenderScaled() || denoisePasses > 0; }
+	void takeCompiledShader(Shader* shader, std::future<VkShaderModule>& module);
+	VkPipeline createScreenQuadPipeline(Shader* fragmentShader);
+	void createPipelineCache();
+	void savePipelineCache();
+	void retirePipeline(VkPipeline pipeline);
+	void destroyRetiredPipelines(bool all = false);
+	void copyFrameToReadback();
+	void deliverFrame(uint32_t frame);
+	void copyTraceToCapture();
+	void deliverCapture(uint32_t frame);
+	// replaces the voxel buffer with one of size bytes, the first uploadSize of them are written by fill
+	void createVoxelBuffer(VkDeviceSize size, VkDeviceSize uploadSize, const std::function<void(void*)>& fill);
+	// the staging slices, kept if they already hold sliceSize bytes
+	void createVoxelUploadBuffers(VkDeviceSize sliceSize);
+	void destroyVoxelUploadBuffers();
+	void stageVoxelUpload(size_t offset, const void* data, size_t size);
+	void updateStream();
+	void updateEdits();
+	// restarts the accumulation of the pixels the voxels [min, max) may show up in
+	void resetRegion(glm::ivec3 min, glm::ivec3 max);
+	void copyVoxelUploads();
 
 	void drawScreenQuad(uint32_t image_nr);
+	// the wavefront path: waves of as many pixels as the path buffer holds samples of, each traced with
+	// wavefrontRounds extend and shade rounds
+	void traceWavefront();
+	// reads the truncated path count of a finished frame slot and grows the rounds if paths were cut short
+	void collectWavefrontStats(uint32_t frame);
+	void denoise();
+	void drawQuadPass(uint32_t image_nr, VkPipeline pipeline, VkExtent2D extent, bool lastPass);
 	void drawGUI(VkCommandBuffer commandbuffer);
 	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
 	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 	void initImGui();
 
-	const std::vector<const char*> deviceExtensions = {
+	std::vector<const char*> deviceExtensions = {
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME
 	};
 
@@ -124,11 +425,20 @@ private:
 		for (const auto& extension : availableExtensions)
 			 requiredExtensions.erase(extension.extensionName);
 
+		if (headless) {
+			// software implementations like lavapipe are fine, there is nothing to present
+			return (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU || deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU
+				|| deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU)
+				&& deviceFeatures.fragmentStoresAndAtomics
+				&& requiredExtensions.empty();
+		}
+
 		// check for adequate swap chain (framebuffer) support
 		SwapChainSupportDetails sc_details = getSwapChainSupportDetails(device);
 
 		return (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU || deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU)
 			&& deviceFeatures.geometryShader
+			&& deviceFeatures.fragmentStoresAndAtomics
 			&& requiredExtensions.empty()
 			&& !sc_details.formats.empty() && !sc_details.presentModes.empty();
 	}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// ----------------------------------------------------
+// Sampler
+// The random numbers of the path tracer, kept 1:1 with sampler.glsl. Every
+// sample of a pixel draws a stream of 2D points: the first one jitters the
+// pixel, each bounce takes the next. The sample index counts on over the
+// frames of an accumulation, so they continue one sequence per pixel.
+//  SOBOL       Owen scrambled Sobol points (hash based nested uniform
+//              scrambling), with the index shuffled per point and the
+//              scrambling seeded per pixel
+//  BLUE_NOISE  a tiled blue noise mask, shifted for every point of the stream
+//              and rotated along the R2 sequence from sample to sample, the
+//              error of a single frame is fine grained instead of blotchy
+//  RANDOM      independent hashes, as a reference
+
+enum class SamplerType {
+    RANDOM,
+    SOBOL,
+    BLUE_NOISE,
+    COUNT
+};
+
+const char* getSamplerName(SamplerType type);
+// case insensitive lookup by name, false if there is no such sampler
+bool findSampler(const std::string& name, SamplerType& type);
+
+inline uint32_t pcg(uint32_t v) {
+    uint32_t state = v * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+struct SampleStream {
+    SamplerType type;
+    glm::uvec2 pixel;
+    uint32_t index;                     // sample of the pixel since its accumulation started
+    uint32_t seed;
+    uint32_t dimension;                 // points drawn so far
+};
+
+// sequenceSeed stays the same over the frames of an accumulation
+SampleStream startSampleStream(SamplerType type, glm::uvec2 pixel, uint32_t index, uint32_t sequenceSeed);
+// next point of the stream in [0, 1)^2
+glm::vec2 nextSample(SampleStream& stream);
+
+constexpr uint32_t BLUE_NOISE_SIZE = 64;
+// BLUE_NOISE_SIZE^2 values, row by row, each of (i + 0.5) / BLUE_NOISE_SIZE^2 once; made with
+// void and cluster on the first call, the same every run
+const std::vector<float>& getBlueNoiseMask();
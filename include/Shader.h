@@ -1,8 +1,11 @@
+#pragma once
+
 #include <string>
 #include <fstream>
-#include <Vulkan/Vulkan.hpp>
+#include <vulkan/vulkan.hpp>
 #include <shaderc/shaderc.hpp>
 #include <filesystem>
+#include <vector>
 
 enum ShaderType {
     NONE = -1,
@@ -12,13 +15,38 @@ enum ShaderType {
     COMPUTE_SHADER = shaderc_shader_kind::shaderc_glsl_default_compute_shader
 };
 
+// preprocessor definitions (name, value) passed to the compiler
+using ShaderMacros = std::vector<std::pair<std::string, std::string>>;
+
 class Shader {
 public:
-    Shader(VkDevice device, std::string fileName, std::string shaderFolder = "/../shader/");
+    // nothing is compiled yet, call reload() or hand the shader to a ShaderCompiler
+    Shader(VkDevice device, std::string fileName, ShaderMacros macros = {}, std::string shaderFolder = "/../shader/");
     ~Shader();
 
+    // compiles and replaces the shader module if the file or one of its includes changed
     void reload();
 
+    // true if the file or one of the files it included changed since the last compile()
+    bool isModified() const;
+    // compiles the current sources, empty on errors; needs no Vulkan calls and may run on another
+    // thread as long as no other member is used until it returns
+    std::vector<uint32_t> compile();
+    // replaces the shader module, pipelines created from the previous one stay valid
+    void createModule(const std::vector<uint32_t>& spirv);
+    // takes ownership of a module created from the result of compile()
+    void setModule(VkShaderModule newModule);
+    bool hasModule() const { return shaderModule != VK_NULL_HANDLE; }
+
+    // vkCreateShaderModule wrapper, may be called from any thread
+    static VkShaderModule createShaderModule(VkDevice device, const std::vector<uint32_t>& spirv);
+
+    // compiled SPIR-V is stored there keyed by a hash of the preprocessed source, macros and compile options;
+    // an empty path disables the cache. Has to be set before shaders get compiled
+    static void setCacheDirectory(const std::filesystem::path& directory);
+    static const std::filesystem::path& getCacheDirectory();
+
+    const std::string& getFileLocation() const { return fileLocation; }
     ShaderType getType() { return type; }
     VkPipelineShaderStageCreateInfo getShaderStageInfo() { return shaderStageInfo; }
 
@@ -29,10 +57,12 @@ private:
     VkDevice device;
     VkShaderModule shaderModule = VK_NULL_HANDLE;
     VkPipelineShaderStageCreateInfo shaderStageInfo{};
-    std::filesystem::file_time_type last_updated;
+    // the shader file and everything it included at the last compile, with their write times
+    std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>> dependencies;
+    std::vector<std::filesystem::path> includedFiles;   // filled by the includer during compile()
 
-    shaderc::Compiler shaderCompiler;
     shaderc::CompileOptions compileOptions;
+    ShaderMacros definitions;           // macros passed to the compiler
 
     std::vector<char> readBinaryFile(const std::string& fileName) {
         std::ifstream fileStream(fileName, std::ios::binary | std::ios::in | std::ios::ate);
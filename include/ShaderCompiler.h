@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Shader.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <cstdint>
+
+// ----------------------------------------------------
+// ShaderCompiler
+// Thread pool that compiles shaders (each with its own macro set) concurrently
+// and creates their modules. Results come back as futures, so callers only
+// block on the variant they need right now.
+
+class ShaderCompiler {
+public:
+    // threadCount 0: one worker per hardware thread
+    ShaderCompiler(VkDevice device, uint32_t threadCount = 0);
+    // finishes all queued compiles
+    virtual ~ShaderCompiler();
+
+    // queues shader->compile() and creates a module from the result; VK_NULL_HANDLE if the compile
+    // failed (errors are printed). The module is not owned by the shader yet, pass it to setModule().
+    // The shader must not be used otherwise and not be submitted again until the future is ready.
+    std::future<VkShaderModule> submit(Shader* shader);
+
+    uint32_t getThreadCount() const { return uint32_t(workers.size()); }
+
+private:
+    VkDevice device;
+
+    std::vector<std::thread> workers;
+    std::deque<std::packaged_task<VkShaderModule()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAdded;
+    bool stopping = false;
+
+    void workerLoop();
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+#include <cctype>
+#include <algorithm>
+
+// ----------------------------------------------------
+// String helpers
+
+// true if a and b differ at most in the case of ASCII letters, for names given on the command line
+inline bool equalsIgnoreCase(const std::string& a, const std::string& b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+        [](char x, char y) { return std::tolower((unsigned char)x) == std::tolower((unsigned char)y); });
+}
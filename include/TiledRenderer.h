@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Camera.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// ----------------------------------------------------
+// TiledRenderer
+// Offline stills larger than any single frame: the image is cut into square
+// tiles that are rendered one after another with their own sub-frustum and
+// streamed into a PPM on disk, so memory stays bounded by one tile. Finished
+// tiles are logged next to the output, an interrupted render can be resumed.
+
+class TiledRenderer {
+public:
+    // renders camera (whose frustum covers exactly one tile) at size x size into tightly packed RGBA8,
+    // tileIndex is stable across runs and meant to seed the noise
+    using TileFunc = std::function<void(const Camera& camera, uint32_t size, uint32_t tileIndex, uint8_t* rgba)>;
+
+    TiledRenderer(uint32_t width, uint32_t height, uint32_t tileSize);
+    virtual ~TiledRenderer();
+
+    // renders every tile into fileName (binary PPM); resume: keeps fileName and skips the tiles listed in its progress log
+    // returns the number of tiles rendered by this call
+    uint32_t render(const Camera& camera, const std::string& fileName, bool resume, const TileFunc& renderTile);
+
+    uint32_t getTileCount() const { return tilesX * tilesY; }
+    uint32_t getTileSize() const { return tileSize; }
+
+    // camera restricted to the pixels [from, from + size) of a width x height image, top row first
+    static Camera getTileCamera(const Camera& camera, uint32_t width, uint32_t height, glm::uvec2 from, uint32_t size);
+    // progress log written next to the image
+    static std::string getProgressFileName(const std::string& fileName);
+
+private:
+    uint32_t width, height;
+    uint32_t tileSize;
+    uint32_t tilesX, tilesY;
+
+    std::vector<bool> readProgress(const std::string& progressFile) const;
+    std::string getProgressHeader() const;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "StringUtil.h"
+
+// ----------------------------------------------------
+// TraceSettings
+// Limits of the path tracer, same as the UniformBufferObject of the shader.
+
+struct TraceSettings {
+    int max_samples = 4;
+    int max_steps = 200;
+    int max_total_reflections = 9;
+    int time = 0;                       // noise seed
+    bool refraction = true;             // false: rays pass through water unbent
+    int max_diffuse_bounces = 16;       // a path ends at the next diffuse surface after this many bounces
+    int roulette_depth = 3;             // diffuse bounces after which Russian roulette may end a path
+};
+
+// true if a and b trace the same image, the seed aside
+inline bool tracesSameImage(const TraceSettings& a, const TraceSettings& b) {
+    return a.max_samples == b.max_samples && a.max_steps == b.max_steps && a.max_total_reflections == b.max_total_reflections
+        && a.refraction == b.refraction && a.max_diffuse_bounces == b.max_diffuse_bounces && a.roulette_depth == b.roulette_depth;
+}
+
+// fixed settings the GPU path compiles into dedicated shader variants, CUSTOM reads them from the UBO
+enum class QualityTier {
+    CUSTOM,
+    LOW,
+    MEDIUM,
+    HIGH,
+    COUNT
+};
+
+struct QualityTierInfo {
+    const char* name;
+    TraceSettings settings;             // time is unused
+};
+
+inline const QualityTierInfo& getQualityTierInfo(QualityTier tier) {
+    static const QualityTierInfo tiers[] = {
+        { "Custom", {} },
+        { "Low", { 1, 100, 0, 0, false, 2, 1 } },
+        { "Medium", { 2, 200, 4, 0, true, 4, 2 } },
+        { "High", { 4, 300, 9, 0, true, 16, 3 } },
+    };
+    return tiers[size_t(tier)];
+}
+
+// case insensitive lookup by name, false if there is no such tier
+inline bool findQualityTier(const std::string& name, QualityTier& tier) {
+    for (size_t i = 0; i < size_t(QualityTier::COUNT); ++i) {
+        if (equalsIgnoreCase(name, getQualityTierInfo(QualityTier(i)).name)) {
+            tier = QualityTier(i);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "VoxelWorld.h"
+#include "MappedFile.h"
+
+#include <string>
+#include <cstdint>
+
+// ----------------------------------------------------
+// VoxelFile
+// Compact scene files (.gvox). The tables are stored in the layout of the GPU
+// buffer and the bricks compressed to a palette of the materials they use plus
+// 1, 2, 4 or 8 bit indices into it. The file is memory-mapped and decoded
+// straight into the destination (the staging buffer of the upload), nothing is
+// parsed up front.
+//
+// Layout: GvoxHeader, palette (paletteSize uint32 materials), brick table (one
+// uint32 per brick: BRICK_UNIFORM | palette index, or the brick number), coarse
+// level (one uint32 per cell, 1 if empty), brick index (brickCount + 1 uint64
+// offsets into the brick data, the last one is its size), brick data. A brick
+// is a count, count palette indices and 512 packed indices into those.
+
+struct GvoxHeader {
+    char magic[4];              // "GVOX"
+    uint32_t version;
+    int32_t origin[3];
+    uint32_t outsidePalette;    // palette index of everything outside the world
+    int32_t brickDims[3];
+    uint32_t paletteSize;
+    uint32_t brickCount;
+    uint32_t reserved;
+    uint64_t paletteOffset;
+    uint64_t tableOffset;
+    uint64_t coarseOffset;
+    uint64_t indexOffset;
+    uint64_t brickDataOffset;
+};
+
+class VoxelFile {
+public:
+    // maps the file and checks the header and the section sizes, throws if it is not a valid .gvox file
+    explicit VoxelFile(const std::string& fileName);
+    virtual ~VoxelFile();
+
+    glm::ivec3 getOrigin() const { return glm::ivec3(header->origin[0], header->origin[1], header->origin[2]); }
+    glm::ivec3 getBrickDims() const { return glm::ivec3(header->brickDims[0], header->brickDims[1], header->brickDims[2]); }
+    size_t getBrickCount() const { return header->brickCount; }
+    size_t getFileSize() const { return file.size(); }
+
+    // same as VoxelWorld::getGpuSize() / writeGpuData() of the stored world; bricks are
+    // decoded on all cores, throws if one of them is corrupt
+    size_t getGpuSize() const;
+    void writeGpuData(void* dst) const;
+    VoxelWorld createWorld() const;
+
+    // writes world as a .gvox file
+    static void write(const VoxelWorld& world, const std::string& fileName);
+
+private:
+    MappedFile file;
+    const GvoxHeader* header;
+    uint8_t materials[256] = {};    // by palette index
+    const uint32_t* brickTable;
+    const uint32_t* coarseTable;
+    const uint64_t* brickIndex;
+    const uint8_t* brickData;
+    size_t brickTableSize;
+    size_t coarseTableSize;
+
+    // decodes bricks [first, last) into pool, false if one is corrupt
+    bool decodeBricks(size_t first, size_t last, uint8_t* pool) const;
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "VoxelWorld.h"
+#include "MappedFile.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <limits>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// ----------------------------------------------------
+// VoxelStreamer
+// Out-of-core worlds: the world lives on disk as chunk files of 8x8x8 bricks
+// and only a window of chunks around the camera is kept on the GPU. The window
+// is a regular brick map (same layout as VoxelWorld) whose brick table points
+// into a fixed pool sized by the memory budget. A loader thread maps chunk
+// files nearest first; chunks that do not fit are evicted least recently used
+// first. Chunks in the window that are not resident show as a uniform block of
+// their coarse material (empty until the chunk was seen once).
+
+constexpr int CHUNK_BRICKS = 8;                         // bricks per chunk along each axis
+constexpr int CHUNK_SIZE = CHUNK_BRICKS * BRICK_SIZE;   // voxels per chunk along each axis
+constexpr int CHUNK_BRICK_COUNT = CHUNK_BRICKS * CHUNK_BRICKS * CHUNK_BRICKS;
+
+// chunk file: header, CHUNK_BRICK_COUNT table entries (BRICK_UNIFORM | material or the index of
+// one of the chunk's bricks), then brickCount bricks of BRICK_VOXELS material bytes
+struct ChunkFileHeader {
+    char magic[4];              // "GVCK"
+    uint32_t version;
+    int32_t chunk[3];
+    uint32_t coarseMaterial;    // the material of most of the voxels
+    uint32_t brickCount;
+};
+
+class VoxelStreamer {
+public:
+    // writes size bytes at offset of the GPU buffer (see getGpuSize())
+    using WriteFunc = GpuWriteFunc;
+
+    // directory holds the chunk files, windowChunks is the size of the window in chunks,
+    // budgetBytes the device memory for the brick pool
+    VoxelStreamer(const std::string& directory, glm::ivec3 windowChunks, size_t budgetBytes);
+    virtual ~VoxelStreamer();
+
+    // centers the window on the camera, queues the missing chunks nearest first and makes loaded ones
+    // resident; everything that changed goes to write, at most uploadBudget bytes. True if anything did
+    bool update(glm::vec3 cameraPos, size_t uploadBudget, const WriteFunc& write);
+
+    // size of the GPU buffer, fixed for the lifetime of the streamer
+    size_t getGpuSize() const;
+    // header and tables of the current state, the pool is left out
+    size_t getTableSize() const;
+    void writeTables(void* dst) const;
+    // smallest upload budget that always makes progress: the tables and one full chunk
+    size_t getMinUploadBudget() const;
+
+    glm::ivec3 getWindowChunks() const { return windowChunks; }
+    size_t getResidentChunks() const { return resident.size(); }
+    size_t getPoolCapacity() const { return poolCapacity; }
+    size_t getPoolUsed() const { return poolCapacity - freeBricks.size(); }
+    size_t getPendingLoads() const;
+    uint64_t getEvictions() const { return evictions; }
+
+    static std::string getChunkFileName(const std::string& directory, glm::ivec3 chunk);
+    // writes the chunks of world that are not entirely empty, chunk coordinates are world voxel coordinates / CHUNK_SIZE
+    static void writeChunks(const VoxelWorld& world, const std::string& directory);
+    // procedural terrain of chunks x chunks columns around the origin, generated chunk by chunk so any size fits in memory
+    static void generateTerrain(const std::string& directory, int chunks);
+
+private:
+    struct ResidentChunk {
+        std::vector<uint32_t> table;    // brick table with pool slots, left empty for chunks without a file
+        std::vector<uint32_t> bricks;   // pool slots
+        uint64_t lastUsed = 0;
+        uint64_t residentSince = 0;
+    };
+
+    struct LoadedChunk {
+        glm::ivec3 chunk;
+        std::unique_ptr<MappedFile> file;   // nullptr: there is no file, the chunk is empty
+        const ChunkFileHeader* header = nullptr;
+        const uint32_t* table = nullptr;
+        const uint8_t* bricks = nullptr;
+    };
+
+    std::string directory;
+    glm::ivec3 windowChunks;
+    glm::ivec3 windowOrigin{ std::numeric_limits<int>::min() };   // in chunks
+    size_t poolCapacity;
+    uint64_t updateCount = 0;
+    uint64_t evictions = 0;
+
+    std::unordered_map<uint64_t, ResidentChunk> resident;
+    std::unordered_map<uint64_t, uint8_t> coarseMaterials;  // of every chunk seen so far
+    std::vector<uint32_t> freeBricks;
+
+    // window brick map as uploaded
+    std::vector<uint32_t> brickTable;
+    std::vector<uint32_t> coarseTable;
+    bool tablesDirty = true;
+
+    // loader thread
+    std::thread loader;
+    mutable std::mutex mutex;
+    std::condition_variable loaderWake;                     // requests added or results taken
+    std::deque<glm::ivec3> requests;                        // nearest first
+    std::deque<LoadedChunk> results;
+    std::unordered_set<uint64_t> loading;                   // taken by the loader, result not taken yet
+    bool stopping = false;
+
+    static uint64_t getKey(glm::ivec3 chunk);
+    static glm::ivec3 getChunk(uint64_t key);
+    bool isInWindow(glm::ivec3 chunk) const;
+    void loaderLoop();
+    LoadedChunk load(glm::ivec3 chunk) const;
+    bool makeResident(const LoadedChunk& loaded, glm::vec3 cameraPos, size_t& budget, const WriteFunc& write);
+    bool evictFor(size_t brickCount, float distance, glm::vec3 cameraPos);
+    void rebuildTables();
+    size_t getPoolOffset(uint32_t slot) const;
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <glm/glm.hpp>
+
+// ----------------------------------------------------
+// VoxelWorld
+// Sparse brick map: the world is split into bricks of 8x8x8 voxels. A brick
+// table holds one entry per brick that either stores a single material for the
+// whole brick (uniform bricks take no further memory) or points to a brick in
+// the pool with one material byte per voxel. A coarse level on top flags blocks
+// of 4x4x4 bricks that are completely empty, so rays can skip them as a whole.
+//
+// Edits (set(), fill(), fillSphere()) remember the bricks they touch. flushEdits()
+// hands out just the parts of the GPU data those bricks changed, so an edit costs
+// what it touches and not what the world holds.
+
+enum VoxelMaterial : uint8_t {
+    VOXEL_EMPTY = 0,
+    VOXEL_SOLID = 1,
+    VOXEL_WATER = 2
+};
+
+constexpr int BRICK_SIZE = 8;
+constexpr int BRICK_VOXELS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+constexpr uint32_t BRICK_UNIFORM = 0x80000000u; // table entry flag, material in the lowest byte
+constexpr int COARSE_BRICKS = 4;                // bricks per coarse cell along each axis
+constexpr int COARSE_SIZE = COARSE_BRICKS * BRICK_SIZE;
+
+// Layout shared with the shaders (std430), see getGpuSize() / writeGpuData()
+struct VoxelWorldGpuHeader {
+    int32_t origin[3];          // voxel coordinate of the minimum corner
+    int32_t outsideMaterial;    // material of everything outside the world
+    int32_t brickDims[3];       // size in bricks
+    int32_t brickOffset;        // index of the first brick in the data array (in uints)
+    int32_t coarseDims[3];      // size in coarse cells
+    int32_t coarseOffset;       // index of the coarse level in the data array
+};
+
+// writes size bytes at offset into the GPU copy of a world
+using GpuWriteFunc = std::function<void(size_t offset, const void* data, size_t size)>;
+
+class VoxelWorld {
+public:
+    VoxelWorld(glm::ivec3 origin, glm::ivec3 brickDims, VoxelMaterial outside = VOXEL_EMPTY);
+    virtual ~VoxelWorld();
+
+    VoxelMaterial get(glm::ivec3 c) const {
+        const glm::ivec3 p = c - origin;
+        if (p.x < 0 || p.y < 0 || p.z < 0)
+            return outside;
+        const glm::ivec3 brick = p >> BRICK_SIZE_LOG2;
+        if (brick.x >= brickDims.x || brick.y >= brickDims.y || brick.z >= brickDims.z)
+            return outside;
+        const uint32_t entry = brickTable[getBrickIndex(brick)];
+        if (entry & BRICK_UNIFORM)
+            return VoxelMaterial(entry & 0xff);
+        const glm::ivec3 v = p & (BRICK_SIZE - 1);
+        return VoxelMaterial(brickPool[size_t(entry) * BRICK_VOXELS + (v.z * BRICK_SIZE + v.y) * BRICK_SIZE + v.x]);
+    }
+    void set(glm::ivec3 c, VoxelMaterial material);
+    // sets the box [min, max] (inclusive, clipped to the world), bricks it covers completely are
+    // replaced as a whole
+    void fill(glm::ivec3 min, glm::ivec3 max, VoxelMaterial material);
+    // sets the voxels whose centers lie within radius of center
+    void fillSphere(glm::vec3 center, float radius, VoxelMaterial material);
+    // first voxel that is not empty along the ray within maxDistance, previous is the one before it
+    bool raycast(glm::vec3 rayOrigin, glm::vec3 dir, float maxDistance, glm::ivec3& hit, glm::ivec3& previous) const;
+
+    // edge length of the largest cell around c that is known to be empty (COARSE_SIZE
+    // or BRICK_SIZE, aligned to the grid), 1 if there is none
+    int getEmptyCellSize(glm::ivec3 c) const {
+        const glm::ivec3 p = c - origin;
+        if (p.x < 0 || p.y < 0 || p.z < 0)
+            return 1;
+        const glm::ivec3 brick = p >> BRICK_SIZE_LOG2;
+        if (brick.x >= brickDims.x || brick.y >= brickDims.y || brick.z >= brickDims.z)
+            return 1;
+        if (coarseTable[getCoarseIndex(brick >> COARSE_BRICKS_LOG2)])
+            return COARSE_SIZE;
+        return brickTable[getBrickIndex(brick)] == (BRICK_UNIFORM | VOXEL_EMPTY) ? BRICK_SIZE : 1;
+    }
+
+    // collapses bricks that ended up with a single material, repacks the pool and
+    // rebuilds the coarse level (set() only ever clears coarse cells)
+    void compact();
+
+    // bricks changed since the last flushEdits() or clearEdits()
+    bool hasEdits() const { return !dirtyBricks.empty(); }
+    size_t getEditedBricks() const { return dirtyBricks.size(); }
+    // construction and compact() move bricks around, a GPU copy has to be written anew with writeGpuData()
+    bool needsFullUpload() const { return fullUploadNeeded; }
+    // call once the GPU copy is written anew, the edits so far are part of it
+    void clearEdits();
+    // writes the table entries, bricks and coarse cells the edits changed, oldest bricks first until
+    // budget bytes are used. Bricks left with a single material become uniform again and their pool
+    // slot is reused, so the GPU copy only grows when edits add bricks (see getGpuSize()). Returns the
+    // number of bricks written, bounds are the voxels they cover (max exclusive)
+    size_t flushEdits(size_t budget, const GpuWriteFunc& write, glm::ivec3& boundsMin, glm::ivec3& boundsMax);
+
+    glm::ivec3 getOrigin() const { return origin; }
+    glm::ivec3 getBrickDims() const { return brickDims; }
+    glm::ivec3 getVoxelDims() const { return brickDims * BRICK_SIZE; }
+    glm::ivec3 getCoarseDims() const { return coarseDims; }
+    VoxelMaterial getOutsideMaterial() const { return outside; }
+    size_t getBrickCount() const { return brickPool.size() / BRICK_VOXELS; }
+    const uint32_t* getBrickTable() const { return brickTable.data(); }
+    const uint8_t* getBrickPool() const { return brickPool.data(); }
+    const uint32_t* getCoarseTable() const { return coarseTable.data(); }
+
+    // size in bytes of the storage buffer contents
+    size_t getGpuSize() const;
+    // writes header, brick table, coarse level and bricks, dst has to hold getGpuSize() bytes
+    void writeGpuData(void* dst) const;
+    // the world written by writeGpuData(), size bytes of it; throws if the sizes do not add up
+    static VoxelWorld fromGpuData(const void* src, size_t size);
+
+    // the scene that used to be hard-coded in screenQuad.frag: a water filled box
+    // with a spherical hole inside a spherical cavity
+    static VoxelWorld createDefaultScene();
+    // rolling hills with lakes in the valleys, open sky (256x64x256 voxels)
+    static VoxelWorld createTerrainScene();
+    // a floor with thin pillars far apart, mostly empty space (256^3 voxels)
+    static VoxelWorld createSparseScene();
+
+    // scene by preset name (see getScenePresets()) or loaded from a .gvox or MagicaVoxel .vox file
+    static VoxelWorld createScene(const std::string& preset);
+    static bool isSceneFile(const std::string& name, const char* extension);
+    static const std::vector<std::string>& getScenePresets();
+
+private:
+    static constexpr int BRICK_SIZE_LOG2 = 3;
+    static constexpr int COARSE_BRICKS_LOG2 = 2;
+
+    glm::ivec3 origin;
+    glm::ivec3 brickDims;
+    glm::ivec3 coarseDims;
+    VoxelMaterial outside;
+
+    std::vector<uint32_t> brickTable;
+    std::vector<uint8_t> brickPool;
+    std::vector<uint32_t> coarseTable;  // 1 if all bricks of the cell are uniformly empty
+
+    std::vector<uint32_t> dirtyBricks;  // table indices in the order of their first edit
+    std::vector<bool> brickDirty;       // by table index
+    std::vector<uint32_t> freeBricks;   // pool slots of bricks that became uniform
+    bool fullUploadNeeded = true;
+
+    size_t getBrickIndex(glm::ivec3 brick) const { return (size_t(brick.z) * brickDims.y + brick.y) * brickDims.x + brick.x; }
+    size_t getCoarseIndex(glm::ivec3 cell) const { return (size_t(cell.z) * coarseDims.y + cell.y) * coarseDims.x + cell.x; }
+    void updateCoarseLevel();
+    bool isCoarseCellEmpty(glm::ivec3 cell) const;
+    void markDirty(size_t brickIndex);
+    // sets the voxels of [min, max] for which inside(voxel) holds; bricks for which covers(brickMin, brickMax)
+    // holds are set as a whole
+    template<typename Inside, typename Covers>
+    void fillRegion(glm::ivec3 min, glm::ivec3 max, VoxelMaterial material, Inside inside, Covers covers);
+};
@@ -0,0 +1,26 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "ubo.glsl"
+
+// shows the traced part of the accumulation image (or the last denoise pass), bilinearly scaled to the swap chain image
+layout(binding = 2, rgba32f) uniform readonly image2D accumulation;
+layout(binding = 5, rgba32f) uniform readonly image2DArray denoised;
+
+layout(location = 0) out vec4 outColor;
+
+vec4 load(ivec2 pixel) {
+	pixel = clamp(pixel, ivec2(0), ubo.screen - 1);
+	if (ubo.denoise_passes > 0)
+		return imageLoad(denoised, ivec3(pixel, (ubo.denoise_passes - 1) & 1));
+	return imageLoad(accumulation, pixel);
+}
+
+void main() {
+	// pixel centers line up, at full scale this loads exactly the pixel below the fragment
+	vec2 pos = gl_FragCoord.xy * vec2(ubo.screen) / vec2(ubo.display) - 0.5;
+	ivec2 base = ivec2(floor(pos));
+	vec2 f = pos - vec2(base);
+	outColor = mix(mix(load(base), load(base + ivec2(1, 0)), f.x),
+		mix(load(base + ivec2(0, 1)), load(base + ivec2(1, 1)), f.x), f.y);
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+// Random numbers of the path tracer, kept 1:1 with Sampler.cpp. Every sample of a pixel draws a
+// stream of 2D points: the first one jitters the pixel, each bounce takes the next
+
+#define SAMPLER_RANDOM 0
+#define SAMPLER_SOBOL 1
+#define SAMPLER_BLUE_NOISE 2
+#define BLUE_NOISE_SIZE 64u
+
+// BLUE_NOISE_SIZE^2 values in [0, 1), row by row
+layout(std430, binding = 6) readonly buffer BlueNoise {
+	float blueNoiseMask[];
+};
+
+uint pcg(uint v) {
+	uint state = v * uint(747796405) + uint(2891336453);
+	uint word = ((state >> ((state >> uint(28)) + uint(4))) ^ state) * uint(277803737);
+	return (word >> uint(22)) ^ word;
+}
+
+// Laine and Karras' hash: every bit is flipped depending on the bits below it only,
+// an Owen scramble of the bit reversed value
+uint laineKarrasPermutation(uint x, uint seed) {
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return x;
+}
+
+uint nestedUniformScramble(uint x, uint seed) {
+	return bitfieldReverse(laineKarrasPermutation(bitfieldReverse(x), seed));
+}
+
+// second dimension of the Sobol sequence, the first one is the bit reversed index
+uint sobol1(uint index) {
+	uint result = 0u;
+	for (uint v = 1u << 31; index != 0u; index >>= 1, v ^= v >> 1)
+		if ((index & 1u) != 0u)
+			result ^= v;
+	return result;
+}
+
+// the upper 24 bits, exact in a float
+float toUnitFloat(uint x) {
+	return float(x >> 8) * (1.0f / 16777216.0f);
+}
+
+// shuffling the index keeps every power of two long run of samples a (0, m, 2)-net
+vec2 sobolOwen(uint index, uint seed) {
+	index = nestedUniformScramble(index, seed);
+	return vec2(toUnitFloat(nestedUniformScramble(bitfieldReverse(index), pcg(seed ^ 0xa511e9b3u))),
+		toUnitFloat(nestedUniformScramble(sobol1(index), pcg(seed ^ 0x63d83595u))));
+}
+
+vec2 blueNoise(uvec2 pixel, uint index, uint seed) {
+	const uint wrap = BLUE_NOISE_SIZE - 1u;
+	uvec2 p0 = (pixel + uvec2(seed, seed >> 8)) & wrap;
+	// the second coordinate from the opposite quarter of the mask
+	uvec2 p1 = (p0 + BLUE_NOISE_SIZE / 2u) & wrap;
+	vec2 value = vec2(blueNoiseMask[p0.y * BLUE_NOISE_SIZE + p0.x], blueNoiseMask[p1.y * BLUE_NOISE_SIZE + p1.x]);
+	// the R2 sequence in 0.32 fixed point
+	return fract(value + vec2(toUnitFloat(index * 3242174889u), toUnitFloat(index * 2447445414u)));
+}
+
+vec2 randomSample(uint index, uint seed) {
+	uint hash = pcg(seed ^ pcg(index));
+	return vec2(toUnitFloat(hash), toUnitFloat(pcg(hash)));
+}
+
+struct SampleStream {
+	uvec2 pixel;
+	uint index;			// sample of the pixel since its accumulation started
+	uint seed;
+	uint dimension;		// points drawn so far
+};
+
+SampleStream startSampleStream(uvec2 pixel, uint index) {
+	// the blue noise mask decorrelates the pixels by itself, a seed per pixel would destroy its structure
+	uint seed = ubo.sampler_type == SAMPLER_BLUE_NOISE ? pcg(ubo.sample_seed) : pcg(ubo.sample_seed ^ pcg(pixel.x ^ pcg(pixel.y)));
+	return SampleStream(pixel, index, seed, 0u);
+}
+
+// next point of the stream in [0, 1)^2
+vec2 nextSample(inout SampleStream stream) {
+	uint seed = pcg(stream.seed ^ pcg(stream.dimension++));
+	if (ubo.sampler_type == SAMPLER_SOBOL)
+		return sobolOwen(stream.index, seed);
+	if (ubo.sampler_type == SAMPLER_BLUE_NOISE)
+		return blueNoise(stream.pixel, stream.index, seed);
+	return randomSample(stream.index, seed);
+}
@@ -0,0 +1,400 @@
+// Path tracing code shared by screenQuad.frag, trace.comp and wavefront.comp, the
+// including shader only adds its own inputs, outputs and main()
+
+#define M_PI 3.141592
+
+#include "ubo.glsl"
+#include "sampler.glsl"
+
+// quality tiers (see TraceSettings.h) compile their limits in as constants, so the loops get
+// constant bounds and code a tier turns off is removed; without a tier they come from the UBO
+#ifdef QUALITY_TIER
+#define MAX_SAMPLES TIER_MAX_SAMPLES
+#define MAX_STEPS TIER_MAX_STEPS
+#define MAX_TOTAL_REFLECTIONS TIER_MAX_TOTAL_REFLECTIONS
+#define REFRACTION (TIER_REFRACTION != 0)
+#define MAX_DIFFUSE_BOUNCES TIER_MAX_DIFFUSE_BOUNCES
+#define ROULETTE_DEPTH TIER_ROULETTE_DEPTH
+#else
+#define MAX_SAMPLES ubo.max_samples
+#define MAX_STEPS ubo.max_steps
+#define MAX_TOTAL_REFLECTIONS ubo.max_total_reflections
+#define REFRACTION (ubo.refraction != 0)
+#define MAX_DIFFUSE_BOUNCES ubo.max_diffuse_bounces
+#define ROULETTE_DEPTH ubo.roulette_depth
+#endif
+
+#define VOXEL_EMPTY 0
+#define VOXEL_SOLID 1
+#define VOXEL_WATER 2
+#define BRICK_UNIFORM 0x80000000u
+
+// sparse brick map, see VoxelWorld.h
+layout(std430, binding = 1) readonly buffer VoxelWorld {
+	ivec4 origin;		// xyz: minimum voxel, w: material outside the world
+	ivec4 brickDims;	// xyz: size in bricks, w: index of the first brick in data
+	ivec4 coarseDims;	// xyz: size in coarse cells (4x4x4 bricks), w: index of the coarse level in data
+	uint data[];		// brick table, coarse level and the bricks with 4 voxels per uint
+} world;
+
+// running average over the frames since the last reset
+layout(binding = 2, rgba32f) uniform image2D accumulation;
+// shown color and primary hit distance (< 0: nothing hit) of the last two frames, for reprojection
+layout(binding = 3, rgba32f) uniform image2DArray history;
+// what the denoiser needs of the first surface: its normal scaled by its material (0: nothing hit)
+// and its distance (< 0: nothing hit); reprojected pixels only know the distance and leave the normal 0
+layout(binding = 4, rgba32f) uniform writeonly image2D surfaces;
+
+int getMaterial(ivec3 c) {
+	ivec3 p = c - world.origin.xyz;
+	ivec3 brick = p >> 3;
+	if (any(lessThan(p, ivec3(0))) || any(greaterThanEqual(brick, world.brickDims.xyz)))
+		return world.origin.w;
+	uint entry = world.data[(brick.z * world.brickDims.y + brick.y) * world.brickDims.x + brick.x];
+	if ((entry & BRICK_UNIFORM) != 0u)
+		return int(entry & 0xffu);
+	ivec3 v = p & 7;
+	uint index = entry * 512u + uint((v.z * 8 + v.y) * 8 + v.x);
+	return int((world.data[uint(world.brickDims.w) + (index >> 2)] >> ((index & 3u) * 8u)) & 0xffu);
+}
+
+// edge length of the largest empty cell around c, 1 if there is none
+int getEmptyCellSize(ivec3 c) {
+	ivec3 p = c - world.origin.xyz;
+	ivec3 brick = p >> 3;
+	if (any(lessThan(p, ivec3(0))) || any(greaterThanEqual(brick, world.brickDims.xyz)))
+		return 1;
+	ivec3 cell = brick >> 2;
+	if (world.data[world.coarseDims.w + (cell.z * world.coarseDims.y + cell.y) * world.coarseDims.x + cell.x] != 0u)
+		return 32;
+	return world.data[(brick.z * world.brickDims.y + brick.y) * world.brickDims.x + brick.x] == (BRICK_UNIFORM | VOXEL_EMPTY) ? 8 : 1;
+}
+
+float prng (float p) {
+	return float(pcg(uint(p))) / float(uint(0xffffffff));
+}
+
+vec3 cosineSampleHemisphere(vec3 n, vec2 u)
+{
+	float r = sqrt(u.x);
+	float theta = 2.0 * M_PI * u.y;
+	vec3  B = normalize( cross( n, vec3(0.0,1.0,1.0) ) );
+	vec3  T = cross( B, n );
+	return normalize(r * sin(theta) * B + sqrt(1.0 - u.x) * n + r * cos(theta) * T);
+}
+
+void restartDDA(ivec3 currentVoxel, inout vec3 rayPos, vec3 rayDir, vec3 newRayDir, bvec3 mask, inout vec3 deltaDist, inout ivec3 step, inout vec3 sideDist) {
+	float d = 0.0f;
+	vec3 dist = sideDist - deltaDist;
+	if (mask.x) {
+		d = dist.x;
+	}
+	if (mask.y) {
+		d = dist.y;
+	}
+	if (mask.z) {
+		d = dist.z;
+	}
+	rayPos = rayPos + rayDir * d + 0.01 * newRayDir;
+	//length of ray from one x or y-side to next x or y-side
+	deltaDist = abs(vec3(length(newRayDir)) / newRayDir);
+
+	//length of ray from current position to next x or y-side
+	step = ivec3(sign(newRayDir));
+	sideDist = (step * (vec3(currentVoxel) - rayPos) + (step * 0.5f) + 0.5f) * deltaDist;
+}
+
+vec3 refractRay(vec3 rayDir, vec3 normal, float ior1, float ior2) {
+	float frac = ior1 / ior2;
+	float cos_theta = dot(-rayDir, normal);
+	float sin_2_theta = frac * frac * (1 - cos_theta * cos_theta);
+
+	if (ior1 > ior2) {
+		if (asin(ior2 / ior1) <= acos(cos_theta)) { // total internal reflection
+			return normalize(rayDir + 2 * (cos_theta + 0.1f * prng(cos_theta)) * normal);
+		}
+	}
+
+	return normalize(frac * rayDir + (frac * cos_theta - sqrt(1 - sin_2_theta)) * normal);
+}
+
+vec3 mask2normal(vec3 rayDir, bvec3 mask) {
+	vec3 normal = vec3(0.0f);
+	if (mask.x) normal.x = 1;
+	if (mask.y) normal.y = 1;
+	if (mask.z) normal.z = 1;
+
+	return normalize(-1 * sign(rayDir) * normal);
+}
+
+// state of a path between two steps of its DDA loop, all paths run the same loop: a megakernel
+// (tracePixel) runs it to the end, the wavefront kernels in steps (see wavefront.comp)
+struct PathState {
+	vec3 rayPos;
+	vec3 rayDir;				// of the primary ray, bounces only restart the DDA
+	vec3 deltaDist;
+	vec3 sideDist;
+	ivec3 step;
+	ivec3 currentVoxel;
+	bvec3 mask;					// axis of the last step, none before the first
+	vec3 throughput;
+	bool lastWater;
+	int steps;
+	int totalReflectionCount;
+	int diffuseBounces;
+};
+
+#define PATH_MARCHING 0
+#define PATH_HIT 1				// reached a light
+#define PATH_ENDED 2			// ended without reaching a light, like a miss
+
+// primary ray through shiftedUV
+PathState startPath(vec2 shiftedUV, mat4 PInv, mat4 VInv) {
+	PathState path;
+	vec4 dirEye = PInv * vec4(shiftedUV * 2.0f - 1.0f, -1.0f, 1.0f);
+	dirEye.w = 0.;
+	vec3 dirWorld = (VInv * dirEye).xyz;
+	path.rayDir = normalize(dirWorld.xyz);
+	path.rayPos = ubo.pos;
+	path.currentVoxel = ivec3(floor(path.rayPos + 0.0f));
+	path.mask = bvec3(false, false, false);
+	restartDDA(path.currentVoxel, path.rayPos, vec3(0.0f), path.rayDir, path.mask, path.deltaDist, path.step, path.sideDist);
+	path.throughput = vec3(1);
+	path.lastWater = getMaterial(path.currentVoxel) == VOXEL_WATER;
+	path.steps = 0;
+	path.totalReflectionCount = 0;
+	path.diffuseBounces = 0;
+	return path;
+}
+
+// voxels that redirect or end the path: solid ones and the surfaces of water
+bool isPathEvent(PathState path, int material) {
+	return material == VOXEL_SOLID || (REFRACTION && (material == VOXEL_WATER) != path.lastWater);
+}
+
+// the first surface of the path as the denoiser sees it: its normal scaled by its material and its distance;
+// the ray has not been redirected before its first event, sideDist - deltaDist is where it entered the voxel
+vec4 getPathSurface(PathState path, int material) {
+	// both sides of a water surface count as water, a ray starting inside a voxel faces back
+	vec3 surface = (any(path.mask) ? mask2normal(path.rayDir, path.mask) : -path.rayDir) * float(material == VOXEL_SOLID ? VOXEL_SOLID : VOXEL_WATER);
+	return vec4(surface, dot(vec3(path.mask), path.sideDist - path.deltaDist));
+}
+
+// what the voxel the path is in does to it: solid voxels are lights from above and diffuse otherwise,
+// water refracts at its surfaces
+int shadePath(inout PathState path, int material, inout SampleStream samples) {
+	bool water = material == VOXEL_WATER;
+	if (material == VOXEL_SOLID) {
+		vec3 hit_n = mask2normal(path.rayDir, path.mask);
+		if (hit_n.y != 0)
+			return PATH_HIT;
+		if (path.diffuseBounces == MAX_DIFFUSE_BOUNCES)
+			return PATH_ENDED;
+
+		vec3 newRayDir = cosineSampleHemisphere(hit_n, nextSample(samples));
+		path.throughput *= dot(newRayDir, hit_n);
+		// Russian roulette: the surviving paths carry the weight of the ended ones, which keeps the estimate unbiased;
+		// both components of the bounce's point went into the direction, the decision takes a point of its own
+		if (++path.diffuseBounces >= ROULETTE_DEPTH) {
+			float survival = min(max(path.throughput.r, max(path.throughput.g, path.throughput.b)), 1.0f);
+			if (nextSample(samples).x >= survival)
+				return PATH_ENDED;
+			path.throughput /= survival;
+		}
+		restartDDA(path.currentVoxel, path.rayPos, path.rayDir, newRayDir, path.mask, path.deltaDist, path.step, path.sideDist);
+	} else if (REFRACTION) {
+		if (!path.lastWater && water) {
+			vec3 newRayDir = refractRay(path.rayDir, mask2normal(path.rayDir, path.mask), 1.000293f, 1.333f);
+			path.throughput *= 0.98;
+			restartDDA(path.currentVoxel, path.rayPos, path.rayDir, newRayDir, path.mask, path.deltaDist, path.step, path.sideDist);
+		} else if (path.lastWater && !water) {
+			vec3 newRayDir = refractRay(path.rayDir, mask2normal(path.rayDir, path.mask), 1.333f, 1.000293f);
+			path.throughput *= 0.98;
+			if (dot(newRayDir, path.rayDir) >= 0) ++path.totalReflectionCount;
+			if (path.totalReflectionCount < MAX_TOTAL_REFLECTIONS)
+				restartDDA(path.currentVoxel, path.rayPos, path.rayDir, newRayDir, path.mask, path.deltaDist, path.step, path.sideDist);
+		}
+	}
+
+	path.lastWater = water;
+	return PATH_MARCHING;
+}
+
+// steps the path out of its voxel, or out of the whole empty cell around it in a single step: every axis counts
+// the voxel planes to the far side of the cell, the nearest of those exits is taken and the other axes advance by
+// the planes they cross before it. Cells of a single voxel take exactly the one step of the plain DDA, degenerate
+// rays (NaN direction) are left to the step limit
+void stepPath(inout PathState path, int material) {
+	int cellSize = material == VOXEL_EMPTY ? getEmptyCellSize(path.currentVoxel) : 1;
+	if (cellSize == 1) {
+		// the same as the general case below with every count 0 or 1
+		if (path.sideDist.x < path.sideDist.y)
+			path.mask = path.sideDist.x < path.sideDist.z ? bvec3(true, false, false) : bvec3(false, false, true);
+		else
+			path.mask = path.sideDist.y < path.sideDist.z ? bvec3(false, true, false) : bvec3(false, false, true);
+		path.sideDist = mix(path.sideDist, path.sideDist + path.deltaDist, path.mask);
+		path.currentVoxel += path.step * ivec3(path.mask);
+		++path.steps;
+		return;
+	}
+	ivec3 low = world.origin.xyz + ((path.currentVoxel - world.origin.xyz) & ~(cellSize - 1));
+	ivec3 exits = mix(path.currentVoxel - low + 1, low + cellSize - path.currentVoxel, greaterThan(path.step, ivec3(0)));
+	// axes without direction have infinite distances, multiplying them by 0 would give NaN
+	vec3 exitDist = mix(path.sideDist, path.sideDist + vec3(exits - 1) * path.deltaDist, greaterThan(exits, ivec3(1)));
+
+	if (exitDist.x < exitDist.y)
+		path.mask = exitDist.x < exitDist.z ? bvec3(true, false, false) : bvec3(false, false, true);
+	else
+		path.mask = exitDist.y < exitDist.z ? bvec3(false, true, false) : bvec3(false, false, true);
+	float exitDistance = path.mask.x ? exitDist.x : (path.mask.y ? exitDist.y : exitDist.z);
+
+	vec3 crossings = min(ceil((exitDistance - path.sideDist) / path.deltaDist), vec3(exits - 1));
+	ivec3 counts = mix(ivec3(mix(vec3(0.0f), crossings, lessThan(path.sideDist, vec3(exitDistance)))), exits, path.mask);
+	path.sideDist = mix(path.sideDist, path.sideDist + vec3(counts) * path.deltaDist, greaterThan(counts, ivec3(0)));
+	path.currentVoxel += path.step * counts;
+	++path.steps;
+}
+
+// jittered primary ray of one sample of the pixel at UV
+PathState startSample(vec2 UV, inout SampleStream samples, mat4 PInv, mat4 VInv) {
+	vec2 shiftedUV = UV + (nextSample(samples) - 0.5f) / vec2(ubo.screen);
+	return startPath(shiftedUV, PInv, VInv);
+}
+
+// the samples of all frames since the pixel started to accumulate form one sequence
+uint getFirstSample(ivec2 pixel) {
+	return uint(getAccumulatedFrames(pixel) * MAX_SAMPLES);
+}
+
+// path traces the pixel at UV (0..1, y up) with MAX_SAMPLES samples, hitDistance is the distance
+// to the first surface the first sample meets and hitSurface its normal scaled by its material
+vec4 tracePixel(vec2 UV, ivec2 pixel, out float hitDistance, out vec3 hitSurface) {
+	mat4 PInv = inverse(ubo.proj);
+	mat4 VInv = inverse(ubo.view);
+
+	vec4 color = vec4(0);
+	hitDistance = -1.0f;
+	hitSurface = vec3(0.0f);
+	uint firstSample = getFirstSample(pixel);
+
+	for (int sampling = 0; sampling < MAX_SAMPLES; ++sampling) {
+		SampleStream samples = startSampleStream(uvec2(pixel), firstSample + uint(sampling));
+		PathState path = startSample(UV, samples, PInv, VInv);
+
+		// perform DDA
+		int status = PATH_MARCHING;
+		while (path.steps < MAX_STEPS) {
+			int material = getMaterial(path.currentVoxel);
+			if (sampling == 0 && hitDistance < 0.0f && isPathEvent(path, material)) {
+				vec4 surface = getPathSurface(path, material);
+				hitSurface = surface.xyz;
+				hitDistance = surface.w;
+			}
+			status = shadePath(path, material, samples);
+			if (status != PATH_MARCHING)
+				break;
+			stepPath(path, material);
+		}
+		if (status == PATH_HIT) {
+			color += vec4(path.throughput, 1.0f);
+		}
+	}
+
+	color /= MAX_SAMPLES;
+	return color;
+}
+
+// adds a new frame to the running average of the pixel, returns the average
+vec4 accumulate(ivec2 pixel, vec4 color) {
+	int frames = getAccumulatedFrames(pixel);
+	if (frames > 0)
+		color = (imageLoad(accumulation, pixel) * frames + color) / (frames + 1);
+	imageStore(accumulation, pixel, color);
+	return color;
+}
+
+bool isTraced(ivec2 pixel) {
+	if (ubo.interleave <= 1)
+		return true;
+	if (ubo.interleave == 2)
+		return ((pixel.x + pixel.y + ubo.interleave_phase) & 1) == 0;
+	// diagonal neighbours first, so two consecutive frames cover the block like a checkerboard
+	const int order[4] = int[](0, 3, 1, 2);
+	return (pixel.x & 1) + 2 * (pixel.y & 1) == order[ubo.interleave_phase & 3];
+}
+
+// color of the pixel taken from the previous frame: the ray of the pixel is followed to the depth the previous
+// frame saw (first at the same pixel, then refined at the reprojected one) and that point is projected with the
+// previous camera
+vec4 reproject(vec2 UV, ivec2 pixel, out float hitDistance) {
+	const float FAR = 10000.0f; // nothing hit, only the direction matters
+	int previousLayer = 1 - ubo.history_layer;
+
+	vec4 dirEye = inverse(ubo.proj) * vec4(UV * 2.0f - 1.0f, -1.0f, 1.0f);
+	dirEye.w = 0.;
+	vec3 rayDir = normalize((inverse(ubo.view) * dirEye).xyz);
+	vec3 previousPos = inverse(ubo.prev_view)[3].xyz;
+
+	vec4 previous = imageLoad(history, ivec3(pixel, previousLayer));
+	float depth = previous.a;
+	for (int i = 0; i < 2; ++i) {
+		vec3 point = ubo.pos + rayDir * (depth < 0.0f ? FAR : depth);
+		vec4 clip = ubo.prev_proj * ubo.prev_view * vec4(point, 1.0f);
+		if (clip.w <= 0.0f)
+			break;
+		vec2 previousUV = clip.xy / clip.w * 0.5f + 0.5f;
+		ivec2 previousPixel = ivec2(floor(vec2(previousUV.x, 1.0f - previousUV.y) * ubo.screen));
+		if (any(lessThan(previousPixel, ivec2(0))) || any(greaterThanEqual(previousPixel, ubo.screen)))
+			break; // off screen before, keep what the pixel showed
+
+		previous = imageLoad(history, ivec3(previousPixel, previousLayer));
+		depth = previous.a < 0.0f ? -1.0f : length(previousPos + normalize(point - previousPos) * previous.a - ubo.pos);
+	}
+
+	hitDistance = depth;
+	return vec4(previous.rgb, 1.0f);
+}
+
+// a moving camera leaves the denoiser a single frame: the traced color is blended with what the previous
+// frame showed at the same surface, disoccluded pixels keep the traced color
+vec4 blendHistory(vec2 UV, ivec2 pixel, vec4 color, float hitDistance) {
+	float previousDistance;
+	vec4 previous = reproject(UV, pixel, previousDistance);
+	bool sameSurface = hitDistance < 0.0f ? previousDistance < 0.0f : abs(previousDistance - hitDistance) < 0.5f + 0.05f * hitDistance;
+	if (sameSurface)
+		color.rgb = mix(previous.rgb, color.rgb, 0.2f);
+	return color;
+}
+
+// adds the color of a traced pixel, or its reprojection if interleaving skips it this frame, to the
+// accumulation and the history, returns the color to show
+vec4 resolvePixel(vec2 UV, ivec2 pixel, bool traced, vec4 color, float hitDistance, vec3 hitSurface) {
+	if (traced) {
+		if (ubo.denoise_passes > 0) {
+			imageStore(surfaces, pixel, vec4(hitSurface, hitDistance));
+			if (ubo.denoise_history != 0)
+				color = blendHistory(UV, pixel, color, hitDistance);
+		}
+	}
+	else {
+		color = reproject(UV, pixel, hitDistance);
+		if (ubo.denoise_passes > 0)
+			imageStore(surfaces, pixel, vec4(vec3(0.0f), hitDistance));
+	}
+	color = accumulate(pixel, color);
+	if (ubo.interleave > 0)
+		imageStore(history, ivec3(pixel, ubo.history_layer), vec4(color.rgb, hitDistance));
+	return color;
+}
+
+// traces the pixel or reprojects it if interleaving skips it this frame, then adds it to the
+// accumulation and the history, returns the color to show
+vec4 renderPixel(vec2 UV, ivec2 pixel) {
+	float hitDistance = -1.0f;
+	vec3 hitSurface = vec3(0.0f);
+	vec4 color = vec4(0.0f);
+	bool traced = isTraced(pixel);
+	if (traced)
+		color = tracePixel(UV, pixel, hitDistance, hitSurface);
+	return resolvePixel(UV, pixel, traced, color, hitDistance, hitSurface);
+}
\ No newline at end of file
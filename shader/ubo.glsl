@@ -0,0 +1,35 @@
+// Uniform buffer shared by all shaders, same layout as UniformBufferObject in Renderer.cpp
+
+layout(binding = 0) uniform UniformBufferObject {
+	int max_samples;
+	int max_steps;
+	int max_total_reflections;
+	uint sample_seed;		// seeds the samples of all frames since the last reset, see sampler.glsl
+	ivec2 screen;			// traced pixels, the top left part of the accumulation image
+	int accumulated_frames;	// frames averaged in the accumulation image so far
+	int refraction;			// 0: water does not bend rays
+	ivec2 display;			// pixels of the swap chain image the trace is scaled to
+	int interleave;			// 0: no history, 1: every pixel traced, 2: checkerboard, 4: one pixel of each 2x2 block
+	int interleave_phase;	// which pixels are traced this frame
+	vec3 pos;
+	int history_layer;		// layer of the history image written this frame, the other one holds the previous frame
+	mat4 view;
+	mat4 proj;
+	mat4 prev_view;			// camera of the previous frame
+	mat4 prev_proj;
+	ivec4 reset_rect;		// pixels [xy, zw) started to accumulate anew after an edit of the scene
+	int reset_frames;		// frames averaged inside reset_rect so far
+	int denoise_passes;		// 0: the accumulation image is shown as it is
+	float denoise_strength;	// color tolerance of the first denoise pass, for a single frame
+	int denoise_history;	// 1: traced pixels are blended with their reprojected history before the accumulation
+	int sampler_type;	// SAMPLER_RANDOM, SAMPLER_SOBOL or SAMPLER_BLUE_NOISE
+	int max_diffuse_bounces;
+	int roulette_depth;		// diffuse bounces after which Russian roulette may end a path
+} ubo;
+
+// frames averaged at the pixel before this one
+int getAccumulatedFrames(ivec2 pixel) {
+	if (all(greaterThanEqual(pixel, ubo.reset_rect.xy)) && all(lessThan(pixel, ubo.reset_rect.zw)))
+		return ubo.reset_frames;
+	return ubo.accumulated_frames;
+}
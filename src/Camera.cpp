@@ -1,4 +1,4 @@
-#include "camera.h"
+#include "Camera.h"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/rotate_vector.hpp>
@@ -55,4 +55,10 @@ void Camera::pitch(float angle) {
     dir = glm::normalize(glm::rotate(dir, angle * float(M_PI) / 180.f, glm::normalize(glm::cross(dir, up))));
     up = glm::normalize(glm::cross(glm::cross(dir, up), dir));
 }
-void Camera::roll(float angle) { up = glm::normalize(glm::rotate(up, angle * float(M_PI) / 180.f, dir)); }
\ No newline at end of file
+void Camera::roll(float angle) { up = glm::normalize(glm::rotate(up, angle * float(M_PI) / 180.f, dir)); }
+void Camera::set_yaw_pitch(float yaw_degree, float pitch_degree) {
+    const float yaw = yaw_degree * float(M_PI) / 180.f;
+    const float pitch = pitch_degree * float(M_PI) / 180.f;
+    dir = glm::vec3(std::cos(pitch) * std::cos(yaw), std::sin(pitch), std::cos(pitch) * std::sin(yaw));
+    up = glm::vec3(0, 1, 0);
+}
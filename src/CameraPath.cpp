@@ -0,0 +1,98 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cmath>
+
+CameraPath::CameraPath(std::vector<Keyframe> keyframes) :
+	keyframes(std::move(keyframes))
+{
+	std::stable_sort(this->keyframes.begin(), this->keyframes.end(), [](const Keyframe& a, const Keyframe& b) { return a.time < b.time; });
+}
+
+CameraPath::~CameraPath() {
+
+}
+
+CameraPath CameraPath::load(const std::string& fileName) {
+	std::ifstream file(fileName);
+	if (!file.is_open())
+		throw std::runtime_error("Could not open camera path " + fileName + "!");
+
+	std::vector<Keyframe> keyframes;
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line)) {
+		++lineNumber;
+		line = line.substr(0, line.find('#'));
+		if (line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+
+		std::istringstream stream(line);
+		Keyframe key;
+		if (!(stream >> key.time >> key.pos.x >> key.pos.y >> key.pos.z >> key.yaw >> key.pitch))
+			throw std::runtime_error("Invalid keyframe in " + fileName + " line " + std::to_string(lineNumber) + "!");
+		keyframes.push_back(key);
+	}
+
+	if (keyframes.empty())
+		throw std::runtime_error("Camera path " + fileName + " has no keyframes!");
+	return CameraPath(std::move(keyframes));
+}
+
+void CameraPath::save(const std::string& fileName) const {
+	std::ofstream file(fileName);
+	if (!file.is_open())
+		throw std::runtime_error("Could not open file " + fileName + "!");
+
+	file << "# time x y z yaw pitch\n";
+	for (const Keyframe& key : keyframes)
+		file << key.time << " " << key.pos.x << " " << key.pos.y << " " << key.pos.z << " " << key.yaw << " " << key.pitch << "\n";
+}
+
+CameraPath CameraPath::createOrbit(float radius, float height, float duration, int keyframeCount) {
+	std::vector<Keyframe> keyframes;
+	const float pitch = -std::atan2(height, radius) * 180.0f / 3.14159265f;
+	for (int i = 0; i <= keyframeCount; ++i) {
+		const float angle = 360.0f * i / keyframeCount;
+		const float rad = angle * 3.14159265f / 180.0f;
+		Keyframe key;
+		key.time = duration * i / keyframeCount;
+		key.pos = glm::vec3(radius * std::cos(rad), height, radius * std::sin(rad));
+		// look back at the center, yaw keeps growing so the interpolation never turns the long way round
+		key.yaw = angle + 180.0f;
+		key.pitch = pitch;
+		keyframes.push_back(key);
+	}
+	return CameraPath(std::move(keyframes));
+}
+
+void CameraPath::apply(Camera& camera, float time) const {
+	if (keyframes.empty())
+		return;
+
+	// first keyframe after time
+	auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float t, const Keyframe& key) { return t < key.time; });
+	Keyframe key;
+	if (next == keyframes.begin()) {
+		key = keyframes.front();
+	}
+	else if (next == keyframes.end()) {
+		key = keyframes.back();
+	}
+	else {
+		const Keyframe& a = *(next - 1);
+		const Keyframe& b = *next;
+		const float t = (time - a.time) / (b.time - a.time);
+		key.pos = glm::mix(a.pos, b.pos, t);
+		key.yaw = a.yaw + (b.yaw - a.yaw) * t;
+		key.pitch = a.pitch + (b.pitch - a.pitch) * t;
+	}
+
+	camera.pos = key.pos;
+	// lookAt degenerates when looking straight up or down
+	camera.set_yaw_pitch(key.yaw, std::clamp(key.pitch, -89.0f, 89.0f));
+	camera.update();
+}
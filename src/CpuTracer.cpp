@@ -0,0 +1,438 @@
+#include "CpuTracer.h"
+
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <bit>
+
+#define M_PI_F 3.141592f
+
+// ----------------------------------------------------
+// Helpers, kept 1:1 with trace.glsl
+
+static float prng(float p) {
+	// float to uint conversion of negative values wraps like on the GPU instead of being undefined
+	return float(pcg(uint32_t(int64_t(p)))) / float(0xffffffffu);
+}
+
+static glm::vec3 cosineSampleHemisphere(glm::vec3 n, glm::vec2 u) {
+	float r = std::sqrt(u.x);
+	float theta = 2.0f * M_PI_F * u.y;
+	glm::vec3 B = glm::normalize(glm::cross(n, glm::vec3(0.0f, 1.0f, 1.0f)));
+	glm::vec3 T = glm::cross(B, n);
+	return glm::normalize(r * std::sin(theta) * B + std::sqrt(1.0f - u.x) * n + r * std::cos(theta) * T);
+}
+
+static void restartDDA(glm::ivec3 currentVoxel, glm::vec3& rayPos, glm::vec3 rayDir, glm::vec3 newRayDir, glm::bvec3 mask, glm::vec3& deltaDist, glm::ivec3& step, glm::vec3& sideDist) {
+	float d = 0.0f;
+	glm::vec3 dist = sideDist - deltaDist;
+	if (mask.x) d = dist.x;
+	if (mask.y) d = dist.y;
+	if (mask.z) d = dist.z;
+	rayPos = rayPos + rayDir * d + 0.01f * newRayDir;
+	// length of ray from one x or y-side to next x or y-side
+	deltaDist = glm::abs(glm::vec3(glm::length(newRayDir)) / newRayDir);
+
+	// length of ray from current position to next x or y-side
+	step = glm::ivec3(glm::sign(newRayDir));
+	const glm::vec3 fstep = glm::vec3(step);
+	sideDist = (fstep * (glm::vec3(currentVoxel) - rayPos) + (fstep * 0.5f) + 0.5f) * deltaDist;
+}
+
+static glm::vec3 refractRay(glm::vec3 rayDir, glm::vec3 normal, float ior1, float ior2) {
+	float frac = ior1 / ior2;
+	float cos_theta = glm::dot(-rayDir, normal);
+	float sin_2_theta = frac * frac * (1 - cos_theta * cos_theta);
+
+	if (ior1 > ior2) {
+		if (std::asin(ior2 / ior1) <= std::acos(cos_theta)) { // total internal reflection
+			return glm::normalize(rayDir + 2 * (cos_theta + 0.1f * prng(cos_theta)) * normal);
+		}
+	}
+
+	return glm::normalize(frac * rayDir + (frac * cos_theta - std::sqrt(1 - sin_2_theta)) * normal);
+}
+
+static glm::vec3 mask2normal(glm::vec3 rayDir, glm::bvec3 mask) {
+	glm::vec3 normal = glm::vec3(0.0f);
+	if (mask.x) normal.x = 1;
+	if (mask.y) normal.y = 1;
+	if (mask.z) normal.z = 1;
+
+	return glm::normalize(-1.0f * glm::sign(rayDir) * normal);
+}
+
+// ----------------------------------------------------
+// CpuTracer
+
+// interleaves the lower 16 bits of x and y
+static uint32_t mortonCode(uint32_t x, uint32_t y) {
+	auto spread = [](uint32_t v) {
+		v &= 0x0000ffff;
+		v = (v | (v << 8)) & 0x00ff00ff;
+		v = (v | (v << 4)) & 0x0f0f0f0f;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	};
+	return spread(x) | (spread(y) << 1);
+}
+
+static uint64_t packRange(uint32_t begin, uint32_t end) { return (uint64_t(begin) << 32) | end; }
+
+CpuTracer::CpuTracer(const VoxelWorld& world, uint32_t threadCount) : world(world), threadCount(threadCount) {
+	if (this->threadCount == 0)
+		this->threadCount = std::max(1u, std::thread::hardware_concurrency());
+	queues = std::make_unique<WorkQueue[]>(this->threadCount);
+}
+
+CpuTracer::~CpuTracer() {
+
+}
+
+void CpuTracer::render(const Camera& camera, uint32_t width, uint32_t height, std::vector<glm::vec4>& image) {
+	image.resize(size_t(width) * height);
+	if (width == 0 || height == 0)
+		return;
+
+	FrameInfo frame;
+	frame.PInv = glm::inverse(camera.proj);
+	frame.VInv = glm::inverse(camera.view);
+	frame.pos = camera.pos;
+	frame.sampleSeed = uint32_t(settings.time);
+	frame.firstSample = accumulatedFrames * uint32_t(settings.max_samples);
+	frame.marchPacket = getMarchPacketFunc(isa);
+	frame.grid.originX = world.getOrigin().x;
+	frame.grid.originY = world.getOrigin().y;
+	frame.grid.originZ = world.getOrigin().z;
+	frame.grid.outsideMaterial = world.getOutsideMaterial();
+	frame.grid.dimsX = world.getBrickDims().x;
+	frame.grid.dimsY = world.getBrickDims().y;
+	frame.grid.dimsZ = world.getBrickDims().z;
+	frame.grid.brickTable = world.getBrickTable();
+	frame.grid.brickPool = world.getBrickPool();
+	frame.grid.coarseDimsX = world.getCoarseDims().x;
+	frame.grid.coarseDimsY = world.getCoarseDims().y;
+	frame.grid.coarseDimsZ = world.getCoarseDims().z;
+	frame.grid.coarseTable = world.getCoarseTable();
+	frame.width = width;
+	frame.height = height;
+	frame.tilesX = (width + tileSize - 1) / tileSize;
+	frame.tilesY = (height + tileSize - 1) / tileSize;
+
+	// walk the tiles along a Z-curve so neighbouring tiles (and their voxels) stay close in time
+	tileOrder.clear();
+	for (uint32_t y = 0; y < frame.tilesY; ++y)
+		for (uint32_t x = 0; x < frame.tilesX; ++x)
+			tileOrder.emplace_back(x, y);
+	std::sort(tileOrder.begin(), tileOrder.end(), [](const glm::uvec2& a, const glm::uvec2& b) {
+		return mortonCode(a.x, a.y) < mortonCode(b.x, b.y);
+	});
+
+	// every worker starts with a contiguous, spatially compact part of the curve
+	const uint32_t tileCount = static_cast<uint32_t>(tileOrder.size());
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		const uint32_t begin = uint32_t(uint64_t(tileCount) * i / threadCount);
+		const uint32_t end = uint32_t(uint64_t(tileCount) * (i + 1) / threadCount);
+		queues[i].range.store(packRange(begin, end));
+	}
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < threadCount; ++i)
+		workers.emplace_back(&CpuTracer::workerLoop, this, i, std::cref(frame), image.data());
+	workerLoop(0, frame, image.data());
+	for (auto& worker : workers)
+		worker.join();
+}
+
+bool CpuTracer::popTile(uint32_t worker, uint32_t& tile) {
+	std::atomic<uint64_t>& range = queues[worker].range;
+	uint64_t current = range.load();
+	while (true) {
+		const uint32_t begin = uint32_t(current >> 32);
+		const uint32_t end = uint32_t(current);
+		if (begin >= end)
+			return false;
+		if (range.compare_exchange_weak(current, packRange(begin + 1, end))) {
+			tile = begin;
+			return true;
+		}
+	}
+}
+
+bool CpuTracer::stealTiles(uint32_t worker) {
+	for (uint32_t i = 1; i < threadCount; ++i) {
+		std::atomic<uint64_t>& victim = queues[(worker + i) % threadCount].range;
+		uint64_t current = victim.load();
+		while (true) {
+			const uint32_t begin = uint32_t(current >> 32);
+			const uint32_t end = uint32_t(current);
+			if (begin >= end)
+				break;
+			// take the back half, the owner keeps working on the front
+			const uint32_t split = end - (end - begin + 1) / 2;
+			if (victim.compare_exchange_weak(current, packRange(begin, split))) {
+				queues[worker].range.store(packRange(split, end));
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void CpuTracer::workerLoop(uint32_t worker, const FrameInfo& frame, glm::vec4* image) {
+	uint32_t tile;
+	do {
+		while (popTile(worker, tile))
+			traceTile(frame, tileOrder[tile], image);
+	} while (stealTiles(worker));
+}
+
+void CpuTracer::traceTile(const FrameInfo& frame, glm::uvec2 tile, glm::vec4* image) const {
+	const uint32_t x0 = tile.x * tileSize, y0 = tile.y * tileSize;
+	const uint32_t x1 = std::min(x0 + tileSize, frame.width), y1 = std::min(y0 + tileSize, frame.height);
+
+	if (frame.marchPacket) {
+		// packets cover a small block of pixels, 2x2 for SSE, 4x2 for AVX2 and 4x4 for AVX-512
+		const uint32_t packetSize = uint32_t(isa);
+		const uint32_t blockWidth = packetSize == 4 ? 2 : 4;
+		const uint32_t blockHeight = packetSize / blockWidth;
+		for (uint32_t y = y0; y < y1; y += blockHeight)
+			for (uint32_t x = x0; x < x1; x += blockWidth)
+				tracePacket(frame, glm::uvec2(x, y), glm::uvec2(std::min(x + blockWidth, x1), std::min(y + blockHeight, y1)), blockWidth, image);
+		return;
+	}
+
+	for (uint32_t y = y0; y < y1; ++y) {
+		for (uint32_t x = x0; x < x1; ++x) {
+			image[size_t(y) * frame.width + x] = tracePixel(frame, glm::uvec2(x, y));
+		}
+	}
+}
+
+glm::vec2 CpuTracer::pixelUV(const FrameInfo& frame, uint32_t x, uint32_t y) {
+	// same UV as the fullscreen triangle: pixel centers, V pointing up
+	return glm::vec2((x + 0.5f) / frame.width, 1.0f - (y + 0.5f) / frame.height);
+}
+
+CpuTracer::RayState CpuTracer::startRay(const FrameInfo& frame, glm::uvec2 pixel, int sampling) const {
+	RayState ray;
+	ray.samples = startSampleStream(sampler, pixel, frame.firstSample + uint32_t(sampling), frame.sampleSeed);
+	const glm::vec2 shiftedUV = pixelUV(frame, pixel.x, pixel.y) + (nextSample(ray.samples) - 0.5f) / glm::vec2(frame.width, frame.height);
+	glm::vec4 dirEye = frame.PInv * glm::vec4(shiftedUV * 2.0f - 1.0f, -1.0f, 1.0f);
+	dirEye.w = 0.0f;
+	glm::vec3 dirWorld = glm::vec3(frame.VInv * dirEye);
+	ray.rayDir = glm::normalize(dirWorld);
+	ray.rayPos = frame.pos;
+	ray.currentVoxel = glm::ivec3(glm::floor(ray.rayPos + 0.0f));
+	ray.mask = glm::bvec3(false, false, false);
+
+	restartDDA(ray.currentVoxel, ray.rayPos, glm::vec3(0.0f), ray.rayDir, ray.mask, ray.deltaDist, ray.step, ray.sideDist);
+
+	ray.throughput = glm::vec3(1);
+	ray.last_water = world.get(ray.currentVoxel) == VOXEL_WATER;
+	ray.i = 0;
+	ray.totalReflectionCount = 0;
+	ray.diffuseBounces = 0;
+	return ray;
+}
+
+// one iteration of the DDA loop of tracePixel in trace.glsl (shadePath and stepPath)
+CpuTracer::RayStatus CpuTracer::iterate(RayState& ray) const {
+	if (ray.i >= settings.max_steps)
+		return RayStatus::MISSED;
+
+	VoxelMaterial material = world.get(ray.currentVoxel);
+	bool water = material == VOXEL_WATER;
+	if (material == VOXEL_SOLID) {
+		glm::vec3 hit_n = mask2normal(ray.rayDir, ray.mask);
+		if (hit_n.y != 0)
+			return RayStatus::HIT;
+		if (ray.diffuseBounces == settings.max_diffuse_bounces)
+			return RayStatus::MISSED;
+
+		glm::vec3 newRayDir = cosineSampleHemisphere(hit_n, nextSample(ray.samples));
+		ray.throughput *= glm::dot(newRayDir, hit_n);
+		// Russian roulette: the surviving paths carry the weight of the ended ones, which keeps the estimate unbiased
+		if (++ray.diffuseBounces >= settings.roulette_depth) {
+			const float survival = std::min(std::max(ray.throughput.x, std::max(ray.throughput.y, ray.throughput.z)), 1.0f);
+			if (nextSample(ray.samples).x >= survival)
+				return RayStatus::MISSED;
+			ray.throughput /= survival;
+		}
+		restartDDA(ray.currentVoxel, ray.rayPos, ray.rayDir, newRayDir, ray.mask, ray.deltaDist, ray.step, ray.sideDist);
+	}
+	else if (settings.refraction) {
+		if (!ray.last_water && water) {
+			glm::vec3 newRayDir = refractRay(ray.rayDir, mask2normal(ray.rayDir, ray.mask), 1.000293f, 1.333f);
+			ray.throughput *= 0.98f;
+			restartDDA(ray.currentVoxel, ray.rayPos, ray.rayDir, newRayDir, ray.mask, ray.deltaDist, ray.step, ray.sideDist);
+		}
+		else if (ray.last_water && !water) {
+			glm::vec3 newRayDir = refractRay(ray.rayDir, mask2normal(ray.rayDir, ray.mask), 1.333f, 1.000293f);
+			ray.throughput *= 0.98f;
+			if (glm::dot(newRayDir, ray.rayDir) >= 0) ++ray.totalReflectionCount;
+			if (ray.totalReflectionCount < settings.max_total_reflections)
+				restartDDA(ray.currentVoxel, ray.rayPos, ray.rayDir, newRayDir, ray.mask, ray.deltaDist, ray.step, ray.sideDist);
+		}
+	}
+
+	ray.last_water = water;
+
+	// leaves the voxel, or the whole empty cell around it in a single step, like stepPath in trace.glsl:
+	// each axis counts the voxel planes to the far side of the cell, the nearest exit is taken and the
+	// other axes advance by the planes they cross before it
+	const int cellSize = material == VOXEL_EMPTY ? world.getEmptyCellSize(ray.currentVoxel) : 1;
+	if (cellSize == 1) {
+		// the same as the general case below with every count 0 or 1
+		const int axis = ray.sideDist.x < ray.sideDist.y ? (ray.sideDist.x < ray.sideDist.z ? 0 : 2) : (ray.sideDist.y < ray.sideDist.z ? 1 : 2);
+		ray.sideDist[axis] += ray.deltaDist[axis];
+		ray.currentVoxel[axis] += ray.step[axis];
+		ray.mask = glm::bvec3(axis == 0, axis == 1, axis == 2);
+		++ray.i;
+		return RayStatus::MARCHING;
+	}
+	const glm::ivec3 low = world.getOrigin() + ((ray.currentVoxel - world.getOrigin()) & ~(cellSize - 1));
+	glm::ivec3 exits;
+	glm::vec3 exitDist;
+	for (int axis = 0; axis < 3; ++axis) {
+		exits[axis] = ray.step[axis] > 0 ? low[axis] + cellSize - ray.currentVoxel[axis] : ray.currentVoxel[axis] - low[axis] + 1;
+		// axes without direction have infinite distances, multiplying them by 0 would give NaN
+		exitDist[axis] = exits[axis] > 1 ? ray.sideDist[axis] + float(exits[axis] - 1) * ray.deltaDist[axis] : ray.sideDist[axis];
+	}
+
+	int exitAxis;
+	if (exitDist.x < exitDist.y)
+		exitAxis = exitDist.x < exitDist.z ? 0 : 2;
+	else
+		exitAxis = exitDist.y < exitDist.z ? 1 : 2;
+	const float exitDistance = exitDist[exitAxis];
+
+	for (int axis = 0; axis < 3; ++axis) {
+		int count = 0;
+		if (axis == exitAxis)
+			count = exits[axis];
+		else if (exits[axis] > 1 && ray.sideDist[axis] < exitDistance)
+			count = int(std::min(std::ceil((exitDistance - ray.sideDist[axis]) / ray.deltaDist[axis]), float(exits[axis] - 1)));
+		if (count > 0)
+			ray.sideDist[axis] += float(count) * ray.deltaDist[axis];
+		ray.currentVoxel[axis] += ray.step[axis] * count;
+		ray.mask[axis] = axis == exitAxis;
+	}
+
+	++ray.i;
+	return RayStatus::MARCHING;
+}
+
+CpuTracer::RayStatus CpuTracer::finishRay(RayState& ray) const {
+	RayStatus status;
+	while ((status = iterate(ray)) == RayStatus::MARCHING);
+	return status;
+}
+
+glm::vec4 CpuTracer::tracePixel(const FrameInfo& frame, glm::uvec2 pixel) const {
+	glm::vec4 outColor = glm::vec4(0);
+
+	for (int sampling = 0; sampling < settings.max_samples; ++sampling) {
+		RayState ray = startRay(frame, pixel, sampling);
+		if (finishRay(ray) == RayStatus::HIT) {
+			outColor += glm::vec4(ray.throughput, 1.0f);
+		}
+	}
+
+	outColor /= float(settings.max_samples);
+	return outColor;
+}
+
+static void packLane(RayPacket& packet, int lane, const CpuTracer::RayState& ray) {
+	packet.sideDistX[lane] = ray.sideDist.x; packet.sideDistY[lane] = ray.sideDist.y; packet.sideDistZ[lane] = ray.sideDist.z;
+	packet.deltaDistX[lane] = ray.deltaDist.x; packet.deltaDistY[lane] = ray.deltaDist.y; packet.deltaDistZ[lane] = ray.deltaDist.z;
+	packet.voxelX[lane] = ray.currentVoxel.x; packet.voxelY[lane] = ray.currentVoxel.y; packet.voxelZ[lane] = ray.currentVoxel.z;
+	packet.stepX[lane] = ray.step.x; packet.stepY[lane] = ray.step.y; packet.stepZ[lane] = ray.step.z;
+	packet.axis[lane] = ray.mask.x ? 0 : ray.mask.y ? 1 : ray.mask.z ? 2 : -1;
+	packet.steps[lane] = ray.i;
+	packet.lastWater[lane] = ray.last_water ? ~0 : 0;
+}
+
+// only the fields the packet kernel advances
+static void unpackLane(const RayPacket& packet, int lane, CpuTracer::RayState& ray) {
+	ray.sideDist = glm::vec3(packet.sideDistX[lane], packet.sideDistY[lane], packet.sideDistZ[lane]);
+	ray.currentVoxel = glm::ivec3(packet.voxelX[lane], packet.voxelY[lane], packet.voxelZ[lane]);
+	const int axis = packet.axis[lane];
+	ray.mask = glm::bvec3(axis == 0, axis == 1, axis == 2);
+	ray.i = packet.steps[lane];
+}
+
+void CpuTracer::tracePacket(const FrameInfo& frame, glm::uvec2 from, glm::uvec2 to, uint32_t blockWidth, glm::vec4* image) const {
+	const uint32_t packetSize = uint32_t(isa);
+
+	glm::uvec2 pixel[MAX_PACKET_SIZE];
+	glm::vec4 outColor[MAX_PACKET_SIZE];
+	RayState rays[MAX_PACKET_SIZE];
+	RayStatus status[MAX_PACKET_SIZE];
+	RayPacket packet;
+
+	uint32_t lanes = 0;
+	for (uint32_t lane = 0; lane < packetSize; ++lane) {
+		const uint32_t x = from.x + lane % blockWidth, y = from.y + lane / blockWidth;
+		if (x < to.x && y < to.y) {
+			lanes |= 1u << lane;
+			pixel[lane] = glm::uvec2(x, y);
+			outColor[lane] = glm::vec4(0);
+		}
+	}
+
+	for (int sampling = 0; sampling < settings.max_samples; ++sampling) {
+		for (uint32_t lane = 0; lane < packetSize; ++lane) {
+			if (!(lanes & (1u << lane)))
+				continue;
+			rays[lane] = startRay(frame, pixel[lane], sampling);
+			status[lane] = RayStatus::MISSED; // stays like this for lanes that run out of steps in the kernel
+			packLane(packet, lane, rays[lane]);
+		}
+		packet.active = lanes;
+
+		while (packet.active) {
+			// a single ray left, the packet does not pay off anymore
+			if ((packet.active & (packet.active - 1)) == 0) {
+				const int lane = std::countr_zero(packet.active);
+				unpackLane(packet, lane, rays[lane]);
+				status[lane] = finishRay(rays[lane]);
+				break;
+			}
+
+			uint32_t events = frame.marchPacket(packet, frame.grid, settings.max_steps);
+			while (events) {
+				const int lane = std::countr_zero(events);
+				events &= events - 1;
+
+				unpackLane(packet, lane, rays[lane]);
+				const RayStatus laneStatus = iterate(rays[lane]);
+				if (laneStatus != RayStatus::MARCHING) {
+					status[lane] = laneStatus;
+					packet.active &= ~(1u << lane);
+				}
+				else if (rays[lane].totalReflectionCount >= settings.max_total_reflections) {
+					// past the reflection cap the ray leaves the packet and ends on the scalar path
+					status[lane] = finishRay(rays[lane]);
+					packet.active &= ~(1u << lane);
+				}
+				else {
+					packLane(packet, lane, rays[lane]);
+				}
+			}
+		}
+
+		for (uint32_t lane = 0; lane < packetSize; ++lane) {
+			if ((lanes & (1u << lane)) && status[lane] == RayStatus::HIT)
+				outColor[lane] += glm::vec4(rays[lane].throughput, 1.0f);
+		}
+	}
+
+	for (uint32_t lane = 0; lane < packetSize; ++lane) {
+		if (!(lanes & (1u << lane)))
+			continue;
+		const uint32_t x = from.x + lane % blockWidth, y = from.y + lane / blockWidth;
+		image[size_t(y) * frame.width + x] = outColor[lane] / float(settings.max_samples);
+	}
+}
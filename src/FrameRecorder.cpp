@@ -0,0 +1,177 @@
+#include "FrameRecorder.h"
+#include "ImageIO.h"
+#include "StringUtil.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+
+FrameRecorder::FrameRecorder(const std::string& pattern, CaptureFormat format, uint32_t threadCount, size_t maxQueued) :
+	pattern(pattern), format(format), maxQueued(std::max<size_t>(maxQueued, 1))
+{
+	if (format == CaptureFormat::RAW) {
+		rawFile.open(pattern, std::ios::binary | std::ios::out | std::ios::trunc);
+		if (!rawFile.is_open())
+			throw std::runtime_error("Could not open file " + pattern + "!");
+	}
+	else if (pattern.find('%') == std::string::npos) {
+		// numbered files need a place for the number, it goes right before the extension
+		const size_t dot = pattern.find_last_of('.');
+		const size_t slash = pattern.find_last_of("/\\");
+		const size_t at = dot == std::string::npos || (slash != std::string::npos && dot < slash) ? pattern.size() : dot;
+		this->pattern = pattern.substr(0, at) + "_%05d" + pattern.substr(at);
+	}
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency() / 2);
+	for (uint32_t i = 0; i < threadCount; ++i)
+		workers.emplace_back(&FrameRecorder::workerLoop, this);
+}
+
+FrameRecorder::~FrameRecorder() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobAdded.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void FrameRecorder::submit(const float* rgba, uint32_t width, uint32_t height) {
+	std::vector<float> pixels;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (jobs.size() + busy >= maxQueued) {
+			const auto start = std::chrono::steady_clock::now();
+			jobDone.wait(lock, [this]() { return jobs.size() + busy < maxQueued; });
+			stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		if (!freeBuffers.empty()) {
+			pixels = std::move(freeBuffers.back());
+			freeBuffers.pop_back();
+		}
+	}
+
+	// the copy happens outside the lock, the source is mapped memory that is reused once this returns
+	pixels.assign(rgba, rgba + size_t(width) * height * 4);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(Frame{ submitted++, width, height, std::move(pixels) });
+	}
+	jobAdded.notify_one();
+}
+
+void FrameRecorder::finish() {
+	std::unique_lock<std::mutex> lock(mutex);
+	jobDone.wait(lock, [this]() { return jobs.empty() && busy == 0; });
+	if (rawFile.is_open())
+		rawFile.flush();
+}
+
+uint64_t FrameRecorder::getWrittenFrames() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return written;
+}
+
+bool FrameRecorder::findFormat(const std::string& fileName, CaptureFormat& format) {
+	const size_t dot = fileName.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+	const std::string extension = fileName.substr(dot + 1);
+
+	if (equalsIgnoreCase(extension, "png")) format = CaptureFormat::PNG;
+	else if (equalsIgnoreCase(extension, "exr")) format = CaptureFormat::EXR;
+	else if (equalsIgnoreCase(extension, "ppm")) format = CaptureFormat::PPM;
+	else if (equalsIgnoreCase(extension, "raw") || equalsIgnoreCase(extension, "rgba")) format = CaptureFormat::RAW;
+	else return false;
+	return true;
+}
+
+const char* FrameRecorder::getFormatName(CaptureFormat format) {
+	switch (format) {
+	case CaptureFormat::PNG: return "PNG";
+	case CaptureFormat::EXR: return "EXR";
+	case CaptureFormat::PPM: return "PPM";
+	case CaptureFormat::RAW: return "raw RGBA8";
+	default: return "unknown";
+	}
+}
+
+std::string FrameRecorder::getFileName(uint64_t number) const {
+	char fileName[1024];
+	snprintf(fileName, sizeof(fileName), pattern.c_str(), int(number));
+	return fileName;
+}
+
+void FrameRecorder::workerLoop() {
+	std::vector<uint8_t> srgb;
+	while (true) {
+		Frame frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobAdded.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			// the queue is drained before stopping, no captured frame is lost
+			if (jobs.empty())
+				return;
+			frame = std::move(jobs.front());
+			jobs.pop_front();
+			++busy;
+		}
+
+		try {
+			write(frame, srgb);
+		}
+		catch (const std::exception& e) {
+			std::cerr << "Capture of frame " << frame.number << " failed: " << e.what() << std::endl;
+			if (format == CaptureFormat::RAW)
+				skipRawFrame(frame.number);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--busy;
+			++written;
+			freeBuffers.push_back(std::move(frame.pixels));
+		}
+		jobDone.notify_all();
+	}
+}
+
+void FrameRecorder::write(const Frame& frame, std::vector<uint8_t>& srgb) {
+	const size_t pixelCount = size_t(frame.width) * frame.height;
+	if (format == CaptureFormat::EXR) {
+		writeEXR(getFileName(frame.number), frame.pixels.data(), frame.width, frame.height);
+		return;
+	}
+
+	srgb.resize(pixelCount * 4);
+	linearToSRGB8(frame.pixels.data(), pixelCount, srgb.data());
+
+	if (format == CaptureFormat::PNG) {
+		writePNG(getFileName(frame.number), srgb.data(), frame.width, frame.height);
+	}
+	else if (format == CaptureFormat::PPM) {
+		writePPM(getFileName(frame.number), srgb.data(), frame.width, frame.height);
+	}
+	else {
+		// encoded in parallel, appended in order
+		std::unique_lock<std::mutex> lock(mutex);
+		jobDone.wait(lock, [this, &frame]() { return nextRawFrame == frame.number; });
+		rawFile.write(reinterpret_cast<const char*>(srgb.data()), srgb.size());
+		++nextRawFrame;
+		lock.unlock();
+		jobDone.notify_all();
+	}
+}
+
+void FrameRecorder::skipRawFrame(uint64_t number) {
+	// the frames after a failed one wait for their turn to append, it has to pass even without data
+	std::unique_lock<std::mutex> lock(mutex);
+	jobDone.wait(lock, [this, number]() { return nextRawFrame >= number; });
+	if (nextRawFrame == number)
+		++nextRawFrame;
+	lock.unlock();
+	jobDone.notify_all();
+}
@@ -0,0 +1,271 @@
+#include "ImageIO.h"
+
+#include <fstream>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <array>
+#include <cstring>
+
+void writePPM(const std::string& fileName, const uint8_t* rgba, uint32_t width, uint32_t height) {
+	std::ofstream file(fileName, std::ios::binary | std::ios::out);
+	if (!file.is_open())
+		throw std::runtime_error("Could not open file " + fileName + "!");
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+
+	std::vector<uint8_t> row(size_t(width) * 3);
+	for (uint32_t y = 0; y < height; ++y) {
+		const uint8_t* src = rgba + size_t(y) * width * 4;
+		for (uint32_t x = 0; x < width; ++x) {
+			row[x * 3 + 0] = src[x * 4 + 0];
+			row[x * 3 + 1] = src[x * 4 + 1];
+			row[x * 3 + 2] = src[x * 4 + 2];
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+	static const std::array<uint32_t, 256> table = []() {
+		std::array<uint32_t, 256> t{};
+		for (uint32_t n = 0; n < 256; ++n) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k)
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			t[n] = c;
+		}
+		return t;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+// PNG stores its integers big endian
+static void putBE32(std::vector<uint8_t>& out, uint32_t value) {
+	out.push_back(uint8_t(value >> 24));
+	out.push_back(uint8_t(value >> 16));
+	out.push_back(uint8_t(value >> 8));
+	out.push_back(uint8_t(value));
+}
+
+static void writeChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data) {
+	std::vector<uint8_t> chunk;
+	chunk.reserve(data.size() + 12);
+	putBE32(chunk, uint32_t(data.size()));
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	putBE32(chunk, crc32(chunk.data() + 4, data.size() + 4));
+	file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+void writePNG(const std::string& fileName, const uint8_t* rgba, uint32_t width, uint32_t height) {
+	std::ofstream file(fileName, std::ios::binary | std::ios::out);
+	if (!file.is_open())
+		throw std::runtime_error("Could not open file " + fileName + "!");
+
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	std::vector<uint8_t> header;
+	putBE32(header, width);
+	putBE32(header, height);
+	header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bit RGBA, deflate, no filter, no interlace
+	writeChunk(file, "IHDR", header);
+
+	// every row starts with filter type 0, the rows go into stored deflate blocks of at most 65535 bytes
+	const size_t rowSize = size_t(width) * 4 + 1;
+	const size_t rawSize = rowSize * height;
+	std::vector<uint8_t> data;
+	data.reserve(rawSize + rawSize / 65535 * 5 + 16);
+	data.push_back(0x78);
+	data.push_back(0x01);
+
+	uint32_t adlerA = 1, adlerB = 0;
+	size_t blockLeft = 0;
+	for (size_t i = 0; i < rawSize; ++i) {
+		if (blockLeft == 0) {
+			blockLeft = std::min<size_t>(rawSize - i, 65535);
+			data.push_back(i + blockLeft == rawSize ? 1 : 0);
+			data.push_back(uint8_t(blockLeft));
+			data.push_back(uint8_t(blockLeft >> 8));
+			data.push_back(uint8_t(~blockLeft));
+			data.push_back(uint8_t(~blockLeft >> 8));
+		}
+		const size_t row = i / rowSize, column = i % rowSize;
+		const uint8_t byte = column == 0 ? 0 : rgba[row * width * 4 + column - 1];
+		data.push_back(byte);
+		adlerA = (adlerA + byte) % 65521;
+		adlerB = (adlerB + adlerA) % 65521;
+		--blockLeft;
+	}
+	putBE32(data, (adlerB << 16) | adlerA);
+	writeChunk(file, "IDAT", data);
+	writeChunk(file, "IEND", {});
+
+	if (!file)
+		throw std::runtime_error("Could not write to " + fileName + "!");
+}
+
+// OpenEXR is little endian throughout, like every platform GRayV runs on
+template<typename T>
+static void putLE(std::vector<uint8_t>& out, T value) {
+	uint8_t bytes[sizeof(T)];
+	std::memcpy(bytes, &value, sizeof(T));
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static void putAttribute(std::vector<uint8_t>& out, const char* name, const char* type, const std::vector<uint8_t>& value) {
+	out.insert(out.end(), name, name + std::strlen(name) + 1);
+	out.insert(out.end(), type, type + std::strlen(type) + 1);
+	putLE(out, int32_t(value.size()));
+	out.insert(out.end(), value.begin(), value.end());
+}
+
+void writeEXR(const std::string& fileName, const float* rgba, uint32_t width, uint32_t height) {
+	std::ofstream file(fileName, std::ios::binary | std::ios::out);
+	if (!file.is_open())
+		throw std::runtime_error("Could not open file " + fileName + "!");
+
+	std::vector<uint8_t> header;
+	putLE(header, int32_t(20000630)); // magic
+	putLE(header, int32_t(2));        // version 2, single part scanline
+
+	// channels are stored in alphabetical order, the index is the component in rgba
+	const char* channelNames[4] = { "A", "B", "G", "R" };
+	const int channelComponents[4] = { 3, 2, 1, 0 };
+	std::vector<uint8_t> channels;
+	for (const char* name : channelNames) {
+		channels.insert(channels.end(), name, name + std::strlen(name) + 1);
+		putLE(channels, int32_t(2));  // FLOAT
+		putLE(channels, int32_t(0));  // pLinear and reserved
+		putLE(channels, int32_t(1));  // x sampling
+		putLE(channels, int32_t(1));  // y sampling
+	}
+	channels.push_back(0);
+
+	std::vector<uint8_t> window;
+	putLE(window, int32_t(0));
+	putLE(window, int32_t(0));
+	putLE(window, int32_t(width) - 1);
+	putLE(window, int32_t(height) - 1);
+	std::vector<uint8_t> one, center;
+	putLE(one, 1.0f);
+	putLE(center, 0.0f);
+	putLE(center, 0.0f);
+
+	putAttribute(header, "channels", "chlist", channels);
+	putAttribute(header, "compression", "compression", { 0 });
+	putAttribute(header, "dataWindow", "box2i", window);
+	putAttribute(header, "displayWindow", "box2i", window);
+	putAttribute(header, "lineOrder", "lineOrder", { 0 });
+	putAttribute(header, "pixelAspectRatio", "float", one);
+	putAttribute(header, "screenWindowCenter", "v2f", center);
+	putAttribute(header, "screenWindowWidth", "float", one);
+	header.push_back(0);
+
+	// offset table, every scanline is its y, its size and the channels one after another
+	const uint32_t lineSize = width * 4 * sizeof(float);
+	const uint64_t firstLine = header.size() + uint64_t(height) * sizeof(uint64_t);
+	for (uint32_t y = 0; y < height; ++y)
+		putLE(header, uint64_t(firstLine + uint64_t(y) * (lineSize + 8)));
+	file.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+	std::vector<uint8_t> line;
+	line.reserve(lineSize + 8);
+	for (uint32_t y = 0; y < height; ++y) {
+		line.clear();
+		putLE(line, int32_t(y));
+		putLE(line, int32_t(lineSize));
+		const float* src = rgba + size_t(y) * width * 4;
+		for (int component : channelComponents) {
+			for (uint32_t x = 0; x < width; ++x)
+				putLE(line, src[x * 4 + component]);
+		}
+		file.write(reinterpret_cast<const char*>(line.data()), line.size());
+	}
+
+	if (!file)
+		throw std::runtime_error("Could not write to " + fileName + "!");
+}
+
+PPMTileFile::PPMTileFile(const std::string& fileName, uint32_t width, uint32_t height, bool create) :
+	fileName(fileName), width(width), height(height)
+{
+	std::ostringstream header;
+	header << "P6\n" << width << " " << height << "\n255\n";
+	dataOffset = std::streamoff(header.str().size());
+	const std::streamoff fileSize = dataOffset + std::streamoff(width) * height * 3;
+
+	if (create) {
+		std::ofstream out(fileName, std::ios::binary | std::ios::out | std::ios::trunc);
+		if (!out.is_open())
+			throw std::runtime_error("Could not open file " + fileName + "!");
+		out << header.str();
+		// the last byte sizes the file, the pixels in between stay unwritten (sparse where supported)
+		out.seekp(fileSize - 1);
+		out.put(0);
+		if (!out)
+			throw std::runtime_error("Could not allocate " + std::to_string(fileSize) + " bytes for " + fileName + "!");
+	}
+
+	file.open(fileName, std::ios::binary | std::ios::in | std::ios::out);
+	if (!file.is_open())
+		throw std::runtime_error("Could not open file " + fileName + "!");
+
+	if (!create) {
+		std::string existing(header.str().size(), '\0');
+		file.read(existing.data(), std::streamsize(existing.size()));
+		file.seekg(0, std::ios::end);
+		if (!file || existing != header.str() || file.tellg() != fileSize)
+			throw std::runtime_error(fileName + " is not a " + std::to_string(width) + "x" + std::to_string(height) + " PPM!");
+	}
+}
+
+PPMTileFile::~PPMTileFile() {
+
+}
+
+void PPMTileFile::write(uint32_t x, uint32_t y, uint32_t w, uint32_t h, const uint8_t* rgba, uint32_t pitch) {
+	if (x + w > width || y + h > height)
+		throw std::runtime_error("Tile outside of " + fileName + "!");
+
+	std::vector<uint8_t> row(size_t(w) * 3);
+	for (uint32_t j = 0; j < h; ++j) {
+		const uint8_t* src = rgba + size_t(j) * pitch * 4;
+		for (uint32_t i = 0; i < w; ++i) {
+			row[i * 3 + 0] = src[i * 4 + 0];
+			row[i * 3 + 1] = src[i * 4 + 1];
+			row[i * 3 + 2] = src[i * 4 + 2];
+		}
+		file.seekp(dataOffset + (std::streamoff(y + j) * width + x) * 3);
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+	if (!file)
+		throw std::runtime_error("Could not write to " + fileName + "!");
+}
+
+void PPMTileFile::flush() {
+	file.flush();
+}
+
+void linearToSRGB8(const float* rgba, size_t pixelCount, uint8_t* out) {
+	auto encode = [](float c) {
+		c = std::clamp(std::isnan(c) ? 0.0f : c, 0.0f, 1.0f);
+		c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+		return static_cast<uint8_t>(c * 255.0f + 0.5f);
+	};
+
+	for (size_t i = 0; i < pixelCount; ++i) {
+		out[i * 4 + 0] = encode(rgba[i * 4 + 0]);
+		out[i * 4 + 1] = encode(rgba[i * 4 + 1]);
+		out[i * 4 + 2] = encode(rgba[i * 4 + 2]);
+		// alpha is stored linearly
+		out[i * 4 + 3] = static_cast<uint8_t>(std::clamp(rgba[i * 4 + 3], 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+}
@@ -0,0 +1,285 @@
+#include "MagicaVoxel.h"
+#include "MappedFile.h"
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+
+namespace {
+
+// bounds checked little endian reads
+struct VoxReader {
+	const uint8_t* pos;
+	const uint8_t* end;
+
+	void need(size_t size) const {
+		if (size_t(end - pos) < size)
+			throw std::runtime_error("MagicaVoxel file is truncated!");
+	}
+	int32_t readInt() {
+		need(4);
+		int32_t value;
+		memcpy(&value, pos, 4);
+		pos += 4;
+		return value;
+	}
+	std::string readString() {
+		const int32_t size = readInt();
+		if (size < 0)
+			throw std::runtime_error("MagicaVoxel file is corrupt!");
+		need(size_t(size));
+		std::string value(reinterpret_cast<const char*>(pos), size_t(size));
+		pos += size;
+		return value;
+	}
+	std::map<std::string, std::string> readDict() {
+		std::map<std::string, std::string> dict;
+		const int32_t count = readInt();
+		for (int32_t i = 0; i < count; ++i) {
+			std::string key = readString();
+			dict[key] = readString();
+		}
+		return dict;
+	}
+};
+
+// rotations in .vox files only ever permute and flip axes: out[r] = sign[r] * in[axis[r]]
+struct VoxTransform {
+	int axis[3] = { 0, 1, 2 };
+	int sign[3] = { 1, 1, 1 };
+	glm::ivec3 translation{ 0 };
+
+	glm::ivec3 apply(glm::ivec3 v) const {
+		return glm::ivec3(sign[0] * v[axis[0]], sign[1] * v[axis[1]], sign[2] * v[axis[2]]) + translation;
+	}
+	// this after child
+	VoxTransform then(const VoxTransform& child) const {
+		VoxTransform result;
+		for (int r = 0; r < 3; ++r) {
+			result.axis[r] = child.axis[axis[r]];
+			result.sign[r] = sign[r] * child.sign[axis[r]];
+		}
+		result.translation = apply(child.translation);
+		return result;
+	}
+};
+
+struct VoxModel {
+	glm::ivec3 size;
+	const uint8_t* voxels;      // x, y, z, palette index
+	int32_t count;
+};
+
+struct VoxNode {
+	enum Type { TRANSFORM, GROUP, SHAPE } type = SHAPE;
+	VoxTransform transform;
+	int32_t layer = -1;
+	std::vector<int32_t> children;  // the child of a transform, the children of a group or the models of a shape
+};
+
+struct VoxInstance {
+	int32_t model;
+	VoxTransform transform;     // model voxel to MagicaVoxel world coordinates
+};
+
+VoxTransform parseTransform(const std::map<std::string, std::string>& frame) {
+	VoxTransform transform;
+	auto rotation = frame.find("_r");
+	if (rotation != frame.end()) {
+		// bits 0-1 and 2-3: the column of the first and second row's entry, bits 4-6: the signs of the rows
+		const int bits = std::stoi(rotation->second);
+		transform.axis[0] = bits & 3;
+		transform.axis[1] = (bits >> 2) & 3;
+		transform.axis[2] = 3 - transform.axis[0] - transform.axis[1];
+		if (transform.axis[0] > 2 || transform.axis[1] > 2 || transform.axis[0] == transform.axis[1])
+			throw std::runtime_error("MagicaVoxel file has an invalid rotation!");
+		for (int r = 0; r < 3; ++r)
+			transform.sign[r] = (bits >> (4 + r)) & 1 ? -1 : 1;
+	}
+	auto translation = frame.find("_t");
+	if (translation != frame.end())
+		std::sscanf(translation->second.c_str(), "%d %d %d", &transform.translation.x, &transform.translation.y, &transform.translation.z);
+	return transform;
+}
+
+void collectInstances(const std::map<int32_t, VoxNode>& nodes, const std::vector<bool>& hiddenLayers, int32_t id, const VoxTransform& parent,
+	int depth, std::vector<VoxInstance>& instances)
+{
+	auto it = nodes.find(id);
+	if (it == nodes.end() || depth > 64)
+		throw std::runtime_error("MagicaVoxel file has a broken scene graph!");
+
+	const VoxNode& node = it->second;
+	if (node.type == VoxNode::TRANSFORM) {
+		if (node.layer >= 0 && size_t(node.layer) < hiddenLayers.size() && hiddenLayers[node.layer])
+			return;
+		for (int32_t child : node.children)
+			collectInstances(nodes, hiddenLayers, child, parent.then(node.transform), depth + 1, instances);
+	}
+	else if (node.type == VoxNode::GROUP) {
+		for (int32_t child : node.children)
+			collectInstances(nodes, hiddenLayers, child, parent, depth + 1, instances);
+	}
+	else {
+		for (int32_t model : node.children)
+			instances.push_back(VoxInstance{ model, parent });
+	}
+}
+
+}
+
+VoxelWorld importMagicaVoxel(const std::string& fileName) {
+	const MappedFile file(fileName);
+	VoxReader reader{ file.data(), file.data() + file.size() };
+	reader.need(8);
+	if (memcmp(reader.pos, "VOX ", 4) != 0)
+		throw std::runtime_error(fileName + " is not a MagicaVoxel file!");
+	reader.pos += 8; // magic and version
+
+	std::vector<VoxModel> models;
+	std::map<int32_t, VoxNode> nodes;
+	std::vector<bool> hiddenLayers;
+	VoxelMaterial materials[256];
+	std::fill(std::begin(materials), std::end(materials), VOXEL_SOLID);
+	materials[0] = VOXEL_EMPTY;
+	glm::ivec3 size(0);
+
+	// MAIN holds all other chunks as its children, they are read as if they followed it
+	while (reader.pos < reader.end) {
+		reader.need(12);
+		char id[5] = {};
+		memcpy(id, reader.pos, 4);
+		reader.pos += 4;
+		const int32_t contentSize = reader.readInt();
+		reader.readInt(); // size of the children
+		if (contentSize < 0)
+			throw std::runtime_error(fileName + " is corrupt!");
+		reader.need(size_t(contentSize));
+		VoxReader content{ reader.pos, reader.pos + contentSize };
+		reader.pos += contentSize;
+		const std::string chunk = id;
+
+		if (chunk == "SIZE") {
+			// one read per statement, the order of function arguments is unspecified
+			size.x = content.readInt();
+			size.y = content.readInt();
+			size.z = content.readInt();
+		}
+		else if (chunk == "XYZI") {
+			const int32_t count = content.readInt();
+			if (count < 0)
+				throw std::runtime_error(fileName + " is corrupt!");
+			content.need(size_t(count) * 4);
+			models.push_back(VoxModel{ size, content.pos, count });
+		}
+		else if (chunk == "MATL") {
+			const int32_t material = content.readInt();
+			const std::map<std::string, std::string> properties = content.readDict();
+			auto type = properties.find("_type");
+			if (material > 0 && material < 256 && type != properties.end() && (type->second == "_glass" || type->second == "_blend" || type->second == "_media"))
+				materials[material] = VOXEL_WATER;
+		}
+		else if (chunk == "nTRN") {
+			const int32_t nodeId = content.readInt();
+			VoxNode node;
+			node.type = VoxNode::TRANSFORM;
+			content.readDict();
+			node.children.push_back(content.readInt());
+			content.readInt(); // reserved
+			node.layer = content.readInt();
+			const int32_t frames = content.readInt();
+			// only the first frame of animations
+			for (int32_t f = 0; f < frames; ++f) {
+				const std::map<std::string, std::string> frame = content.readDict();
+				if (f == 0)
+					node.transform = parseTransform(frame);
+			}
+			nodes[nodeId] = node;
+		}
+		else if (chunk == "nGRP" || chunk == "nSHP") {
+			const int32_t nodeId = content.readInt();
+			VoxNode node;
+			node.type = chunk == "nGRP" ? VoxNode::GROUP : VoxNode::SHAPE;
+			content.readDict();
+			const int32_t count = content.readInt();
+			for (int32_t i = 0; i < count; ++i) {
+				node.children.push_back(content.readInt());
+				if (node.type == VoxNode::SHAPE)
+					content.readDict();
+			}
+			nodes[nodeId] = node;
+		}
+		else if (chunk == "LAYR") {
+			const int32_t layer = content.readInt();
+			const std::map<std::string, std::string> properties = content.readDict();
+			auto hidden = properties.find("_hidden");
+			if (layer >= 0 && layer < 4096 && hidden != properties.end() && hidden->second == "1") {
+				hiddenLayers.resize(std::max(hiddenLayers.size(), size_t(layer) + 1), false);
+				hiddenLayers[layer] = true;
+			}
+		}
+		// MAIN, PACK, RGBA and the rest carry nothing we use
+	}
+	if (models.empty())
+		throw std::runtime_error(fileName + " has no models!");
+
+	// files without a scene graph (before version 200) stack all models at the origin
+	std::vector<VoxInstance> instances;
+	if (nodes.empty()) {
+		for (size_t i = 0; i < models.size(); ++i)
+			instances.push_back(VoxInstance{ int32_t(i), VoxTransform{} });
+	}
+	else {
+		collectInstances(nodes, hiddenLayers, nodes.begin()->first, VoxTransform{}, 0, instances);
+	}
+
+	// MagicaVoxel is z up: (x, y, z) becomes (x, z, -y)
+	auto toWorld = [](glm::ivec3 v) { return glm::ivec3(v.x, v.z, -v.y); };
+	// models rotate around their center
+	auto place = [&](const VoxInstance& instance, glm::ivec3 v) {
+		return toWorld(instance.transform.apply(v - models[instance.model].size / 2));
+	};
+
+	glm::ivec3 minimum(std::numeric_limits<int>::max()), maximum(std::numeric_limits<int>::min());
+	for (const VoxInstance& instance : instances) {
+		if (instance.model < 0 || size_t(instance.model) >= models.size())
+			throw std::runtime_error(fileName + " refers to a model it does not have!");
+		const VoxModel& model = models[instance.model];
+		if (model.count == 0)
+			continue;
+		// axis permutations map the box corners onto box corners
+		const glm::ivec3 a = place(instance, glm::ivec3(0)), b = place(instance, model.size - 1);
+		minimum = glm::min(minimum, glm::min(a, b));
+		maximum = glm::max(maximum, glm::max(a, b));
+	}
+	if (minimum.x > maximum.x)
+		throw std::runtime_error(fileName + " has no voxels!");
+
+	// centered on the view axis of the default camera (looking along +x from the origin), 16 voxels in front of it
+	const glm::ivec3 extent = maximum - minimum + 1;
+	const glm::ivec3 offset = glm::ivec3(16, -extent.y / 2, -extent.z / 2) - minimum;
+	VoxelWorld world(minimum + offset, (extent + BRICK_SIZE - 1) / BRICK_SIZE, VOXEL_EMPTY);
+
+	size_t voxelCount = 0;
+	for (const VoxInstance& instance : instances) {
+		const VoxModel& model = models[instance.model];
+		for (int32_t i = 0; i < model.count; ++i) {
+			const uint8_t* voxel = model.voxels + size_t(i) * 4;
+			const glm::ivec3 v(voxel[0], voxel[1], voxel[2]);
+			if (v.x >= model.size.x || v.y >= model.size.y || v.z >= model.size.z || materials[voxel[3]] == VOXEL_EMPTY)
+				continue;
+			world.set(place(instance, v) + offset, materials[voxel[3]]);
+			++voxelCount;
+		}
+	}
+	world.compact();
+
+	std::cout << "Imported " << fileName << ": " << instances.size() << " model instances, " << voxelCount << " voxels, "
+		<< extent.x << "x" << extent.y << "x" << extent.z << std::endl;
+	return world;
+}
@@ -0,0 +1,98 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& fileName) {
+	file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		throw std::runtime_error("Could not open file " + fileName + "!");
+	}
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	length = size_t(fileSize.QuadPart);
+	if (length == 0)
+		return; // empty files cannot be mapped, there is nothing to read anyway
+
+	mappingObject = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingObject != nullptr)
+		mapping = static_cast<const uint8_t*>(MapViewOfFile(mappingObject, FILE_MAP_READ, 0, 0, 0));
+	if (mapping == nullptr) {
+		if (mappingObject != nullptr)
+			CloseHandle(mappingObject);
+		CloseHandle(file);
+		throw std::runtime_error("Could not map file " + fileName + "!");
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (mapping != nullptr)
+		UnmapViewOfFile(mapping);
+	if (mappingObject != nullptr)
+		CloseHandle(mappingObject);
+	if (file != nullptr)
+		CloseHandle(file);
+}
+
+void MappedFile::prefetch(size_t offset, size_t size) const {
+	if (mapping == nullptr || offset >= length)
+		return;
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast<uint8_t*>(mapping) + offset;
+	range.NumberOfBytes = std::min(size, length - offset);
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+#else
+MappedFile::MappedFile(const std::string& fileName) {
+	const int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("Could not open file " + fileName + "!");
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		throw std::runtime_error("Could not read the size of " + fileName + "!");
+	}
+	length = size_t(info.st_size);
+	if (length == 0) {
+		close(fd);
+		return; // empty files cannot be mapped, there is nothing to read anyway
+	}
+
+	// the mapping keeps the file referenced on its own
+	void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED)
+		throw std::runtime_error("Could not map file " + fileName + "!");
+	mapping = static_cast<const uint8_t*>(address);
+}
+
+MappedFile::~MappedFile() {
+	if (mapping != nullptr)
+		munmap(const_cast<uint8_t*>(mapping), length);
+}
+
+void MappedFile::prefetch(size_t offset, size_t size) const {
+	if (mapping == nullptr || offset >= length)
+		return;
+	// madvise wants a page aligned start
+	const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+	const size_t begin = offset / pageSize * pageSize;
+	const size_t end = offset + std::min(size, length - offset);
+	madvise(const_cast<uint8_t*>(mapping) + begin, end - begin, MADV_WILLNEED);
+}
+#endif
@@ -0,0 +1,143 @@
+// Shared DDA kernel of the packet tracer. Included by one translation unit per
+// instruction set inside an anonymous namespace, after the SIMD wrapper `S` is
+// defined, so every copy is compiled with its own target flags.
+//
+// S provides: WIDTH, F (float vector), I (int vector), M (lane mask) and
+// the operations used below.
+
+// VoxelWorld::get() for every lane: brick table lookup, then the voxel byte for non-uniform bricks.
+// cellMask is ~(VoxelWorld::getEmptyCellSize() - 1) for empty voxels and ~0 otherwise.
+template<typename S>
+void classifyVoxels(const VoxelGridView& grid, typename S::I vx, typename S::I vy, typename S::I vz, typename S::M& solid, typename S::M& water, typename S::I& cellMask) {
+	using I = typename S::I;
+	using M = typename S::M;
+	const I zero = S::set1i(0);
+	const I seven = S::set1i(BRICK_SIZE - 1);
+
+	const I px = S::subi(vx, S::set1i(grid.originX));
+	const I py = S::subi(vy, S::set1i(grid.originY));
+	const I pz = S::subi(vz, S::set1i(grid.originZ));
+	const I bx = S::template srai<3>(px);
+	const I by = S::template srai<3>(py);
+	const I bz = S::template srai<3>(pz);
+
+	const M outside = S::maskOr(S::maskOr(S::lessi(px, zero), S::lessi(py, zero)), S::maskOr(S::lessi(pz, zero),
+		S::maskOr(S::maskOr(S::maskAndNot(S::lessi(bx, S::set1i(grid.dimsX)), S::maskAll()), S::maskAndNot(S::lessi(by, S::set1i(grid.dimsY)), S::maskAll())),
+			S::maskAndNot(S::lessi(bz, S::set1i(grid.dimsZ)), S::maskAll()))));
+	const M inside = S::maskAndNot(outside, S::maskAll());
+
+	const I tableIndex = S::addi(S::mullo(S::addi(S::mullo(bz, S::set1i(grid.dimsY)), by), S::set1i(grid.dimsX)), bx);
+	const I entry = S::gather32(grid.brickTable, tableIndex, inside);
+
+	// BRICK_UNIFORM is the sign bit
+	const M uniform = S::lessi(entry, zero);
+	const I local = S::addi(S::addi(S::template slli<6>(S::andi(pz, seven)), S::template slli<3>(S::andi(py, seven))), S::andi(px, seven));
+	const I voxel = S::gatherBytes(grid.brickPool, S::addi(S::template slli<9>(entry), local), S::maskAndNot(uniform, inside));
+
+	const I material = S::selecti(inside, S::selecti(uniform, S::andi(entry, S::set1i(0xff)), voxel), S::set1i(grid.outsideMaterial));
+	water = S::equali(material, S::set1i(VOXEL_WATER));
+	solid = S::equali(material, S::set1i(VOXEL_SOLID));
+
+	const M empty = S::maskAnd(inside, S::equali(material, S::set1i(VOXEL_EMPTY)));
+	const I coarseIndex = S::addi(S::mullo(S::addi(S::mullo(S::template srai<2>(bz), S::set1i(grid.coarseDimsY)), S::template srai<2>(by)), S::set1i(grid.coarseDimsX)), S::template srai<2>(bx));
+	const M coarseEmpty = S::maskAndNot(S::equali(S::gather32(grid.coarseTable, coarseIndex, empty), zero), empty);
+	const M brickEmpty = S::maskAnd(empty, S::equali(entry, S::set1i(int32_t(BRICK_UNIFORM | VOXEL_EMPTY))));
+	cellMask = S::selecti(coarseEmpty, S::set1i(~(COARSE_SIZE - 1)), S::selecti(brickEmpty, S::set1i(~(BRICK_SIZE - 1)), S::set1i(~0)));
+}
+
+template<typename S>
+uint32_t marchPacketImpl(RayPacket& p, const VoxelGridView& grid, int maxSteps) {
+	using F = typename S::F;
+	using I = typename S::I;
+	using M = typename S::M;
+
+	F sx = S::load(p.sideDistX), sy = S::load(p.sideDistY), sz = S::load(p.sideDistZ);
+	const F dx = S::load(p.deltaDistX), dy = S::load(p.deltaDistY), dz = S::load(p.deltaDistZ);
+	I vx = S::loadi(p.voxelX), vy = S::loadi(p.voxelY), vz = S::loadi(p.voxelZ);
+	const I stx = S::loadi(p.stepX), sty = S::loadi(p.stepY), stz = S::loadi(p.stepZ);
+	I axis = S::loadi(p.axis);
+	I steps = S::loadi(p.steps);
+	const M lastWater = S::maskFromInt(S::loadi(p.lastWater));
+
+	const I maxI = S::set1i(maxSteps);
+	const I zero = S::set1i(0);
+	const I one = S::set1i(1);
+	const I ox = S::set1i(grid.originX), oy = S::set1i(grid.originY), oz = S::set1i(grid.originZ);
+
+	M active = S::maskAnd(S::maskFromBits(p.active), S::lessi(steps, maxI));
+	uint32_t events = 0;
+
+	while (S::bits(active)) {
+		M solid, water;
+		I cellMask;
+		classifyVoxels<S>(grid, vx, vy, vz, solid, water, cellMask);
+
+		// solid voxel or entering / leaving water: direction changes, leave to the scalar path
+		const M event = S::maskAnd(active, S::maskOr(S::maskAndNot(water, solid), S::maskXor(water, lastWater)));
+		events = S::bits(event);
+		const M move = S::maskAndNot(event, active);
+
+		// lanes leave their voxel, or the whole empty cell around it in a single step, like stepPath in
+		// trace.glsl: each axis counts the voxel planes to the far side of the cell, the nearest exit is
+		// taken and the other axes advance by the planes they cross before it
+		const I cellSize = S::subi(zero, cellMask);
+		M selX, selY, selZ;
+		if (!S::bits(S::maskAnd(move, S::lessi(one, cellSize)))) {
+			// only single voxel cells: the general case reduces to one plain DDA step
+			const M xy = S::less(sx, sy);
+			selX = S::maskAnd(move, S::maskAnd(xy, S::less(sx, sz)));
+			selY = S::maskAnd(move, S::maskAndNot(xy, S::less(sy, sz)));
+			selZ = S::maskAndNot(S::maskOr(selX, selY), move);
+			sx = S::select(selX, S::add(sx, dx), sx);
+			sy = S::select(selY, S::add(sy, dy), sy);
+			sz = S::select(selZ, S::add(sz, dz), sz);
+			vx = S::selecti(selX, S::addi(vx, stx), vx);
+			vy = S::selecti(selY, S::addi(vy, sty), vy);
+			vz = S::selecti(selZ, S::addi(vz, stz), vz);
+		}
+		else {
+			const auto exitPlanes = [&](I v, I o, I st) {
+				const I low = S::addi(o, S::andi(S::subi(v, o), cellMask));
+				return S::selecti(S::lessi(zero, st), S::subi(S::addi(low, cellSize), v), S::addi(S::subi(v, low), one));
+			};
+			// axes without direction have infinite distances, multiplying them by 0 would give NaN
+			const auto exitDistance = [&](F side, F delta, I exits) {
+				return S::select(S::lessi(one, exits), S::add(side, S::mul(S::toFloat(S::subi(exits, one)), delta)), side);
+			};
+			const I exitsX = exitPlanes(vx, ox, stx), exitsY = exitPlanes(vy, oy, sty), exitsZ = exitPlanes(vz, oz, stz);
+			const F ex = exitDistance(sx, dx, exitsX), ey = exitDistance(sy, dy, exitsY), ez = exitDistance(sz, dz, exitsZ);
+
+			const M xy = S::less(ex, ey);
+			selX = S::maskAnd(move, S::maskAnd(xy, S::less(ex, ez)));
+			selY = S::maskAnd(move, S::maskAndNot(xy, S::less(ey, ez)));
+			selZ = S::maskAndNot(S::maskOr(selX, selY), move);
+			const F t = S::select(selX, ex, S::select(selY, ey, ez));
+
+			const auto advance = [&](F& side, F delta, I& v, I st, I exits, M selected) {
+				const I crossings = S::toInt(S::min(S::ceil(S::div(S::sub(t, side), delta)), S::toFloat(S::subi(exits, one))));
+				const I count = S::selecti(selected, exits, S::selecti(S::maskAnd(S::lessi(one, exits), S::less(side, t)), crossings, zero));
+				side = S::select(S::maskAnd(move, S::lessi(zero, count)), S::add(side, S::mul(S::toFloat(count), delta)), side);
+				v = S::selecti(move, S::addi(v, S::mullo(st, count)), v);
+			};
+			advance(sx, dx, vx, stx, exitsX, selX);
+			advance(sy, dy, vy, sty, exitsY, selY);
+			advance(sz, dz, vz, stz, exitsZ, selZ);
+		}
+		axis = S::selecti(selX, S::set1i(0), S::selecti(selY, one, S::selecti(selZ, S::set1i(2), axis)));
+		steps = S::selecti(move, S::addi(steps, one), steps);
+
+		// out of steps: drop out of the packet
+		active = S::maskAnd(active, S::lessi(steps, maxI));
+
+		if (events)
+			break;
+	}
+
+	S::store(p.sideDistX, sx); S::store(p.sideDistY, sy); S::store(p.sideDistZ, sz);
+	S::storei(p.voxelX, vx); S::storei(p.voxelY, vy); S::storei(p.voxelZ, vz);
+	S::storei(p.axis, axis);
+	S::storei(p.steps, steps);
+	p.active = S::bits(active);
+
+	return events & p.active;
+}
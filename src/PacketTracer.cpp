@@ -0,0 +1,63 @@
+#include "PacketTracer.h"
+
+#if defined(GRAYV_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+SimdIsa detectSimdIsa() {
+#ifdef GRAYV_SIMD_X86
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	const bool sse41 = (info[2] & (1 << 19)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+
+	// the OS has to save the upper register halves on context switches
+	const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+	const bool ymmState = (xcr0 & 0x6) == 0x6;
+	const bool zmmState = (xcr0 & 0xe6) == 0xe6;
+
+	bool avx2 = false, avx512 = false;
+	if (maxLeaf >= 7) {
+		__cpuidex(info, 7, 0);
+		avx2 = avx && ymmState && (info[1] & (1 << 5)) != 0;
+		avx512 = zmmState && (info[1] & (1 << 16)) != 0;
+	}
+
+	if (avx512) return SimdIsa::AVX512;
+	if (avx2) return SimdIsa::AVX2;
+	if (sse41) return SimdIsa::SSE41;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) return SimdIsa::AVX512;
+	if (__builtin_cpu_supports("avx2")) return SimdIsa::AVX2;
+	if (__builtin_cpu_supports("sse4.1")) return SimdIsa::SSE41;
+#endif
+#endif
+	return SimdIsa::SCALAR;
+}
+
+const char* getSimdIsaName(SimdIsa isa) {
+	switch (isa) {
+	case SimdIsa::SSE41: return "SSE4.1";
+	case SimdIsa::AVX2: return "AVX2";
+	case SimdIsa::AVX512: return "AVX-512";
+	default: return "Scalar";
+	}
+}
+
+MarchPacketFunc getMarchPacketFunc(SimdIsa isa) {
+#ifdef GRAYV_SIMD_X86
+	switch (isa) {
+	case SimdIsa::SSE41: return marchPacketSSE41;
+	case SimdIsa::AVX2: return marchPacketAVX2;
+	case SimdIsa::AVX512: return marchPacketAVX512;
+	default: break;
+	}
+#endif
+	return nullptr;
+}
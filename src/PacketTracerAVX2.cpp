@@ -0,0 +1,78 @@
+#include "PacketTracer.h"
+
+#ifdef GRAYV_SIMD_X86
+#include <immintrin.h>
+
+// compiled with AVX2 enabled, see CMakeLists.txt
+namespace {
+
+struct Avx2 {
+	static constexpr int WIDTH = 8;
+	using F = __m256;
+	using I = __m256i;
+	using M = __m256;
+
+	static F load(const float* p) { return _mm256_load_ps(p); }
+	static I loadi(const int32_t* p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+	static void store(float* p, F v) { _mm256_store_ps(p, v); }
+	static void storei(int32_t* p, I v) { _mm256_store_si256(reinterpret_cast<__m256i*>(p), v); }
+	static F set1(float v) { return _mm256_set1_ps(v); }
+	static I set1i(int32_t v) { return _mm256_set1_epi32(v); }
+
+	static F add(F a, F b) { return _mm256_add_ps(a, b); }
+	static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+	static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+	static F div(F a, F b) { return _mm256_div_ps(a, b); }
+	static F ceil(F a) { return _mm256_ceil_ps(a); }
+	static F sqrt(F a) { return _mm256_sqrt_ps(a); }
+	static F min(F a, F b) { return _mm256_min_ps(a, b); }
+	static F max(F a, F b) { return _mm256_max_ps(a, b); }
+	static F neg(F a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+	static F abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+	static F toFloat(I a) { return _mm256_cvtepi32_ps(a); }
+	static I toInt(F a) { return _mm256_cvttps_epi32(a); }
+	static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+	static I subi(I a, I b) { return _mm256_sub_epi32(a, b); }
+	static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+	static I mullo(I a, I b) { return _mm256_mullo_epi32(a, b); }
+	template<int N> static I slli(I a) { return _mm256_slli_epi32(a, N); }
+	template<int N> static I srai(I a) { return _mm256_srai_epi32(a, N); }
+
+	static I gather32(const uint32_t* base, I index, M mask) {
+		return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(base), index, _mm256_castps_si256(mask), 4);
+	}
+	// gathers the containing 32 bit words and shifts the byte down
+	static I gatherBytes(const uint8_t* base, I offset, M mask) {
+		const __m256i words = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int*>(base), _mm256_srli_epi32(offset, 2), _mm256_castps_si256(mask), 4);
+		const __m256i shift = _mm256_slli_epi32(_mm256_and_si256(offset, _mm256_set1_epi32(3)), 3);
+		return _mm256_and_si256(_mm256_srlv_epi32(words, shift), _mm256_set1_epi32(0xff));
+	}
+
+	static M less(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static M lessi(I a, I b) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a)); }
+	static M equali(I a, I b) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)); }
+	static M maskAll() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+	static M maskAnd(M a, M b) { return _mm256_and_ps(a, b); }
+	static M maskOr(M a, M b) { return _mm256_or_ps(a, b); }
+	static M maskXor(M a, M b) { return _mm256_xor_ps(a, b); }
+	static M maskAndNot(M a, M b) { return _mm256_andnot_ps(a, b); } // ~a & b
+	static M maskFromInt(I a) { return _mm256_castsi256_ps(a); }
+	static M maskFromBits(uint32_t bits) {
+		const __m256i lane = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+		return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(int32_t(bits)), lane), lane));
+	}
+	static uint32_t bits(M m) { return uint32_t(_mm256_movemask_ps(m)); }
+
+	static F select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+	static I selecti(M m, I a, I b) { return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b), _mm256_castsi256_ps(a), m)); }
+};
+
+#include "PacketKernel.inl"
+
+}
+
+uint32_t marchPacketAVX2(RayPacket& packet, const VoxelGridView& grid, int maxSteps) {
+	return marchPacketImpl<Avx2>(packet, grid, maxSteps);
+}
+
+#endif
@@ -0,0 +1,75 @@
+#include "PacketTracer.h"
+
+#ifdef GRAYV_SIMD_X86
+#include <immintrin.h>
+
+// compiled with AVX-512F enabled, see CMakeLists.txt
+namespace {
+
+struct Avx512 {
+	static constexpr int WIDTH = 16;
+	using F = __m512;
+	using I = __m512i;
+	using M = __mmask16;
+
+	static F load(const float* p) { return _mm512_load_ps(p); }
+	static I loadi(const int32_t* p) { return _mm512_load_si512(p); }
+	static void store(float* p, F v) { _mm512_store_ps(p, v); }
+	static void storei(int32_t* p, I v) { _mm512_store_si512(p, v); }
+	static F set1(float v) { return _mm512_set1_ps(v); }
+	static I set1i(int32_t v) { return _mm512_set1_epi32(v); }
+
+	static F add(F a, F b) { return _mm512_add_ps(a, b); }
+	static F sub(F a, F b) { return _mm512_sub_ps(a, b); }
+	static F mul(F a, F b) { return _mm512_mul_ps(a, b); }
+	static F div(F a, F b) { return _mm512_div_ps(a, b); }
+	static F ceil(F a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC); }
+	static F sqrt(F a) { return _mm512_sqrt_ps(a); }
+	static F min(F a, F b) { return _mm512_min_ps(a, b); }
+	static F max(F a, F b) { return _mm512_max_ps(a, b); }
+	static F neg(F a) { return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_set1_epi32(int32_t(0x80000000u)))); }
+	static F abs(F a) { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff))); }
+	static F toFloat(I a) { return _mm512_cvtepi32_ps(a); }
+	static I toInt(F a) { return _mm512_cvttps_epi32(a); }
+	static I addi(I a, I b) { return _mm512_add_epi32(a, b); }
+	static I subi(I a, I b) { return _mm512_sub_epi32(a, b); }
+	static I andi(I a, I b) { return _mm512_and_si512(a, b); }
+	static I mullo(I a, I b) { return _mm512_mullo_epi32(a, b); }
+	template<int N> static I slli(I a) { return _mm512_slli_epi32(a, N); }
+	template<int N> static I srai(I a) { return _mm512_srai_epi32(a, N); }
+
+	static I gather32(const uint32_t* base, I index, M mask) {
+		return _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), mask, index, base, 4);
+	}
+	// gathers the containing 32 bit words and shifts the byte down
+	static I gatherBytes(const uint8_t* base, I offset, M mask) {
+		const __m512i words = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), mask, _mm512_srli_epi32(offset, 2), base, 4);
+		const __m512i shift = _mm512_slli_epi32(_mm512_and_si512(offset, _mm512_set1_epi32(3)), 3);
+		return _mm512_and_si512(_mm512_srlv_epi32(words, shift), _mm512_set1_epi32(0xff));
+	}
+
+	static M less(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+	static M lessi(I a, I b) { return _mm512_cmplt_epi32_mask(a, b); }
+	static M equali(I a, I b) { return _mm512_cmpeq_epi32_mask(a, b); }
+	static M maskAll() { return M(0xffff); }
+	static M maskAnd(M a, M b) { return M(a & b); }
+	static M maskOr(M a, M b) { return M(a | b); }
+	static M maskXor(M a, M b) { return M(a ^ b); }
+	static M maskAndNot(M a, M b) { return M(~a & b); }
+	static M maskFromInt(I a) { return _mm512_test_epi32_mask(a, a); }
+	static M maskFromBits(uint32_t bits) { return M(bits); }
+	static uint32_t bits(M m) { return uint32_t(m); }
+
+	static F select(M m, F a, F b) { return _mm512_mask_blend_ps(m, b, a); }
+	static I selecti(M m, I a, I b) { return _mm512_mask_blend_epi32(m, b, a); }
+};
+
+#include "PacketKernel.inl"
+
+}
+
+uint32_t marchPacketAVX512(RayPacket& packet, const VoxelGridView& grid, int maxSteps) {
+	return marchPacketImpl<Avx512>(packet, grid, maxSteps);
+}
+
+#endif
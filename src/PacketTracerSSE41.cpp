@@ -0,0 +1,88 @@
+#include "PacketTracer.h"
+
+#ifdef GRAYV_SIMD_X86
+#include <smmintrin.h>
+
+// compiled with SSE4.1 enabled, see CMakeLists.txt
+namespace {
+
+struct Sse41 {
+	static constexpr int WIDTH = 4;
+	using F = __m128;
+	using I = __m128i;
+	using M = __m128;
+
+	static F load(const float* p) { return _mm_load_ps(p); }
+	static I loadi(const int32_t* p) { return _mm_load_si128(reinterpret_cast<const __m128i*>(p)); }
+	static void store(float* p, F v) { _mm_store_ps(p, v); }
+	static void storei(int32_t* p, I v) { _mm_store_si128(reinterpret_cast<__m128i*>(p), v); }
+	static F set1(float v) { return _mm_set1_ps(v); }
+	static I set1i(int32_t v) { return _mm_set1_epi32(v); }
+
+	static F add(F a, F b) { return _mm_add_ps(a, b); }
+	static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+	static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+	static F div(F a, F b) { return _mm_div_ps(a, b); }
+	static F ceil(F a) { return _mm_ceil_ps(a); }
+	static F sqrt(F a) { return _mm_sqrt_ps(a); }
+	static F min(F a, F b) { return _mm_min_ps(a, b); }
+	static F max(F a, F b) { return _mm_max_ps(a, b); }
+	static F neg(F a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+	static F abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+	static F toFloat(I a) { return _mm_cvtepi32_ps(a); }
+	static I toInt(F a) { return _mm_cvttps_epi32(a); }
+	static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+	static I subi(I a, I b) { return _mm_sub_epi32(a, b); }
+	static I andi(I a, I b) { return _mm_and_si128(a, b); }
+	static I mullo(I a, I b) { return _mm_mullo_epi32(a, b); }
+	template<int N> static I slli(I a) { return _mm_slli_epi32(a, N); }
+	template<int N> static I srai(I a) { return _mm_srai_epi32(a, N); }
+
+	// no gather instruction before AVX2
+	static I gather32(const uint32_t* base, I index, M mask) {
+		alignas(16) int32_t idx[WIDTH];
+		alignas(16) uint32_t result[WIDTH];
+		_mm_store_si128(reinterpret_cast<__m128i*>(idx), index);
+		const uint32_t lanes = bits(mask);
+		for (int i = 0; i < WIDTH; ++i)
+			result[i] = (lanes >> i) & 1 ? base[idx[i]] : 0;
+		return _mm_load_si128(reinterpret_cast<const __m128i*>(result));
+	}
+	static I gatherBytes(const uint8_t* base, I offset, M mask) {
+		alignas(16) int32_t off[WIDTH];
+		alignas(16) uint32_t result[WIDTH];
+		_mm_store_si128(reinterpret_cast<__m128i*>(off), offset);
+		const uint32_t lanes = bits(mask);
+		for (int i = 0; i < WIDTH; ++i)
+			result[i] = (lanes >> i) & 1 ? base[off[i]] : 0;
+		return _mm_load_si128(reinterpret_cast<const __m128i*>(result));
+	}
+
+	static M less(F a, F b) { return _mm_cmplt_ps(a, b); }
+	static M lessi(I a, I b) { return _mm_castsi128_ps(_mm_cmplt_epi32(a, b)); }
+	static M equali(I a, I b) { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, b)); }
+	static M maskAll() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+	static M maskAnd(M a, M b) { return _mm_and_ps(a, b); }
+	static M maskOr(M a, M b) { return _mm_or_ps(a, b); }
+	static M maskXor(M a, M b) { return _mm_xor_ps(a, b); }
+	static M maskAndNot(M a, M b) { return _mm_andnot_ps(a, b); } // ~a & b
+	static M maskFromInt(I a) { return _mm_castsi128_ps(a); }
+	static M maskFromBits(uint32_t bits) {
+		const __m128i lane = _mm_setr_epi32(1, 2, 4, 8);
+		return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(int32_t(bits)), lane), lane));
+	}
+	static uint32_t bits(M m) { return uint32_t(_mm_movemask_ps(m)); }
+
+	static F select(M m, F a, F b) { return _mm_blendv_ps(b, a, m); }
+	static I selecti(M m, I a, I b) { return _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(b), _mm_castsi128_ps(a), m)); }
+};
+
+#include "PacketKernel.inl"
+
+}
+
+uint32_t marchPacketSSE41(RayPacket& packet, const VoxelGridView& grid, int maxSteps) {
+	return marchPacketImpl<Sse41>(packet, grid, maxSteps);
+}
+
+#endif
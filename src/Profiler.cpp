@@ -0,0 +1,256 @@
+#include "Profiler.h"
+
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <cfloat>
+#include <imgui.h>
+
+Profiler::Profiler(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight) :
+	device(device), history(HISTORY_SIZE), slotFrames(framesInFlight, 0)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	timestampPeriod = properties.limits.timestampPeriod;
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	const uint32_t validBits = queueFamilies[queueFamily].timestampValidBits;
+	gpuTimestamps = validBits > 0;
+	if (!gpuTimestamps)
+		return;
+	timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	VkQueryPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = QUERIES_PER_FRAME * framesInFlight;
+
+	if (vkCreateQueryPool(device, &poolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create timestamp Query Pool!");
+	}
+}
+
+Profiler::~Profiler() {
+	if (queryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(device, queryPool, nullptr);
+}
+
+void Profiler::beginFrame() {
+	++frameCount;
+	FrameTimes& row = history[frameCount % history.size()];
+	row = FrameTimes{};
+	row.frame = frameCount;
+}
+
+void Profiler::resetHistory(size_t size) {
+	history.assign(std::max<size_t>(size, 1), FrameTimes{});
+}
+
+void Profiler::addCpuTime(CpuSection section, Clock::time_point begin, Clock::time_point end) {
+	history[frameCount % history.size()].cpu[size_t(section)] += std::chrono::duration<float, std::milli>(end - begin).count();
+}
+
+bool Profiler::collectGpuTimes(uint32_t frameInFlight) {
+	if (!gpuTimestamps || slotFrames[frameInFlight] == 0)
+		return false;
+
+	uint64_t timestamps[QUERIES_PER_FRAME];
+	const VkResult result = vkGetQueryPoolResults(device, queryPool, frameInFlight * QUERIES_PER_FRAME, QUERIES_PER_FRAME,
+		sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	FrameTimes* row = findFrame(slotFrames[frameInFlight]);
+	slotFrames[frameInFlight] = 0;
+	if (result != VK_SUCCESS || row == nullptr)
+		return false; // not all sections were written or the frame already left the history
+
+	for (uint32_t i = 0; i < uint32_t(GpuSection::COUNT); ++i) {
+		const uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask;
+		row->gpu[i] = float(double(ticks) * timestampPeriod * 1e-6);
+		latestGpu[i] = row->gpu[i];
+	}
+	row->gpuValid = true;
+	return true;
+}
+
+void Profiler::resetQueries(VkCommandBuffer commandBuffer, uint32_t frameInFlight) {
+	if (!gpuTimestamps)
+		return;
+	vkCmdResetQueryPool(commandBuffer, queryPool, frameInFlight * QUERIES_PER_FRAME, QUERIES_PER_FRAME);
+	slotFrames[frameInFlight] = frameCount;
+}
+
+void Profiler::writeTimestamp(VkCommandBuffer commandBuffer, uint32_t frameInFlight, GpuSection section, bool end) {
+	if (!gpuTimestamps)
+		return;
+	const uint32_t query = frameInFlight * QUERIES_PER_FRAME + uint32_t(section) * 2 + (end ? 1 : 0);
+	vkCmdWriteTimestamp(commandBuffer, end ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, query);
+}
+
+Profiler::FrameTimes* Profiler::findFrame(uint64_t frame) {
+	FrameTimes& row = history[frame % history.size()];
+	return row.frame == frame ? &row : nullptr;
+}
+
+// oldest frame first
+template<typename Func>
+void Profiler::forEachFrame(Func func) const {
+	for (size_t i = 1; i <= history.size(); ++i) {
+		const FrameTimes& row = history[(frameCount + i) % history.size()];
+		if (row.frame != 0)
+			func(row);
+	}
+}
+
+float Profiler::getCpuMean(CpuSection section) const {
+	double sum = 0.0;
+	size_t count = 0;
+	forEachFrame([&](const FrameTimes& row) { sum += row.cpu[size_t(section)]; ++count; });
+	return count ? float(sum / count) : 0.0f;
+}
+
+float Profiler::getGpuMean(GpuSection section) const {
+	double sum = 0.0;
+	size_t count = 0;
+	forEachFrame([&](const FrameTimes& row) {
+		if (row.gpuValid) {
+			sum += row.gpu[size_t(section)];
+			++count;
+		}
+	});
+	return count ? float(sum / count) : 0.0f;
+}
+
+std::vector<float> Profiler::getGpuTimes(GpuSection section) const {
+	std::vector<float> times;
+	forEachFrame([&](const FrameTimes& row) {
+		if (row.gpuValid)
+			times.push_back(row.gpu[size_t(section)]);
+	});
+	return times;
+}
+
+const char* Profiler::getName(CpuSection section) {
+	switch (section) {
+	case CpuSection::WAIT: return "wait";
+	case CpuSection::UBO_UPLOAD: return "ubo_upload";
+	case CpuSection::STREAM: return "stream";
+	case CpuSection::RECORD: return "record";
+	case CpuSection::SUBMIT_PRESENT: return "submit_present";
+	default: return "unknown";
+	}
+}
+
+const char* Profiler::getName(GpuSection section) {
+	switch (section) {
+	case GpuSection::TRACE: return "trace";
+	case GpuSection::DENOISE: return "denoise";
+	case GpuSection::GUI: return "gui";
+	default: return "unknown";
+	}
+}
+
+void Profiler::drawGUI() {
+	if (!ImGui::CollapsingHeader("Timings"))
+		return;
+
+	std::vector<float> values;
+	values.reserve(history.size());
+	auto plot = [&](const std::string& label, float mean) {
+		char overlay[32];
+		snprintf(overlay, sizeof(overlay), "%.3f ms", mean);
+		ImGui::PlotHistogram(label.c_str(), values.data(), int(values.size()), 0, overlay, 0.0f, FLT_MAX, ImVec2(0, 40));
+		values.clear();
+	};
+
+	for (size_t i = 0; i < size_t(CpuSection::COUNT); ++i) {
+		forEachFrame([&](const FrameTimes& row) { values.push_back(row.cpu[i]); });
+		plot(std::string("CPU ") + getName(CpuSection(i)), getCpuMean(CpuSection(i)));
+	}
+
+	if (!gpuTimestamps) {
+		ImGui::Text("No GPU timestamps on this queue");
+	}
+	else {
+		for (size_t i = 0; i < size_t(GpuSection::COUNT); ++i) {
+			forEachFrame([&](const FrameTimes& row) { if (row.gpuValid) values.push_back(row.gpu[i]); });
+			plot(std::string("GPU ") + getName(GpuSection(i)), getGpuMean(GpuSection(i)));
+		}
+	}
+
+	const char* exportFile = nullptr;
+	if (ImGui::Button("Export CSV"))
+		exportFile = "timings.csv";
+	ImGui::SameLine();
+	if (ImGui::Button("Export JSON"))
+		exportFile = "timings.json";
+	if (exportFile) {
+		try {
+			writeFile(exportFile);
+		}
+		catch (const std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
+		}
+	}
+}
+
+void Profiler::writeFile(const std::string& fileName) const {
+	if (fileName.size() >= 5 && fileName.compare(fileName.size() - 5, 5, ".json") == 0)
+		writeJSON(fileName);
+	else
+		writeCSV(fileName);
+}
+
+void Profiler::writeCSV(const std::string& fileName) const {
+	std::ofstream file(fileName);
+	if (!file.is_open())
+		throw std::runtime_error("Could not open file " + fileName + "!");
+
+	file << "frame";
+	for (size_t i = 0; i < size_t(CpuSection::COUNT); ++i)
+		file << ",cpu_" << getName(CpuSection(i)) << "_ms";
+	for (size_t i = 0; i < size_t(GpuSection::COUNT); ++i)
+		file << ",gpu_" << getName(GpuSection(i)) << "_ms";
+	file << "\n";
+
+	// GPU columns stay empty for frames without results
+	forEachFrame([&](const FrameTimes& row) {
+		file << row.frame;
+		for (float t : row.cpu)
+			file << "," << t;
+		for (float t : row.gpu) {
+			file << ",";
+			if (row.gpuValid)
+				file << t;
+		}
+		file << "\n";
+	});
+}
+
+void Profiler::writeJSON(const std::string& fileName) const {
+	std::ofstream file(fileName);
+	if (!file.is_open())
+		throw std::runtime_error("Could not open file " + fileName + "!");
+
+	file << "{\n  \"unit\": \"ms\",\n  \"frames\": [";
+	bool first = true;
+	forEachFrame([&](const FrameTimes& row) {
+		file << (first ? "\n" : ",\n") << "    { \"frame\": " << row.frame << ", \"cpu\": { ";
+		first = false;
+		for (size_t i = 0; i < size_t(CpuSection::COUNT); ++i)
+			file << (i ? ", " : "") << "\"" << getName(CpuSection(i)) << "\": " << row.cpu[i];
+		file << " }";
+		if (row.gpuValid) {
+			file << ", \"gpu\": { ";
+			for (size_t i = 0; i < size_t(GpuSection::COUNT); ++i)
+				file << (i ? ", " : "") << "\"" << getName(GpuSection(i)) << "\": " << row.gpu[i];
+			file << " }";
+		}
+		file << " }";
+	});
+	file << "\n  ]\n}\n";
+}
@@ -0,0 +1,35 @@
+#include "RenderScale.h"
+
+#include <algorithm>
+#include <cmath>
+
+float RenderScaleController::update(float gpuMs) {
+	if (gpuMs <= 0.0f)
+		return scale;
+	if (skip > 0) {
+		--skip;
+		return scale;
+	}
+
+	filteredMs = filteredMs > 0.0f ? filteredMs + SMOOTHING * (gpuMs - filteredMs) : gpuMs;
+
+	// a wider band for growing than for shrinking keeps the scale from toggling between two steps
+	const float ratio = targetMs / filteredMs;
+	if (ratio >= 0.95f && ratio <= 1.15f)
+		return scale;
+
+	// time is proportional to scale^2, the step is limited so a single slow frame can not collapse the resolution
+	const float factor = std::clamp(std::sqrt(ratio), 0.75f, 1.25f);
+	const float newScale = std::clamp(std::round(scale * factor * STEPS) / STEPS, minScale, maxScale);
+	if (newScale != scale) {
+		scale = newScale;
+		filteredMs = 0.0f;
+	}
+	return scale;
+}
+
+void RenderScaleController::reset(float newScale) {
+	scale = std::clamp(newScale, minScale, maxScale);
+	filteredMs = 0.0f;
+	skip = 0;
+}
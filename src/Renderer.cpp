@@ -2,8 +2,13 @@
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
-#include <Vulkan/Vulkan.hpp>
+#include <vulkan/vulkan.hpp>
 #include <iostream>
+#include <cstring>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <filesystem>
 #include <imgui.h>
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_vulkan.h>
@@ -12,11 +17,27 @@ struct UniformBufferObject {
 	int max_samples;
 	int max_steps;
 	int max_total_reflections;
-	int time;
+	uint32_t sample_seed;
 	alignas(16)glm::ivec2 screen;
+	int accumulated_frames;
+	int refraction;
+	glm::ivec2 display;
+	int interleave;
+	int interleave_phase;
 	alignas(16)glm::vec3 pos;
+	int history_layer;
 	alignas(16)glm::mat4 view;
 	glm::mat4 proj;
+	glm::mat4 prev_view;
+	glm::mat4 prev_proj;
+	glm::ivec4 reset_rect;
+	int reset_frames;
+	int denoise_passes;
+	float denoise_strength;
+	int denoise_history;
+	int sampler_type;
+	int max_diffuse_bounces;
+	int roulette_depth;
 };
 
 uint32_t Renderer::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
@@ -58,7 +79,715 @@ void Renderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemor
 	vkBindBufferMemory(device, buffer, bufferMemory, 0);
 }
 
+void Renderer::createOffscreenTarget() {
+	// stands in for the swap chain: a single color image that is copied to host memory after every frame
+	swapChainImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = swapChainImageFormat;
+	imageInfo.extent = { swapChainExtent.width, swapChainExtent.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if (vkCreateImage(device, &imageInfo, nullptr, &offscreenImage) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create offscreen Image!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, offscreenImage, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &offscreenImageMemory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate offscreen Image memory!");
+	}
+
+	vkBindImageMemory(device, offscreenImage, offscreenImageMemory, 0);
+
+	swapChainImages = { offscreenImage };
+}
+
+// rgba32f image of the swap chain size that the shaders read and write, left in the general layout
+void Renderer::createStorageImage(uint32_t layers, VkImage& image, VkDeviceMemory& memory, VkImageView& view) {
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	imageInfo.extent = { swapChainExtent.width, swapChainExtent.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = layers;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT; // frame capture copies it out, or scales it up
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create storage Image!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate storage Image memory!");
+	}
+
+	vkBindImageMemory(device, image, memory, 0);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image;
+	viewInfo.viewType = layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.layerCount = layers;
+
+	if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create storage Image View!");
+	}
+
+	// the image stays in the general layout for its whole life
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(commandBuffers[MAX_FRAMES_IN_FLIGHT], &beginInfo);
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = viewInfo.subresourceRange;
+	vkCmdPipelineBarrier(commandBuffers[MAX_FRAMES_IN_FLIGHT], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	vkEndCommandBuffer(commandBuffers[MAX_FRAMES_IN_FLIGHT]);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffers[MAX_FRAMES_IN_FLIGHT];
+
+	vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	vkQueueWaitIdle(graphicsQueue);
+}
+
+// fullscreen triangle pipeline with screenQuadVS and the given fragment shader
+VkPipeline Renderer::createScreenQuadPipeline(Shader* fragmentShader) {
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)swapChainExtent.width;
+	viewport.height = (float)swapChainExtent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor{};
+	scissor.offset = { 0, 0 };
+	scissor.extent = swapChainExtent;
+
+	// Rasterizer
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
+	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizer.depthBiasEnable = VK_FALSE;
+	rasterizer.depthBiasConstantFactor = 0.0f; // Optional
+	rasterizer.depthBiasClamp = 0.0f; // Optional
+	rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisampling.minSampleShading = 1.0f; // Optional
+	multisampling.pSampleMask = nullptr; // Optional
+	multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
+	multisampling.alphaToOneEnable = VK_FALSE; // Optional
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_FALSE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; //Optional
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; //Optional
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; //Optional
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; //Optional
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+	colorBlending.blendConstants[0] = 0.0f; // Optional
+	colorBlending.blendConstants[1] = 0.0f; // Optional
+	colorBlending.blendConstants[2] = 0.0f; // Optional
+	colorBlending.blendConstants[3] = 0.0f; // Optional
+
+	std::vector<VkDynamicState> dynamicStates = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicState.pDynamicStates = dynamicStates.data();
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.pViewports = &viewport;
+	viewportState.scissorCount = 1;
+	viewportState.pScissors = &scissor;
+
+
+	VkPipelineShaderStageCreateInfo shaderStages[] = { screenQuadVS->getShaderStageInfo(), fragmentShader->getShaderStageInfo() };
+
+	// For the Screen Quad Render
+	// Create 3 Verticies with no information (info is added later in vertex shader)
+	VkPipelineVertexInputStateCreateInfo emptyInputState{};
+	emptyInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	emptyInputState.vertexAttributeDescriptionCount = 0;
+	emptyInputState.pVertexAttributeDescriptions = nullptr;
+	emptyInputState.vertexBindingDescriptionCount = 0;
+	emptyInputState.pVertexBindingDescriptions = nullptr;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &emptyInputState;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = nullptr; // Optional
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = pipelineLayout;
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = 0;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+	pipelineInfo.basePipelineIndex = -1; // Optional
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Graphics Pipeline!");
+	}
+	return pipeline;
+}
+
+void Renderer::checkWorkgroupSize(glm::uvec2 size) {
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	if (size.x == 0 || size.y == 0
+		|| size.x > properties.limits.maxComputeWorkGroupSize[0] || size.y > properties.limits.maxComputeWorkGroupSize[1]
+		|| size.x * size.y > properties.limits.maxComputeWorkGroupInvocations) {
+		throw std::runtime_error("Workgroup size not supported by the device!");
+	}
+}
+
+void Renderer::createTracePipeline(TierVariant& tier) {
+	checkWorkgroupSize(workgroupSize);
+
+	// local_size_x_id = 0, local_size_y_id = 1 in trace.comp
+	const VkSpecializationMapEntry mapEntries[] = {
+		{ 0, 0, sizeof(uint32_t) },
+		{ 1, sizeof(uint32_t), sizeof(uint32_t) }
+	};
+	VkSpecializationInfo specializationInfo{};
+	specializationInfo.mapEntryCount = 2;
+	specializationInfo.pMapEntries = mapEntries;
+	specializationInfo.dataSize = sizeof(workgroupSize);
+	specializationInfo.pData = &workgroupSize;
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = tier.traceCS->getShaderStageInfo();
+	pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+	pipelineInfo.layout = pipelineLayout;
+
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Trace Pipeline!");
+	}
+
+	if (tier.tracePipeline != VK_NULL_HANDLE)
+		retirePipeline(tier.tracePipeline);
+	tier.tracePipeline = pipeline;
+}
+
+void Renderer::createDenoisePipeline() {
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = denoiseCS->getShaderStageInfo();
+	pipelineInfo.layout = pipelineLayout;
+
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Denoise Pipeline!");
+	}
+
+	if (denoisePipeline != VK_NULL_HANDLE)
+		retirePipeline(denoisePipeline);
+	denoisePipeline = pipeline;
+}
+
+void Renderer::createWavefrontPipeline(TierVariant& tier, WavefrontKernel kernel) {
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = tier.wavefrontCS[kernel]->getShaderStageInfo();
+	pipelineInfo.layout = pipelineLayout;
+
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Wavefront Pipeline!");
+	}
+
+	if (tier.wavefrontPipelines[kernel] != VK_NULL_HANDLE)
+		retirePipeline(tier.wavefrontPipelines[kernel]);
+	tier.wavefrontPipelines[kernel] = pipeline;
+}
+
+// queues and PREPARE modes of wavefront.comp
+enum { WAVEFRONT_QUEUE_EXTEND, WAVEFRONT_QUEUE_DIFFUSE, WAVEFRONT_QUEUE_WATER, WAVEFRONT_QUEUE_COUNT };
+enum { WAVEFRONT_PREPARE_RESET, WAVEFRONT_PREPARE_SHADING, WAVEFRONT_PREPARE_EXTENSION };
+// StoredPath in wavefront.comp
+constexpr VkDeviceSize WAVEFRONT_PATH_SIZE = 128;
+// indirect dispatches and queue sizes in front of the queues
+constexpr VkDeviceSize WAVEFRONT_QUEUE_HEADER_SIZE = 64;
+// truncatedPaths in the header
+constexpr VkDeviceSize WAVEFRONT_TRUNCATED_OFFSET = 60;
+
+// a path takes a round per event: its diffuse bounces, one more to end at the bounce cap and the water surfaces it
+// crosses, which only the reflections bound loosely. Every event costs a step, so max_steps + 1 rounds finish any path
+static int32_t estimateWavefrontRounds(const TraceSettings& settings) {
+	return std::clamp(settings.max_diffuse_bounces + 2 + (settings.refraction ? 2 * settings.max_total_reflections + 4 : 0),
+		1, std::max(settings.max_steps, 0) + 1);
+}
+
+// room for a wave of the whole image unless its samples take more than the maximum
+static uint32_t getWavefrontCapacity(VkExtent2D extent, const TraceSettings& settings) {
+	return uint32_t(std::min(VkDeviceSize(Renderer::MAX_WAVEFRONT_PATHS), VkDeviceSize(extent.width) * extent.height * std::max(settings.max_samples, 1)));
+}
+
+void Renderer::createWavefrontBuffers() {
+	// the descriptor sets of the frames in flight get the new buffers
+	vkDeviceWaitIdle(device);
+	vkDestroyBuffer(device, wavefrontPathBuffer, nullptr);
+	vkFreeMemory(device, wavefrontPathBufferMemory, nullptr);
+	vkDestroyBuffer(device, wavefrontQueueBuffer, nullptr);
+	vkFreeMemory(device, wavefrontQueueBufferMemory, nullptr);
+
+	wavefrontCapacity = getWavefrontCapacity(swapChainExtent, getTraceSettings());
+	createBuffer(wavefrontCapacity * WAVEFRONT_PATH_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		wavefrontPathBuffer, wavefrontPathBufferMemory);
+	createBuffer(WAVEFRONT_QUEUE_HEADER_SIZE + WAVEFRONT_QUEUE_COUNT * wavefrontCapacity * sizeof(uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, wavefrontQueueBuffer, wavefrontQueueBufferMemory);
+	if (wavefrontStatsBuffer == VK_NULL_HANDLE) {
+		const VkDeviceSize statsSize = MAX_FRAMES_IN_FLIGHT * sizeof(uint32_t);
+		createBuffer(statsSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			wavefrontStatsBuffer, wavefrontStatsBufferMemory);
+		void* mapped;
+		vkMapMemory(device, wavefrontStatsBufferMemory, 0, statsSize, 0, &mapped);
+		wavefrontStatsMapped = static_cast<uint32_t*>(mapped);
+	}
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		VkDescriptorBufferInfo pathsInfo{};
+		pathsInfo.buffer = wavefrontPathBuffer;
+		pathsInfo.offset = 0;
+		pathsInfo.range = VK_WHOLE_SIZE;
+		VkDescriptorBufferInfo queuesInfo = pathsInfo;
+		queuesInfo.buffer = wavefrontQueueBuffer;
+
+		VkWriteDescriptorSet descriptorWrites[2]{};
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = descriptorSets[i];
+		descriptorWrites[0].dstBinding = 7;
+		descriptorWrites[0].dstArrayElement = 0;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[0].descriptorCount = 1;
+		descriptorWrites[0].pBufferInfo = &pathsInfo;
+		descriptorWrites[1] = descriptorWrites[0];
+		descriptorWrites[1].dstBinding = 8;
+		descriptorWrites[1].pBufferInfo = &queuesInfo;
+		vkUpdateDescriptorSets(device, 2, descriptorWrites, 0, nullptr);
+	}
+}
+
+static std::filesystem::path getPipelineCacheFile() {
+	return Shader::getCacheDirectory() / "pipeline_cache.bin";
+}
+
+void Renderer::createPipelineCache() {
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	// only use data written by the same device and driver, some drivers do not check themselves
+	std::vector<char> data;
+	if (!Shader::getCacheDirectory().empty()) {
+		std::ifstream file(getPipelineCacheFile(), std::ios::binary | std::ios::ate);
+		if (file.is_open()) {
+			data.resize(size_t(file.tellg()));
+			file.seekg(0, std::ios::beg);
+			file.read(data.data(), data.size());
+		}
+
+		VkPipelineCacheHeaderVersionOne header{};
+		if (data.size() >= sizeof(header))
+			memcpy(&header, data.data(), sizeof(header));
+		if (data.size() < sizeof(header) || header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			|| header.vendorID != properties.vendorID || header.deviceID != properties.deviceID
+			|| memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+			data.clear();
+		}
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Pipeline Cache!");
+	}
+}
+
+void Renderer::savePipelineCache() {
+	if (Shader::getCacheDirectory().empty())
+		return;
+
+	size_t size = 0;
+	vkGetPipelineCacheData(device, pipelineCache, &size, nullptr);
+	std::vector<char> data(size);
+	if (size == 0 || vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS)
+		return;
+
+	std::error_code error;
+	std::filesystem::create_directories(Shader::getCacheDirectory(), error);
+	std::ofstream file(getPipelineCacheFile(), std::ios::binary);
+	file.write(data.data(), size);
+	if (!file)
+		std::cerr << "Could not write " << getPipelineCacheFile().generic_string() << std::endl;
+}
+
+void Renderer::retirePipeline(VkPipeline pipeline) {
+	// frames recorded so far may still use it, the last of them is done once the slots came around once more
+	retiredPipelines.push_back({ pipeline, frameNumber + framesInFlight });
+}
+
+void Renderer::destroyRetiredPipelines(bool all) {
+	auto retired = std::remove_if(retiredPipelines.begin(), retiredPipelines.end(), [&](const RetiredPipeline& r) {
+		if (!all && r.lastFrame > frameNumber)
+			return false;
+		vkDestroyPipeline(device, r.pipeline, nullptr);
+		return true;
+	});
+	retiredPipelines.erase(retired, retiredPipelines.end());
+}
+
+void Renderer::setWorkgroupSize(uint32_t x, uint32_t y) {
+	if (workgroupSize == glm::uvec2(x, y))
+		return;
+	checkWorkgroupSize(glm::uvec2(x, y));
+	const glm::uvec2 previous = workgroupSize;
+	workgroupSize = glm::uvec2(x, y);
+	// the other tiers pick the size up when they get used again
+	TierVariant& current = tiers[size_t(qualityTier)];
+	for (TierVariant& tier : tiers) {
+		if (&tier != &current && tier.tracePipeline != VK_NULL_HANDLE) {
+			retirePipeline(tier.tracePipeline);
+			tier.tracePipeline = VK_NULL_HANDLE;
+		}
+	}
+	// without a pipeline yet the size is picked up when it gets created
+	if (current.tracePipeline == VK_NULL_HANDLE)
+		return;
+	try {
+		createTracePipeline(current);
+	}
+	catch (const std::runtime_error&) {
+		workgroupSize = previous;
+		throw;
+	}
+}
+
+void Renderer::setFramesInFlight(uint32_t count) {
+	if (count < 1 || count > MAX_FRAMES_IN_FLIGHT)
+		throw std::runtime_error("Frames in flight must be between 1 and " + std::to_string(MAX_FRAMES_IN_FLIGHT) + "!");
+	if (count == framesInFlight)
+		return;
+
+	// every slot is idle afterwards, so the cycle can start over with any count
+	finish();
+	vkDeviceWaitIdle(device);
+	framesInFlight = count;
+	currentFrame = 0;
+}
+
+std::vector<VkPresentModeKHR> Renderer::getSupportedPresentModes() {
+	if (headless)
+		return {};
+	return getSwapChainSupportDetails(physicalDevice).presentModes;
+}
+
+void Renderer::setPresentMode(VkPresentModeKHR mode) {
+	if (mode == presentMode)
+		return;
+	const std::vector<VkPresentModeKHR> modes = getSupportedPresentModes();
+	if (std::find(modes.begin(), modes.end(), mode) == modes.end())
+		throw std::runtime_error(std::string("Present mode ") + getPresentModeName(mode) + " not supported by the surface!");
+
+	presentMode = mode;
+	recreateSwapChain();
+}
+
+const char* Renderer::getPresentModeName(VkPresentModeKHR mode) {
+	switch (mode) {
+	case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+	case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+	case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo_relaxed";
+	default: return "unknown";
+	}
+}
+
+void Renderer::setInterleave(uint32_t n) {
+	if (n != 1 && n != 2 && n != 4)
+		throw std::runtime_error("Interleave must be 1, 2 or 4!");
+	interleave = n;
+}
+
+void Renderer::setDenoise(uint32_t passes, float strength) {
+	if (passes > MAX_DENOISE_PASSES)
+		throw std::runtime_error("At most " + std::to_string(MAX_DENOISE_PASSES) + " denoise passes!");
+	denoisePasses = passes;
+	denoiseStrength = strength;
+}
+
+void Renderer::setRenderScale(float scale) {
+	adaptiveResolution = false;
+	scaleController.reset(scale);
+}
+
+void Renderer::setAdaptiveResolution(bool enabled, float targetMs) {
+	if (enabled && !adaptiveResolution)
+		scaleController.reset(scaleController.getScale());
+	adaptiveResolution = enabled;
+	scaleController.targetMs = targetMs;
+}
+
+void Renderer::updateRenderExtent() {
+	const float scale = scaleController.getScale();
+	const VkExtent2D extent = {
+		std::clamp(uint32_t(std::lround(swapChainExtent.width * scale)), 1u, swapChainExtent.width),
+		std::clamp(uint32_t(std::lround(swapChainExtent.height * scale)), 1u, swapChainExtent.height)
+	};
+	if (extent.width == renderExtent.width && extent.height == renderExtent.height)
+		return;
+
+	// the frames still in flight were recorded at the old extent, their timings say nothing about the new one
+	if (renderExtent.width != 0)
+		scaleController.skipSamples(framesInFlight - 1);
+	renderExtent = extent;
+}
+
+void Renderer::recreateSwapChain() {
+	vkDeviceWaitIdle(device);
+
+	for (auto framebuffer : swapChainFramebuffers)
+		vkDestroyFramebuffer(device, framebuffer, nullptr);
+	for (auto imageView : swapChainImageViews)
+		vkDestroyImageView(device, imageView, nullptr);
+	vkDestroySwapchainKHR(device, swapChain, nullptr);
+
+	// format and extent stay the same, so the render pass, the pipelines and the accumulation image do as well
+	createSwapChain();
+	createImageViews();
+	createFramebuffers();
+}
+
 Renderer::Renderer(GLFWwindow* window) : window(window)
+{
+	init();
+}
+
+Renderer::Renderer(uint32_t width, uint32_t height) : window(nullptr), headless(true)
+{
+	// no window, no surface and no swap chain: render into an offscreen image instead
+	swapChainExtent = { width, height };
+	deviceExtensions.clear();
+	init();
+}
+
+void Renderer::createSwapChain() {
+	SwapChainSupportDetails sc_details = getSwapChainSupportDetails(physicalDevice);
+	VkSurfaceFormatKHR swapSurfaceFormat;
+	VkExtent2D swapExtend;
+
+	// choose surface format
+	{
+		bool found = false;
+		for (const auto& availableFormat : sc_details.formats) {
+			if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB &&
+				availableFormat.colorSpace ==
+				VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+				swapSurfaceFormat = availableFormat;
+				found = true;
+				break;
+			}
+		}
+
+		if (!found) {
+			swapSurfaceFormat = sc_details.formats[0];
+		}
+	}
+
+	// choose swap extend (resolution)
+	if (sc_details.capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
+		swapExtend = sc_details.capabilities.currentExtent;
+	}
+	else {
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+		VkExtent2D actualExtent = {
+			static_cast<uint32_t>(width),
+			static_cast<uint32_t>(height)
+		};
+		actualExtent.width = std::clamp(actualExtent.width,
+			sc_details.capabilities.minImageExtent.width,
+			sc_details.capabilities.maxImageExtent.width);
+		actualExtent.height = std::clamp(actualExtent.height,
+			sc_details.capabilities.minImageExtent.height,
+			sc_details.capabilities.maxImageExtent.height);
+		swapExtend = actualExtent;
+	}
+
+	// images in swap chain (min + 1 to not wait on driver)
+	uint32_t imageCount = sc_details.capabilities.minImageCount + 1;
+	if (sc_details.capabilities.maxImageCount > 0 && imageCount > sc_details.capabilities.maxImageCount) {
+		imageCount = sc_details.capabilities.maxImageCount;
+	}
+
+	// creating the swap chain
+	VkSwapchainCreateInfoKHR createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+	createInfo.surface = surface;
+	createInfo.minImageCount = imageCount;
+	createInfo.imageFormat = swapSurfaceFormat.format;
+	createInfo.imageColorSpace = swapSurfaceFormat.colorSpace;
+	createInfo.imageExtent = swapExtend;
+	createInfo.imageArrayLayers = 1; // always 1 as we are not rendering in 3D
+	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+	if (graphicsFamily != presentFamily) {
+		uint32_t queueFamily[2] = { graphicsFamily, presentFamily };
+		createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+		createInfo.queueFamilyIndexCount = 2;
+		createInfo.pQueueFamilyIndices = queueFamily;
+	}
+	else {
+		createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		//createInfo.queueFamilyIndexCount = 0; // Optional
+		//createInfo.pQueueFamilyIndices = nullptr; // Optional
+	}
+
+	createInfo.preTransform = sc_details.capabilities.currentTransform;
+	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+	createInfo.presentMode = presentMode;
+	createInfo.clipped = VK_TRUE;
+	createInfo.oldSwapchain = VK_NULL_HANDLE;
+
+	if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Swap Chain!");
+	}
+
+	// retrieve swap chain images
+	vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
+	swapChainImages.resize(imageCount);
+	vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
+
+	swapChainImageFormat = swapSurfaceFormat.format;
+	swapChainExtent = swapExtend;
+}
+
+void Renderer::createImageViews() {
+	swapChainImageViews.resize(swapChainImages.size());
+	for (size_t i = 0; i < swapChainImages.size(); i++) {
+		VkImageViewCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		createInfo.image = swapChainImages[i];
+		createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		createInfo.format = swapChainImageFormat;
+		createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+		createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		createInfo.subresourceRange.baseMipLevel = 0;
+		createInfo.subresourceRange.levelCount = 1;
+		createInfo.subresourceRange.baseArrayLayer = 0;
+		createInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(device, &createInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create Image Views!");
+		}
+	}
+}
+
+void Renderer::createFramebuffers() {
+	swapChainFramebuffers.resize(swapChainImageViews.size());
+	for (size_t i = 0; i < swapChainImageViews.size(); i++) {
+		VkImageView attachments[] = { swapChainImageViews[i] };
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = renderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = attachments;
+		framebufferInfo.width = swapChainExtent.width;
+		framebufferInfo.height = swapChainExtent.height;
+		framebufferInfo.layers = 1;
+		if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create Framebuffer!");
+		}
+	}
+}
+
+void Renderer::init()
 {
 	// init Vulkan
 	// optional application Info, more information for the driver
@@ -82,6 +811,7 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 		std::vector<VkLayerProperties> availableLayers(layerCount);
 		vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
 
+		bool allLayersFound = true;
 		for (const char* layerName : validationLayers) {
 			bool layerFound = false;
 
@@ -93,7 +823,11 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 			}
 
 			if (!layerFound) {
-				throw std::runtime_error("No validation layer support!");
+				// render farm nodes usually come without the SDK, so headless runs without validation
+				if (!headless)
+					throw std::runtime_error("No validation layer support!");
+				std::cout << "Validation layer " << layerName << " not found, continuing without validation!" << std::endl;
+				allLayersFound = false;
 			}
 		}
 
@@ -102,16 +836,18 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 		createInfo.pApplicationInfo = &appInfo;
 
-		// get required Vulkan extensions from GLFW
+		// get required Vulkan extensions from GLFW (none needed without a window)
 		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		const char** glfwExtensions = nullptr;
+		if (!headless)
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 		createInfo.enabledExtensionCount = glfwExtensionCount;
 		createInfo.ppEnabledExtensionNames = glfwExtensions;
 
-		// no validation layers
-		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-		createInfo.ppEnabledLayerNames = validationLayers.data();
+		if (allLayersFound) {
+			createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+			createInfo.ppEnabledLayerNames = validationLayers.data();
+		}
 
 		// create Vulkan instance
 		if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS)
@@ -121,7 +857,7 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 	}
 
 	// create Window Surface for Vulkan
-	if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
+	if (!headless && glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create Window Surface in GLFW for Vulkan!");
 	}
 
@@ -149,7 +885,6 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 	}
 
 	// create logical device
-	uint32_t graphicsFamily = -1, presentFamily = -1;
 	{
 		// get graphics family of the physical device
 		uint32_t queueFamilyCount = 0;
@@ -159,10 +894,12 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 
 		uint32_t i = 0;
 		for (const auto& queueFamily : queueFamilies) {
-			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+			// the compute trace path runs on the graphics queue as well
+			if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
 				graphicsFamily = i;
-				VkBool32 presentSupport = false;
-				vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
+				VkBool32 presentSupport = headless; // nothing is presented in headless mode
+				if (!headless)
+					vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
 				if (presentSupport) {
 					presentFamily = i;
 				}
@@ -186,6 +923,7 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 		}
 
 		VkPhysicalDeviceFeatures deviceFeatures{};
+		deviceFeatures.fragmentStoresAndAtomics = VK_TRUE; // accumulation image
 
 		VkDeviceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -206,131 +944,15 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 	}
 
 	// configuring swap chain (framebuffer)
-	{
-		SwapChainSupportDetails sc_details = getSwapChainSupportDetails(physicalDevice);
-		VkSurfaceFormatKHR swapSurfaceFormat;
-		VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR; // this one is on every device
-		VkExtent2D swapExtend;
-
-		// choose surface format
-		{
-			bool found = false;
-			for (const auto& availableFormat : sc_details.formats) {
-				if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB &&
-					availableFormat.colorSpace ==
-					VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
-					swapSurfaceFormat = availableFormat;
-					found = true;
-					break;
-				}
-			}
-
-			if (!found) {
-				swapSurfaceFormat = sc_details.formats[0];
-			}
-		}
-
-		// choose presentation mode
-		//for (const auto& availablePresentMode : sc_details.presentModes) {
-		//	if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-		//		presentMode = availablePresentMode;
-		//	}
-		//}
-
-		// choose swap extend (resolution)
-		if (sc_details.capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
-			swapExtend = sc_details.capabilities.currentExtent;
-		}
-		else {
-			int width, height;
-			glfwGetFramebufferSize(window, &width, &height);
-			VkExtent2D actualExtent = {
-				static_cast<uint32_t>(width),
-				static_cast<uint32_t>(height)
-			};
-			actualExtent.width = std::clamp(actualExtent.width,
-				sc_details.capabilities.minImageExtent.width,
-				sc_details.capabilities.maxImageExtent.width);
-			actualExtent.height = std::clamp(actualExtent.height,
-				sc_details.capabilities.minImageExtent.height,
-				sc_details.capabilities.maxImageExtent.height);
-			swapExtend = actualExtent;
-		}
-
-		// images in swap chain (min + 1 to not wait on driver)
-		uint32_t imageCount = sc_details.capabilities.minImageCount + 1;
-		if (sc_details.capabilities.maxImageCount > 0 && imageCount > sc_details.capabilities.maxImageCount) {
-			imageCount = sc_details.capabilities.maxImageCount;
-		}
-
-		// creating the swap chain
-		VkSwapchainCreateInfoKHR createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-		createInfo.surface = surface;
-		createInfo.minImageCount = imageCount;
-		createInfo.imageFormat = swapSurfaceFormat.format;
-		createInfo.imageColorSpace = swapSurfaceFormat.colorSpace;
-		createInfo.imageExtent = swapExtend;
-		createInfo.imageArrayLayers = 1; // always 1 as we are not rendering in 3D
-		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-
-		if (graphicsFamily != presentFamily) {
-			uint32_t queueFamily[2] = { graphicsFamily, presentFamily };
-			createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-			createInfo.queueFamilyIndexCount = 2;
-			createInfo.pQueueFamilyIndices = queueFamily;
-		}
-		else {
-			createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			//createInfo.queueFamilyIndexCount = 0; // Optional
-			//createInfo.pQueueFamilyIndices = nullptr; // Optional
-		}
-
-		createInfo.preTransform = sc_details.capabilities.currentTransform;
-		createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-		createInfo.presentMode = presentMode;
-		createInfo.clipped = VK_TRUE;
-		createInfo.oldSwapchain = VK_NULL_HANDLE;
-
-		if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create Swap Chain!");
-		}
-
-		// retrieve swap chain images
-		vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
-		swapChainImages.resize(imageCount);
-		vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
-
-		swapChainImageFormat = swapSurfaceFormat.format;
-		swapChainExtent = swapExtend;
+	if (headless) {
+		createOffscreenTarget();
 	}
-
-	// create image views
-	{
-		swapChainImageViews.resize(swapChainImages.size());
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			VkImageViewCreateInfo createInfo{};
-			createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-			createInfo.image = swapChainImages[i];
-			createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			createInfo.format = swapChainImageFormat;
-			createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-			createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-			createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-			createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-			createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			createInfo.subresourceRange.baseMipLevel = 0;
-			createInfo.subresourceRange.levelCount = 1;
-			createInfo.subresourceRange.baseArrayLayer = 0;
-			createInfo.subresourceRange.layerCount = 1;
-
-			if (vkCreateImageView(device, &createInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS) {
-				throw std::runtime_error("Failed to create Image Views!");
-			}
-
-		}
+	else {
+		createSwapChain();
 	}
 
+	createImageViews();
+
 	// create render pass
 	VkAttachmentDescription colorAttachment{};
 	colorAttachment.format = swapChainImageFormat;
@@ -340,7 +962,7 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachment.finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
 	VkAttachmentReference colorAttachmentRef{};
 	colorAttachmentRef.attachment = 0;
@@ -355,6 +977,8 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependency.dstSubpass = 0;
 	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	if (headless) // the readback copy of the previous frame has to finish before the image is overwritten
+		dependency.srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
 	dependency.srcAccessMask = 0;
 	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
@@ -377,159 +1001,110 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 	uboLayoutBinding.binding = 0;
 	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	uboLayoutBinding.descriptorCount = 1;
-	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 	uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
 
-	VkDescriptorSetLayoutCreateInfo layoutInfo{};
-	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = 1;
-	layoutInfo.pBindings = &uboLayoutBinding;
-
-	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create Descriptor Set Layout!");
-	}
-
-	// create Graphics Pipeline
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 1; // Optional
-	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout; // Optional
-	pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-	pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
-	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create Pipeline Layout!");
-	}
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	VkViewport viewport{};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)swapChainExtent.width;
-	viewport.height = (float)swapChainExtent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor{};
-	scissor.offset = { 0, 0 };
-	scissor.extent = swapChainExtent;
-
-	// Rasterizer
-	VkPipelineRasterizationStateCreateInfo rasterizer{};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_FRONT_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-	rasterizer.depthBiasConstantFactor = 0.0f; // Optional
-	rasterizer.depthBiasClamp = 0.0f; // Optional
-	rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
+	VkDescriptorSetLayoutBinding worldLayoutBinding{};
+	worldLayoutBinding.binding = 1;
+	worldLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	worldLayoutBinding.descriptorCount = 1;
+	worldLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 
-	VkPipelineMultisampleStateCreateInfo multisampling{};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-	multisampling.minSampleShading = 1.0f; // Optional
-	multisampling.pSampleMask = nullptr; // Optional
-	multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
-	multisampling.alphaToOneEnable = VK_FALSE; // Optional
+	VkDescriptorSetLayoutBinding accumulationLayoutBinding{};
+	accumulationLayoutBinding.binding = 2;
+	accumulationLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	accumulationLayoutBinding.descriptorCount = 1;
+	accumulationLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 
-	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; //Optional
-	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; //Optional
-	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
-	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; //Optional
-	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; //Optional
-	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
+	VkDescriptorSetLayoutBinding historyLayoutBinding = accumulationLayoutBinding;
+	historyLayoutBinding.binding = 3;
 
-	VkPipelineColorBlendStateCreateInfo colorBlending{};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-	colorBlending.blendConstants[0] = 0.0f; // Optional
-	colorBlending.blendConstants[1] = 0.0f; // Optional
-	colorBlending.blendConstants[2] = 0.0f; // Optional
-	colorBlending.blendConstants[3] = 0.0f; // Optional
+	VkDescriptorSetLayoutBinding surfacesLayoutBinding = accumulationLayoutBinding;
+	surfacesLayoutBinding.binding = 4;
 
-	std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR
-	};
+	VkDescriptorSetLayoutBinding denoisedLayoutBinding = accumulationLayoutBinding;
+	denoisedLayoutBinding.binding = 5;
 
-	VkPipelineDynamicStateCreateInfo dynamicState{};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	dynamicState.pDynamicStates = dynamicStates.data();
+	VkDescriptorSetLayoutBinding blueNoiseLayoutBinding = worldLayoutBinding;
+	blueNoiseLayoutBinding.binding = 6;
 
-	VkPipelineViewportStateCreateInfo viewportState{};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
-	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
+	// paths and queues of the wavefront path, only its kernels use them
+	VkDescriptorSetLayoutBinding wavefrontPathsLayoutBinding = worldLayoutBinding;
+	wavefrontPathsLayoutBinding.binding = 7;
+	wavefrontPathsLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
+	VkDescriptorSetLayoutBinding wavefrontQueuesLayoutBinding = wavefrontPathsLayoutBinding;
+	wavefrontQueuesLayoutBinding.binding = 8;
 
-	screenQuadVS = new Shader(device, "screenQuad.vert");
-	screenQuadFS = new Shader(device, "screenQuad.frag");
-	VkPipelineShaderStageCreateInfo shaderStages[] = { screenQuadVS->getShaderStageInfo(), screenQuadFS->getShaderStageInfo() };
+	VkDescriptorSetLayoutBinding layoutBindings[] = { uboLayoutBinding, worldLayoutBinding, accumulationLayoutBinding, historyLayoutBinding,
+		surfacesLayoutBinding, denoisedLayoutBinding, blueNoiseLayoutBinding, wavefrontPathsLayoutBinding, wavefrontQueuesLayoutBinding };
 
-	// For the Screen Quad Render
-	// Create 3 Verticies with no information (info is added later in vertex shader)
-	VkPipelineVertexInputStateCreateInfo emptyInputState{};
-	emptyInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	emptyInputState.vertexAttributeDescriptionCount = 0;
-	emptyInputState.pVertexAttributeDescriptions = nullptr;
-	emptyInputState.vertexBindingDescriptionCount = 0;
-	emptyInputState.pVertexBindingDescriptions = nullptr;
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 9;
+	layoutInfo.pBindings = layoutBindings;
 
-	VkGraphicsPipelineCreateInfo pipelineInfo{};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &emptyInputState;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = nullptr; // Optional
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.layout = pipelineLayout;
-	pipelineInfo.renderPass = renderPass;
-	pipelineInfo.subpass = 0;
-	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
-	pipelineInfo.basePipelineIndex = -1; // Optional
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Descriptor Set Layout!");
+	}
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create Graphics Pipeline!");
+	// create Graphics Pipeline
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1; // Optional
+	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout; // Optional
+	// the number of the denoise pass, or the mode and the pixels of a wavefront kernel
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = 3 * sizeof(int32_t);
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create Pipeline Layout!");
 	}
 
-	swapChainFramebuffers.resize(swapChainImageViews.size());
-	for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-		VkImageView attachments[] = { swapChainImageViews[i] };
-		
-		VkFramebufferCreateInfo framebufferInfo{};
-		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferInfo.renderPass = renderPass;
-		framebufferInfo.attachmentCount = 1;
-		framebufferInfo.pAttachments = attachments;
-		framebufferInfo.width = swapChainExtent.width;
-		framebufferInfo.height = swapChainExtent.height;
-		framebufferInfo.layers = 1;
-		if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create Framebuffer!");
+	createPipelineCache();
+
+	// every shader compiles in the background from the start, the pipelines are created on first use
+	// by preparePipelines() which only waits for the shaders of the current trace path
+	shaderCompiler = new ShaderCompiler(device);
+	screenQuadVS = new Shader(device, "screenQuad.vert");
+	// compute trace path: the screen quad only shows the accumulation image
+	presentFS = new Shader(device, "present.frag");
+	denoiseCS = new Shader(device, "denoise.comp");
+	shaders = { screenQuadVS, presentFS, denoiseCS };
+	// every tier but CUSTOM compiles its settings in, see trace.glsl
+	tiers.resize(size_t(QualityTier::COUNT));
+	for (size_t i = 0; i < tiers.size(); ++i) {
+		ShaderMacros macros;
+		if (QualityTier(i) != QualityTier::CUSTOM) {
+			const TraceSettings& tierSettings = getQualityTierInfo(QualityTier(i)).settings;
+			macros = {
+				{ "QUALITY_TIER", "1" },
+				{ "TIER_MAX_SAMPLES", std::to_string(tierSettings.max_samples) },
+				{ "TIER_MAX_STEPS", std::to_string(tierSettings.max_steps) },
+				{ "TIER_MAX_TOTAL_REFLECTIONS", std::to_string(tierSettings.max_total_reflections) },
+				{ "TIER_REFRACTION", tierSettings.refraction ? "1" : "0" },
+				{ "TIER_MAX_DIFFUSE_BOUNCES", std::to_string(tierSettings.max_diffuse_bounces) },
+				{ "TIER_ROULETTE_DEPTH", std::to_string(tierSettings.roulette_depth) }
+			};
+		}
+		tiers[i].screenQuadFS = new Shader(device, "screenQuad.frag", macros);
+		tiers[i].traceCS = new Shader(device, "trace.comp", macros);
+		shaders.push_back(tiers[i].screenQuadFS);
+		shaders.push_back(tiers[i].traceCS);
+		for (int kernel = 0; kernel < WAVEFRONT_KERNEL_COUNT; ++kernel) {
+			ShaderMacros kernelMacros = macros;
+			kernelMacros.push_back({ "WAVEFRONT_KERNEL", std::to_string(kernel) });
+			tiers[i].wavefrontCS[kernel] = new Shader(device, "wavefront.comp", kernelMacros);
+			shaders.push_back(tiers[i].wavefrontCS[kernel]);
 		}
 	}
+	for (Shader* shader : shaders)
+		pendingShaders[shader] = shaderCompiler->submit(shader);
+
+	createFramebuffers();
 
 	VkCommandPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -540,6 +1115,8 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 		throw std::runtime_error("Failed to create Command Pool!");
 	}
 
+	profiler = new Profiler(device, physicalDevice, graphicsFamily, MAX_FRAMES_IN_FLIGHT);
+
 	commandBuffers.resize(MAX_FRAMES_IN_FLIGHT + 1);
 
 	VkCommandBufferAllocateInfo allocInfo{};
@@ -565,14 +1142,34 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 		vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
 	}
 
-	VkDescriptorPoolSize poolSize{};
-	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	// the mask of the blue noise sampler never changes
+	const std::vector<float>& blueNoiseMask = getBlueNoiseMask();
+	const VkDeviceSize blueNoiseSize = blueNoiseMask.size() * sizeof(float);
+	createBuffer(blueNoiseSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, blueNoiseBuffer, blueNoiseBufferMemory);
+	void* blueNoiseData;
+	vkMapMemory(device, blueNoiseBufferMemory, 0, blueNoiseSize, 0, &blueNoiseData);
+	memcpy(blueNoiseData, blueNoiseMask.data(), blueNoiseSize);
+	vkUnmapMemory(device, blueNoiseBufferMemory);
+
+	// running average of all frames since the last reset, and the last two shown frames for interleaved tracing
+	createStorageImage(1, accumulationImage, accumulationImageMemory, accumulationImageView);
+	createStorageImage(2, historyImage, historyImageMemory, historyImageView);
+	// first hits of the traced pixels and the two layers the denoise passes take turns on
+	createStorageImage(1, surfacesImage, surfacesImageMemory, surfacesImageView);
+	createStorageImage(2, denoisedImage, denoisedImageMemory, denoisedImageView);
+
+	VkDescriptorPoolSize poolSizes[3]{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 4;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 4;
 
 	VkDescriptorPoolCreateInfo desPoolInfo{};
 	desPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	desPoolInfo.poolSizeCount = 1;
-	desPoolInfo.pPoolSizes = &poolSize;
+	desPoolInfo.poolSizeCount = 3;
+	desPoolInfo.pPoolSizes = poolSizes;
 	desPoolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 
 	if (vkCreateDescriptorPool(device, &desPoolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
@@ -609,8 +1206,55 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 		descriptorWrite.pImageInfo = nullptr; // Optional
 		descriptorWrite.pTexelBufferView = nullptr; // Optional
 		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+
+		VkDescriptorBufferInfo blueNoiseInfo{};
+		blueNoiseInfo.buffer = blueNoiseBuffer;
+		blueNoiseInfo.offset = 0;
+		blueNoiseInfo.range = VK_WHOLE_SIZE;
+		VkWriteDescriptorSet blueNoiseWrite = descriptorWrite;
+		blueNoiseWrite.dstBinding = 6;
+		blueNoiseWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		blueNoiseWrite.pBufferInfo = &blueNoiseInfo;
+		vkUpdateDescriptorSets(device, 1, &blueNoiseWrite, 0, nullptr);
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageView = accumulationImageView;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkWriteDescriptorSet imageWrite{};
+		imageWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		imageWrite.dstSet = descriptorSets[i];
+		imageWrite.dstBinding = 2;
+		imageWrite.dstArrayElement = 0;
+		imageWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		imageWrite.descriptorCount = 1;
+		imageWrite.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(device, 1, &imageWrite, 0, nullptr);
+
+		VkDescriptorImageInfo historyInfo = imageInfo;
+		historyInfo.imageView = historyImageView;
+		VkWriteDescriptorSet historyWrite = imageWrite;
+		historyWrite.dstBinding = 3;
+		historyWrite.pImageInfo = &historyInfo;
+		vkUpdateDescriptorSets(device, 1, &historyWrite, 0, nullptr);
+
+		VkDescriptorImageInfo surfacesInfo = imageInfo;
+		surfacesInfo.imageView = surfacesImageView;
+		VkWriteDescriptorSet surfacesWrite = imageWrite;
+		surfacesWrite.dstBinding = 4;
+		surfacesWrite.pImageInfo = &surfacesInfo;
+		vkUpdateDescriptorSets(device, 1, &surfacesWrite, 0, nullptr);
+
+		VkDescriptorImageInfo denoisedInfo = imageInfo;
+		denoisedInfo.imageView = denoisedImageView;
+		VkWriteDescriptorSet denoisedWrite = imageWrite;
+		denoisedWrite.dstBinding = 5;
+		denoisedWrite.pImageInfo = &denoisedInfo;
+		vkUpdateDescriptorSets(device, 1, &denoisedWrite, 0, nullptr);
 	}
 
+	setVoxelWorld(VoxelWorld::createDefaultScene());
+
 	// Create synchronization Objects
 	imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 	renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
@@ -631,11 +1275,277 @@ Renderer::Renderer(GLFWwindow* window) : window(window)
 		}
 	}
 
-	initImGui();
+	if (headless) {
+		// host visible buffers the offscreen image gets copied into, one per frame in flight
+		const VkDeviceSize readbackSize = VkDeviceSize(swapChainExtent.width) * swapChainExtent.height * 4;
+		readbackBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+		readbackBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+		readbackBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+		readbackPending.resize(MAX_FRAMES_IN_FLIGHT, false);
+
+		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			createBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readbackBuffers[i], readbackBuffersMemory[i]);
+
+			vkMapMemory(device, readbackBuffersMemory[i], 0, readbackSize, 0, &readbackBuffersMapped[i]);
+		}
+	}
+	else {
+		initImGui();
+	}
 
 	std::cout << "Renderer setup complete!" << std::endl;
 }
 
+void Renderer::setVoxelWorld(const VoxelWorld& world)
+{
+	const VkDeviceSize size = world.getGpuSize();
+	createVoxelBuffer(size, size, [&world](void* data) { world.writeGpuData(data); });
+	streamer = nullptr;
+	editedWorld = nullptr;
+	destroyVoxelUploadBuffers();
+
+	std::cout << "Uploaded voxel world: " << world.getBrickCount() << " bricks, " << size / 1024 << " KiB" << std::endl;
+}
+
+void Renderer::setVoxelFile(const VoxelFile& file)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const VkDeviceSize size = file.getGpuSize();
+	createVoxelBuffer(size, size, [&file](void* data) { file.writeGpuData(data); });
+	streamer = nullptr;
+	editedWorld = nullptr;
+	destroyVoxelUploadBuffers();
+
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Uploaded voxel file: " << file.getBrickCount() << " bricks, " << file.getFileSize() / 1024 << " KiB on disk, "
+		<< size / 1024 << " KiB on the GPU in " << ms << " ms" << std::endl;
+}
+
+void Renderer::setVoxelStreamer(VoxelStreamer* voxelStreamer)
+{
+	// the pool is only read through the tables, it can start out undefined
+	createVoxelBuffer(voxelStreamer->getGpuSize(), voxelStreamer->getTableSize(), [voxelStreamer](void* data) { voxelStreamer->writeTables(data); });
+	streamer = voxelStreamer;
+	editedWorld = nullptr;
+	// enough for a few chunks per frame, and always for the largest possible one
+	createVoxelUploadBuffers(std::max<VkDeviceSize>(16 << 20, streamer->getMinUploadBudget()));
+
+	std::cout << "Streaming voxel world: " << streamer->getPoolCapacity() << " pool bricks, " << streamer->getGpuSize() / (1024 * 1024) << " MiB" << std::endl;
+}
+
+void Renderer::setEditableVoxelWorld(VoxelWorld* world)
+{
+	// room for the bricks edits add, a world that outgrows it is uploaded anew
+	const VkDeviceSize size = world->getGpuSize();
+	createVoxelBuffer(size + std::max<VkDeviceSize>(size / 4, 1024 * BRICK_VOXELS), size, [world](void* data) { world->writeGpuData(data); });
+	world->clearEdits();
+	streamer = nullptr;
+	editedWorld = world;
+	// about 32k edited bricks per frame, more wait for the next one
+	createVoxelUploadBuffers(16 << 20);
+
+	std::cout << "Uploaded editable voxel world: " << world->getBrickCount() << " bricks, " << size / 1024 << " KiB, room for "
+		<< (voxelBufferSize - size) / BRICK_VOXELS << " more" << std::endl;
+}
+
+void Renderer::createVoxelBuffer(VkDeviceSize size, VkDeviceSize uploadSize, const std::function<void(void*)>& fill)
+{
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(uploadSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, uploadSize, 0, &data);
+	// a scene that fails to decode leaves the current one in place
+	try {
+		fill(data);
+	}
+	catch (...) {
+		vkUnmapMemory(device, stagingBufferMemory);
+		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		vkFreeMemory(device, stagingBufferMemory, nullptr);
+		throw;
+	}
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	vkDeviceWaitIdle(device);
+	if (voxelBuffer != VK_NULL_HANDLE) {
+		vkDestroyBuffer(device, voxelBuffer, nullptr);
+		vkFreeMemory(device, voxelBufferMemory, nullptr);
+	}
+
+	createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, voxelBuffer, voxelBufferMemory);
+	voxelBufferSize = size;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(commandBuffers[MAX_FRAMES_IN_FLIGHT], &beginInfo);
+	VkBufferCopy region{};
+	region.size = uploadSize;
+	vkCmdCopyBuffer(commandBuffers[MAX_FRAMES_IN_FLIGHT], stagingBuffer, voxelBuffer, 1, &region);
+	vkEndCommandBuffer(commandBuffers[MAX_FRAMES_IN_FLIGHT]);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffers[MAX_FRAMES_IN_FLIGHT];
+
+	vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	vkQueueWaitIdle(graphicsQueue);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = voxelBuffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = descriptorSets[i];
+		descriptorWrite.dstBinding = 1;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	resetAccumulation();
+	historyValid = false;
+}
+
+void Renderer::createVoxelUploadBuffers(VkDeviceSize sliceSize)
+{
+	if (!voxelUploadBuffers.empty() && voxelUploadSliceSize >= sliceSize)
+		return;
+	destroyVoxelUploadBuffers();
+
+	voxelUploadSliceSize = sliceSize;
+	voxelUploadBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	voxelUploadBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	voxelUploadBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+	voxelUploadCopies.resize(MAX_FRAMES_IN_FLIGHT);
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		createBuffer(sliceSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, voxelUploadBuffers[i], voxelUploadBuffersMemory[i]);
+		vkMapMemory(device, voxelUploadBuffersMemory[i], 0, sliceSize, 0, &voxelUploadBuffersMapped[i]);
+	}
+}
+
+void Renderer::destroyVoxelUploadBuffers()
+{
+	for (size_t i = 0; i < voxelUploadBuffers.size(); i++) {
+		vkUnmapMemory(device, voxelUploadBuffersMemory[i]);
+		vkDestroyBuffer(device, voxelUploadBuffers[i], nullptr);
+		vkFreeMemory(device, voxelUploadBuffersMemory[i], nullptr);
+	}
+	voxelUploadBuffers.clear();
+	voxelUploadBuffersMemory.clear();
+	voxelUploadBuffersMapped.clear();
+	voxelUploadCopies.clear();
+}
+
+void Renderer::stageVoxelUpload(size_t offset, const void* data, size_t size)
+{
+	std::vector<VkBufferCopy>& copies = voxelUploadCopies[currentFrame];
+	const VkDeviceSize staged = copies.empty() ? 0 : copies.back().srcOffset + copies.back().size;
+	if (staged + size > voxelUploadSliceSize)
+		throw std::runtime_error("Voxel upload exceeds its staging slice!");
+	memcpy(static_cast<uint8_t*>(voxelUploadBuffersMapped[currentFrame]) + staged, data, size);
+	copies.push_back(VkBufferCopy{ staged, VkDeviceSize(offset), VkDeviceSize(size) });
+}
+
+void Renderer::updateStream()
+{
+	const bool changed = streamer->update(camera->pos, size_t(voxelUploadSliceSize), [this](size_t offset, const void* data, size_t size) {
+		stageVoxelUpload(offset, data, size);
+	});
+
+	// the world looks different, neither the accumulation nor the history match it
+	if (changed) {
+		resetAccumulation();
+		historyValid = false;
+	}
+}
+
+void Renderer::updateEdits()
+{
+	// compact() moved the bricks around or the edits added more than the buffer has room for
+	if (editedWorld->needsFullUpload() || editedWorld->getGpuSize() > voxelBufferSize) {
+		setEditableVoxelWorld(editedWorld);
+		return;
+	}
+
+	glm::ivec3 boundsMin, boundsMax;
+	editedBricks = editedWorld->flushEdits(size_t(voxelUploadSliceSize), [this](size_t offset, const void* data, size_t size) {
+		stageVoxelUpload(offset, data, size);
+	}, boundsMin, boundsMax);
+	if (editedBricks > 0)
+		resetRegion(boundsMin, boundsMax);
+}
+
+void Renderer::resetRegion(glm::ivec3 min, glm::ivec3 max)
+{
+	// the reprojected pixels of interleaving would bring back the old voxels
+	historyValid = false;
+	if (accumulatedFrames == 0)
+		return;
+
+	// shadows and bounced light change around the voxels as well, and refraction or far bounces beyond
+	// that: those pixels average the old and the new look until the full reset EDIT_SETTLE_FRAMES later
+	const int margin = BRICK_SIZE;
+	const glm::vec3 low = glm::vec3(min - margin), high = glm::vec3(max + margin);
+	const glm::vec2 screen(renderExtent.width, renderExtent.height);
+	const glm::mat4 viewProj = camera->proj * camera->view;
+	glm::vec2 first(std::numeric_limits<float>::max()), last(std::numeric_limits<float>::lowest());
+	for (int i = 0; i < 8; ++i) {
+		const glm::vec4 clip = viewProj * glm::vec4(i & 1 ? high.x : low.x, i & 2 ? high.y : low.y, i & 4 ? high.z : low.z, 1.0f);
+		if (clip.w <= 0.0f) {
+			// reaches behind the camera, the projection says nothing
+			resetAccumulation();
+			return;
+		}
+		const glm::vec2 pixel = glm::vec2(clip.x / clip.w + 1.0f, 1.0f - clip.y / clip.w) * 0.5f * screen;
+		first = glm::min(first, pixel);
+		last = glm::max(last, pixel);
+	}
+
+	glm::ivec4 rect(glm::max(glm::ivec2(glm::floor(first)) - 1, glm::ivec2(0)), glm::min(glm::ivec2(glm::ceil(last)) + 1, glm::ivec2(screen)));
+	if (rect.x >= rect.z || rect.y >= rect.w)
+		return; // off screen
+	if (resetRect.x < resetRect.z)
+		rect = glm::ivec4(glm::min(glm::ivec2(rect), glm::ivec2(resetRect)), glm::max(glm::ivec2(rect.z, rect.w), glm::ivec2(resetRect.z, resetRect.w)));
+	// most of the image would start over anyway
+	if (uint64_t(rect.z - rect.x) * uint64_t(rect.w - rect.y) * 2 > uint64_t(renderExtent.width) * renderExtent.height) {
+		resetAccumulation();
+		return;
+	}
+	resetRect = rect;
+	resetFrames = 0;
+}
+
+void Renderer::copyVoxelUploads()
+{
+	const std::vector<VkBufferCopy>& copies = voxelUploadCopies[currentFrame];
+	if (copies.empty())
+		return;
+
+	// the frames before may still be tracing with the old contents
+	const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	vkCmdPipelineBarrier(commandBuffers[currentFrame], shaderStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	vkCmdCopyBuffer(commandBuffers[currentFrame], voxelUploadBuffers[currentFrame], voxelBuffer, uint32_t(copies.size()), copies.data());
+
+	VkMemoryBarrier uploadBarrier{};
+	uploadBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	uploadBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffers[currentFrame], VK_PIPELINE_STAGE_TRANSFER_BIT, shaderStages, 0, 1, &uploadBarrier, 0, nullptr, 0, nullptr);
+}
+
 void Renderer::initImGui() {
 	//1: create descriptor pool for IMGUI
 	// the size of the pool is very oversize, but it's copied from imgui demo itself.
@@ -677,8 +1587,9 @@ void Renderer::initImGui() {
 	init_info.Device = device;
 	init_info.Queue = graphicsQueue;
 	init_info.DescriptorPool = imguiPool;
-	init_info.MinImageCount = 3;
-	init_info.ImageCount = 3;
+	// the backend cycles through ImageCount vertex buffers, one per frame that can be in flight
+	init_info.MinImageCount = 2;
+	init_info.ImageCount = MAX_FRAMES_IN_FLIGHT;
 	init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 
 	ImGui_ImplVulkan_Init(&init_info, renderPass);
@@ -710,20 +1621,94 @@ void Renderer::initImGui() {
 
 Renderer::~Renderer()
 {
+	// hand out the frames that are still in flight before anything gets destroyed
+	if (headless)
+		finish();
+	vkDeviceWaitIdle(device);
+
+	// the compile threads still use the shaders, modules that finished go to their shader to be destroyed with it
+	for (auto& [shader, module] : pendingShaders) {
+		try {
+			shader->setModule(module.get());
+		}
+		catch (const std::runtime_error&) {
+		}
+	}
+	pendingShaders.clear();
+	delete shaderCompiler;
+	destroyRetiredPipelines(true);
+	savePipelineCache();
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
 		vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
 		vkDestroyFence(device, inFlightFences[i], nullptr);
 	}
 
-	vkDestroyDescriptorPool(device, imguiPool, nullptr);
-	ImGui_ImplVulkan_Shutdown();
+	for (size_t i = 0; i < captureBuffers.size(); i++) {
+		vkUnmapMemory(device, captureBuffersMemory[i]);
+		vkDestroyBuffer(device, captureBuffers[i], nullptr);
+		vkFreeMemory(device, captureBuffersMemory[i], nullptr);
+	}
+	vkDestroyImageView(device, captureImageView, nullptr);
+	vkDestroyImage(device, captureImage, nullptr);
+	vkFreeMemory(device, captureImageMemory, nullptr);
+
+	if (headless) {
+		for (size_t i = 0; i < readbackBuffers.size(); i++) {
+			vkUnmapMemory(device, readbackBuffersMemory[i]);
+			vkDestroyBuffer(device, readbackBuffers[i], nullptr);
+			vkFreeMemory(device, readbackBuffersMemory[i], nullptr);
+		}
+	}
+	else {
+		vkDestroyDescriptorPool(device, imguiPool, nullptr);
+		ImGui_ImplVulkan_Shutdown();
+	}
+
+	for (size_t i = 0; i < uniformBuffers.size(); i++) {
+		vkDestroyBuffer(device, uniformBuffers[i], nullptr);
+		vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+	}
+	vkDestroyBuffer(device, blueNoiseBuffer, nullptr);
+	vkFreeMemory(device, blueNoiseBufferMemory, nullptr);
+	vkDestroyBuffer(device, wavefrontPathBuffer, nullptr);
+	vkFreeMemory(device, wavefrontPathBufferMemory, nullptr);
+	vkDestroyBuffer(device, wavefrontQueueBuffer, nullptr);
+	vkFreeMemory(device, wavefrontQueueBufferMemory, nullptr);
+	if (wavefrontStatsMapped)
+		vkUnmapMemory(device, wavefrontStatsBufferMemory);
+	vkDestroyBuffer(device, wavefrontStatsBuffer, nullptr);
+	vkFreeMemory(device, wavefrontStatsBufferMemory, nullptr);
+	vkDestroyBuffer(device, voxelBuffer, nullptr);
+	vkFreeMemory(device, voxelBufferMemory, nullptr);
+	destroyVoxelUploadBuffers();
+	vkDestroyImageView(device, accumulationImageView, nullptr);
+	vkDestroyImage(device, accumulationImage, nullptr);
+	vkFreeMemory(device, accumulationImageMemory, nullptr);
+	vkDestroyImageView(device, historyImageView, nullptr);
+	vkDestroyImage(device, historyImage, nullptr);
+	vkFreeMemory(device, historyImageMemory, nullptr);
+	vkDestroyImageView(device, surfacesImageView, nullptr);
+	vkDestroyImage(device, surfacesImage, nullptr);
+	vkFreeMemory(device, surfacesImageMemory, nullptr);
+	vkDestroyImageView(device, denoisedImageView, nullptr);
+	vkDestroyImage(device, denoisedImage, nullptr);
+	vkFreeMemory(device, denoisedImageMemory, nullptr);
 
 	vkDestroyCommandPool(device, commandPool, nullptr);
 	for (auto framebuffer : swapChainFramebuffers) {
 		vkDestroyFramebuffer(device, framebuffer, nullptr);
 	}
-	vkDestroyPipeline(device, graphicsPipeline, nullptr);
+	for (TierVariant& tier : tiers) {
+		vkDestroyPipeline(device, tier.graphicsPipeline, nullptr);
+		vkDestroyPipeline(device, tier.tracePipeline, nullptr);
+		for (VkPipeline pipeline : tier.wavefrontPipelines)
+			vkDestroyPipeline(device, pipeline, nullptr);
+	}
+	vkDestroyPipeline(device, presentPipeline, nullptr);
+	vkDestroyPipeline(device, denoisePipeline, nullptr);
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
 	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
@@ -734,45 +1719,161 @@ Renderer::~Renderer()
 		vkDestroyImageView(device, imageView, nullptr);
 	}
 
-	vkDestroySwapchainKHR(device, swapChain, nullptr);
-
-	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+	if (headless) {
+		vkDestroyImage(device, offscreenImage, nullptr);
+		vkFreeMemory(device, offscreenImageMemory, nullptr);
+	}
+	else {
+		vkDestroySwapchainKHR(device, swapChain, nullptr);
+	}
 
-	delete screenQuadFS;
+	for (TierVariant& tier : tiers) {
+		delete tier.traceCS;
+		delete tier.screenQuadFS;
+		for (Shader* shader : tier.wavefrontCS)
+			delete shader;
+	}
+	delete presentFS;
+	delete denoiseCS;
 	delete screenQuadVS;
+	delete profiler;
 
 	vkDestroyDevice(device, nullptr);
-	vkDestroySurfaceKHR(instance, surface, nullptr);
+	if (!headless)
+		vkDestroySurfaceKHR(instance, surface, nullptr);
 	vkDestroyInstance(instance, nullptr);
-
-	vkDeviceWaitIdle(device);
 };
 
-static int max_steps = 200;
-static int max_samples = 4;
-static int max_total_reflections = 9;
+static const char* tracePathNames[] = { "Fragment", "Compute", "Wavefront" };
+static const char* interleaveNames[] = { "Off", "Checkerboard", "1 in 4" };
+static const glm::uvec2 workgroupPresets[] = { { 8, 4 }, { 8, 8 }, { 16, 8 }, { 16, 16 }, { 32, 4 }, { 32, 8 } };
 
 void Renderer::render()
 {
+	// the GUI can not change these while it is being recorded
+	if (requestedFramesInFlight != 0) {
+		setFramesInFlight(requestedFramesInFlight);
+		requestedFramesInFlight = 0;
+	}
+	if (requestedPresentMode != VK_PRESENT_MODE_MAX_ENUM_KHR) {
+		setPresentMode(requestedPresentMode);
+		requestedPresentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+	}
+	if (requestedWorkgroupSize.x != 0) {
+		try {
+			setWorkgroupSize(requestedWorkgroupSize.x, requestedWorkgroupSize.y);
+		}
+		catch (const std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
+		}
+		requestedWorkgroupSize = glm::uvec2(0);
+	}
+
+	profiler->beginFrame();
+	Profiler::Clock::time_point sectionStart = Profiler::Clock::now();
+
 	vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+	profiler->addCpuTime(CpuSection::WAIT, sectionStart, Profiler::Clock::now());
+	++frameNumber;
+	destroyRetiredPipelines();
+
+	// the frame that used this slot before is done, hand its pixels and timestamps out; a new scale would
+	// restart the accumulation, so it stays put while the camera rests and resumes on the next move or setting change
+	const bool resting = accumulate && camera->view == accumulationView && camera->proj == accumulationProj
+		&& tracesSameImage(getTraceSettings(), accumulationSettings);
+	if (profiler->collectGpuTimes(currentFrame) && adaptiveResolution && !resting)
+		scaleController.update(profiler->getLatestGpuTime(GpuSection::TRACE));
+	collectWavefrontStats(currentFrame);
+	if (headless)
+		deliverFrame(currentFrame);
+	deliverCapture(currentFrame);
+	if (streamer || editedWorld) {
+		// the fence of this slot has signaled, its staging slice is free again
+		const Profiler::Clock::time_point streamStart = Profiler::Clock::now();
+		voxelUploadCopies[currentFrame].clear();
+		if (streamer)
+			updateStream();
+		else
+			updateEdits();
+		profiler->addCpuTime(CpuSection::STREAM, streamStart, Profiler::Clock::now());
+	}
+	updateRenderExtent();
+	preparePipelines();
+
+	sectionStart = Profiler::Clock::now();
+
+	// start over whenever the image would change
+	const TraceSettings& traceSettings = getTraceSettings();
+	const glm::uvec2 extent(renderExtent.width, renderExtent.height);
+	const bool cameraMoved = camera->view != accumulationView || camera->proj != accumulationProj;
+	// the wavefront path starts over with an estimate of its rounds for new settings, more rounds bring back paths
+	// it cut short before
+	if (tracePath != TracePath::WAVEFRONT)
+		wavefrontRounds = 0;
+	else if (wavefrontRounds == 0 || !tracesSameImage(traceSettings, accumulationSettings))
+		wavefrontRounds = estimateWavefrontRounds(traceSettings);
+	const bool imageChanged = !tracesSameImage(traceSettings, accumulationSettings) || extent != accumulationExtent
+		|| wavefrontRounds != accumulationRounds;
+	// interleaving needs the previous frame in the history; a resting camera gets every pixel traced, so the
+	// accumulation starts over once without the reprojected pixels of the last interleaved frame
+	const bool interleaved = interleave > 1 && historyValid && !imageChanged && (!accumulate || cameraMoved);
+	// edits only restart the pixels around them while they go on, once they settled everything does
+	const bool editSettled = resetRect.x < resetRect.z && resetFrames >= EDIT_SETTLE_FRAMES;
+	if (!accumulate || cameraMoved || imageChanged || (lastFrameInterleaved && !interleaved) || editSettled)
+		resetAccumulation();
+	// the denoiser gets the frames before through the history while nothing accumulates
+	const bool denoiseHistory = denoisePasses > 0 && historyValid && !imageChanged && accumulatedFrames == 0;
+	const glm::mat4 previousView = accumulationView;
+	const glm::mat4 previousProj = accumulationProj;
+	accumulationView = camera->view;
+	accumulationProj = camera->proj;
+	accumulationSettings = traceSettings;
+	accumulationExtent = extent;
+	accumulationRounds = wavefrontRounds;
 
 	UniformBufferObject ubo{};
-	int32_t time = static_cast<int32_t>(duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
-	ubo.time = time;
-	ubo.max_samples = max_samples;
-	ubo.max_steps = max_steps;
-	ubo.max_total_reflections = max_total_reflections;
-	ubo.screen = glm::ivec2(swapChainExtent.width, swapChainExtent.height);
+	// the frames count up from settings.time, an accumulation keeps drawing from the sequence of its first frame
+	const uint32_t frameSeed = uint32_t(settings.time) + seedFrame++;
+	if (accumulatedFrames == 0)
+		sampleSeed = frameSeed;
+	ubo.sample_seed = sampleSeed;
+	ubo.sampler_type = int(samplerType);
+	ubo.accumulated_frames = int(accumulatedFrames);
+	ubo.max_samples = traceSettings.max_samples;
+	ubo.max_steps = traceSettings.max_steps;
+	ubo.max_total_reflections = traceSettings.max_total_reflections;
+	ubo.max_diffuse_bounces = traceSettings.max_diffuse_bounces;
+	ubo.roulette_depth = traceSettings.roulette_depth;
+	ubo.refraction = traceSettings.refraction;
+	ubo.screen = glm::ivec2(renderExtent.width, renderExtent.height);
+	ubo.display = glm::ivec2(swapChainExtent.width, swapChainExtent.height);
+	ubo.interleave = interleave > 1 || denoisePasses > 0 ? (interleaved ? int(interleave) : 1) : 0;
+	ubo.interleave_phase = int(interleaveFrame++ % interleave);
+	ubo.history_layer = int(frameNumber & 1);
 	ubo.pos = camera->pos;
 	ubo.view = camera->view;
 	ubo.proj = camera->proj;
+	ubo.prev_view = previousView;
+	ubo.prev_proj = previousProj;
+	ubo.reset_rect = resetRect;
+	ubo.reset_frames = int(resetFrames);
+	ubo.denoise_passes = int(denoisePasses);
+	ubo.denoise_strength = denoiseStrength;
+	ubo.denoise_history = denoiseHistory ? 1 : 0;
 	memcpy(uniformBuffersMapped[currentFrame], &ubo, sizeof(ubo));
+	historyValid = interleave > 1 || denoisePasses > 0;
+	lastFrameInterleaved = interleaved;
+	profiler->addCpuTime(CpuSection::UBO_UPLOAD, sectionStart, Profiler::Clock::now());
 
+	sectionStart = Profiler::Clock::now();
 	vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
-	uint32_t imageIndex;
-	vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+	uint32_t imageIndex = 0; // the offscreen target only has one image
+	if (!headless)
+		vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+	profiler->addCpuTime(CpuSection::WAIT, sectionStart, Profiler::Clock::now());
 
+	sectionStart = Profiler::Clock::now();
 	vkResetCommandBuffer(commandBuffers[currentFrame], 0);
 
 	VkCommandBufferBeginInfo beginInfo{};
@@ -784,30 +1885,49 @@ void Renderer::render()
 		throw std::runtime_error("Failed to begin recording Command Buffer!");
 	}
 
+	profiler->resetQueries(commandBuffers[currentFrame], currentFrame);
+	if (streamer || editedWorld)
+		copyVoxelUploads();
 	drawScreenQuad(imageIndex);
 
+	if (headless && frameCallback) // frames nobody takes are not copied back
+		copyFrameToReadback();
+	if (captureCallback)
+		copyTraceToCapture();
+
 	if (vkEndCommandBuffer(commandBuffers[currentFrame]) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to record Command Buffer!");
 	}
+	profiler->addCpuTime(CpuSection::RECORD, sectionStart, Profiler::Clock::now());
 
+	sectionStart = Profiler::Clock::now();
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	
 	VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
 	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.waitSemaphoreCount = headless ? 0 : 1;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
 	VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.signalSemaphoreCount = headless ? 0 : 1;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
 	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to submit draw Command Buffer!");
 	}
+	++accumulatedFrames;
+	++resetFrames;
+
+	if (headless) {
+		profiler->addCpuTime(CpuSection::SUBMIT_PRESENT, sectionStart, Profiler::Clock::now());
+		readbackPending[currentFrame] = bool(frameCallback);
+		currentFrame = (currentFrame + 1) % framesInFlight;
+		return;
+	}
 
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -821,8 +1941,158 @@ void Renderer::render()
 	presentInfo.pResults = nullptr; // Optional
 
 	vkQueuePresentKHR(presentQueue, &presentInfo);
+	profiler->addCpuTime(CpuSection::SUBMIT_PRESENT, sectionStart, Profiler::Clock::now());
+
+	currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+void Renderer::finish()
+{
+	// frames retire in submission order, starting with the oldest slot
+	for (uint32_t i = 0; i < framesInFlight; i++) {
+		const uint32_t frame = (currentFrame + i) % framesInFlight;
+		vkWaitForFences(device, 1, &inFlightFences[frame], VK_TRUE, UINT64_MAX);
+		profiler->collectGpuTimes(frame);
+		collectWavefrontStats(frame);
+		if (headless)
+			deliverFrame(frame);
+		deliverCapture(frame);
+	}
+}
+
+void Renderer::setCaptureCallback(CaptureCallback callback)
+{
+	captureCallback = callback;
+	if (!captureCallback || !captureBuffers.empty())
+		return;
+
+	// frames are captured at the output size, a changing render scale would break image sequences and raw streams
+	createStorageImage(1, captureImage, captureImageMemory, captureImageView);
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R32G32B32A32_SFLOAT, &formatProperties);
+	// bilinear like the present pass where the device filters rgba32f, the nearest pixel otherwise
+	captureFilter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+	const VkDeviceSize captureSize = VkDeviceSize(swapChainExtent.width) * swapChainExtent.height * 4 * sizeof(float);
+	captureBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	captureBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	captureBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+	captureExtents.resize(MAX_FRAMES_IN_FLIGHT, VkExtent2D{ 0, 0 });
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		// cached memory where available, the host reads every byte of it
+		const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		try {
+			createBuffer(captureSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostVisible | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, captureBuffers[i], captureBuffersMemory[i]);
+		}
+		catch (const std::runtime_error&) {
+			vkDestroyBuffer(device, captureBuffers[i], nullptr);
+			createBuffer(captureSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostVisible, captureBuffers[i], captureBuffersMemory[i]);
+		}
 
-	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		vkMapMemory(device, captureBuffersMemory[i], 0, captureSize, 0, &captureBuffersMapped[i]);
+	}
+}
+
+void Renderer::deliverCapture(uint32_t frame)
+{
+	if (captureExtents.empty() || captureExtents[frame].width == 0)
+		return;
+
+	const VkExtent2D extent = captureExtents[frame];
+	captureExtents[frame] = { 0, 0 };
+	if (captureCallback)
+		captureCallback(static_cast<const float*>(captureBuffersMapped[frame]), extent.width, extent.height);
+}
+
+void Renderer::copyTraceToCapture()
+{
+	// the trace (or the denoiser) wrote the image in a shader, it stays in the general layout
+	VkMemoryBarrier traceBarrier{};
+	traceBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	traceBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	traceBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	vkCmdPipelineBarrier(commandBuffers[currentFrame], shaderStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &traceBarrier, 0, nullptr, 0, nullptr);
+
+	// the image that is shown
+	VkImage image = denoisePasses > 0 ? denoisedImage : accumulationImage;
+	uint32_t layer = denoisePasses > 0 ? (denoisePasses - 1) & 1 : 0;
+	if (renderExtent.width != swapChainExtent.width || renderExtent.height != swapChainExtent.height) {
+		// scaled to the output size the way the present pass shows it, pixel centers line up and the edges clamp
+		VkImageBlit blit{};
+		blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, layer, 1 };
+		blit.srcOffsets[1] = { int32_t(renderExtent.width), int32_t(renderExtent.height), 1 };
+		blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		blit.dstOffsets[1] = { int32_t(swapChainExtent.width), int32_t(swapChainExtent.height), 1 };
+		vkCmdBlitImage(commandBuffers[currentFrame], image, VK_IMAGE_LAYOUT_GENERAL, captureImage, VK_IMAGE_LAYOUT_GENERAL, 1, &blit, captureFilter);
+
+		VkMemoryBarrier blitBarrier{};
+		blitBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		blitBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		blitBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffers[currentFrame], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &blitBarrier, 0, nullptr, 0, nullptr);
+		image = captureImage;
+		layer = 0;
+	}
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0; // tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = layer;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { swapChainExtent.width, swapChainExtent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffers[currentFrame], image, VK_IMAGE_LAYOUT_GENERAL, captureBuffers[currentFrame], 1, &region);
+	captureExtents[currentFrame] = swapChainExtent;
+
+	// the next frame's trace must not overwrite the image before the copy read it, and the host sees the copy
+	// once the fence is signaled
+	vkCmdPipelineBarrier(commandBuffers[currentFrame], VK_PIPELINE_STAGE_TRANSFER_BIT, shaderStages, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	VkMemoryBarrier hostBarrier{};
+	hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffers[currentFrame], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+}
+
+void Renderer::deliverFrame(uint32_t frame)
+{
+	if (!readbackPending[frame])
+		return;
+
+	readbackPending[frame] = false;
+	if (frameCallback)
+		frameCallback(static_cast<const uint8_t*>(readbackBuffersMapped[frame]), swapChainExtent.width, swapChainExtent.height);
+}
+
+void Renderer::copyFrameToReadback()
+{
+	// the render pass left the offscreen image in TRANSFER_SRC_OPTIMAL
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0; // tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { swapChainExtent.width, swapChainExtent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffers[currentFrame], offscreenImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffers[currentFrame], 1, &region);
+
+	// make the copy visible to the host once the fence is signaled
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffers[currentFrame], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 }
 
 void Renderer::drawGUI(VkCommandBuffer commandbuffer) {
@@ -832,9 +2102,98 @@ void Renderer::drawGUI(VkCommandBuffer commandbuffer) {
 	ImGui::NewFrame();
 	//imgui commands
 	ImGui::Begin("Settings");
-	ImGui::SliderInt("Max Samples", &max_samples, 0, 10);
-	ImGui::SliderInt("Max Steps", &max_steps, 0, 1000);
-	ImGui::SliderInt("Max Total Reflections", &max_total_reflections, 0, 20);
+	if (ImGui::BeginCombo("Quality", getQualityTierInfo(qualityTier).name)) {
+		for (size_t i = 0; i < size_t(QualityTier::COUNT); ++i) {
+			if (ImGui::Selectable(getQualityTierInfo(QualityTier(i)).name, QualityTier(i) == qualityTier))
+				qualityTier = QualityTier(i);
+		}
+		ImGui::EndCombo();
+	}
+	// the other tiers have their settings compiled in
+	if (qualityTier == QualityTier::CUSTOM) {
+		ImGui::SliderInt("Max Samples", &settings.max_samples, 0, 10);
+		ImGui::SliderInt("Max Steps", &settings.max_steps, 0, 1000);
+		ImGui::SliderInt("Max Total Reflections", &settings.max_total_reflections, 0, 20);
+		ImGui::Checkbox("Refraction", &settings.refraction);
+		ImGui::SliderInt("Max Diffuse Bounces", &settings.max_diffuse_bounces, 0, 32);
+		ImGui::SliderInt("Roulette Depth", &settings.roulette_depth, 0, 16);
+	}
+	ImGui::Checkbox("Accumulate", &accumulate);
+	ImGui::Text("Accumulated Frames: %u", accumulatedFrames);
+
+	int path = int(tracePath);
+	if (ImGui::Combo("Trace Path", &path, tracePathNames, IM_ARRAYSIZE(tracePathNames)))
+		tracePath = TracePath(path);
+	if (tracePath == TracePath::COMPUTE) {
+		// applied by the next render(), the frame being recorded has the current pipeline bound
+		const glm::uvec2 shown = requestedWorkgroupSize.x != 0 ? requestedWorkgroupSize : workgroupSize;
+		const std::string current = std::to_string(shown.x) + "x" + std::to_string(shown.y);
+		if (ImGui::BeginCombo("Workgroup Size", current.c_str())) {
+			for (const glm::uvec2& preset : workgroupPresets) {
+				const std::string name = std::to_string(preset.x) + "x" + std::to_string(preset.y);
+				if (ImGui::Selectable(name.c_str(), preset == shown))
+					requestedWorkgroupSize = preset;
+			}
+			ImGui::EndCombo();
+		}
+	}
+	else if (tracePath == TracePath::WAVEFRONT)
+		ImGui::Text("Rounds: %d, paths cut short: %u", wavefrontRounds, wavefrontTruncatedPaths);
+
+	bool adaptive = adaptiveResolution;
+	float targetMs = scaleController.targetMs;
+	if (ImGui::Checkbox("Adaptive Resolution", &adaptive))
+		setAdaptiveResolution(adaptive, targetMs);
+	if (adaptiveResolution) {
+		if (ImGui::SliderFloat("Target GPU ms", &targetMs, 1.0f, 50.0f, "%.1f"))
+			setAdaptiveResolution(true, targetMs);
+	}
+	else {
+		float scale = scaleController.getScale();
+		if (ImGui::SliderFloat("Render Scale", &scale, scaleController.minScale, scaleController.maxScale, "%.2f"))
+			setRenderScale(scale);
+	}
+	ImGui::Text("Tracing %ux%u (%.0f%%)", renderExtent.width, renderExtent.height, scaleController.getScale() * 100.0f);
+
+	int interleaveIndex = interleave == 4 ? 2 : int(interleave) - 1;
+	if (ImGui::Combo("Interleave", &interleaveIndex, interleaveNames, IM_ARRAYSIZE(interleaveNames)))
+		setInterleave(interleaveIndex == 2 ? 4 : uint32_t(interleaveIndex) + 1);
+
+	if (ImGui::BeginCombo("Sampler", getSamplerName(samplerType))) {
+		for (size_t i = 0; i < size_t(SamplerType::COUNT); ++i) {
+			if (ImGui::Selectable(getSamplerName(SamplerType(i)), SamplerType(i) == samplerType))
+				setSampler(SamplerType(i));
+		}
+		ImGui::EndCombo();
+	}
+
+	int passes = int(denoisePasses);
+	if (ImGui::SliderInt("Denoise Passes", &passes, 0, int(MAX_DENOISE_PASSES)))
+		setDenoise(uint32_t(std::clamp(passes, 0, int(MAX_DENOISE_PASSES))), denoiseStrength);
+	if (denoisePasses > 0)
+		ImGui::SliderFloat("Denoise Strength", &denoiseStrength, 0.05f, 4.0f, "%.2f");
+
+	// applied by the next render(), both wait for the GPU
+	int frames = int(requestedFramesInFlight != 0 ? requestedFramesInFlight : framesInFlight);
+	if (ImGui::SliderInt("Frames In Flight", &frames, 1, int(MAX_FRAMES_IN_FLIGHT)))
+		requestedFramesInFlight = uint32_t(std::clamp(frames, 1, int(MAX_FRAMES_IN_FLIGHT)));
+	if (ImGui::BeginCombo("Present Mode", getPresentModeName(presentMode))) {
+		for (VkPresentModeKHR mode : getSupportedPresentModes()) {
+			if (ImGui::Selectable(getPresentModeName(mode), mode == presentMode))
+				requestedPresentMode = mode;
+		}
+		ImGui::EndCombo();
+	}
+	ImGui::Text("%.2f ms/frame", 1000.0f / ImGui::GetIO().Framerate);
+	if (streamer) {
+		const float brickMiB = float(BRICK_VOXELS) / (1024.0f * 1024.0f);
+		ImGui::Text("Streaming: %zu chunks resident, %zu loading", streamer->getResidentChunks(), streamer->getPendingLoads());
+		ImGui::Text("Brick pool: %.0f / %.0f MiB, %llu evictions", streamer->getPoolUsed() * brickMiB, streamer->getPoolCapacity() * brickMiB,
+			(unsigned long long)streamer->getEvictions());
+	}
+	if (editedWorld)
+		ImGui::Text("Edits: %zu bricks uploaded, %zu waiting", editedBricks, editedWorld->getEditedBricks());
+	profiler->drawGUI();
 	ImGui::End();
 
 	ImGui::Render();
@@ -842,7 +2201,9 @@ void Renderer::drawGUI(VkCommandBuffer commandbuffer) {
 	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandbuffer);
 }
 
-void Renderer::drawScreenQuad(uint32_t image_nr)
+// fullscreen triangle over the top left extent of the framebuffer in a render pass of its own,
+// the last pass of a frame also ends the trace timing and draws the GUI
+void Renderer::drawQuadPass(uint32_t image_nr, VkPipeline pipeline, VkExtent2D extent, bool lastPass)
 {
 	VkRenderPassBeginInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -856,30 +2217,337 @@ void Renderer::drawScreenQuad(uint32_t image_nr)
 
 	vkCmdBeginRenderPass(commandBuffers[currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-	vkCmdBindPipeline(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	vkCmdBindPipeline(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 	
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(swapChainExtent.width);
-	viewport.height = static_cast<float>(swapChainExtent.height);
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
 	vkCmdSetViewport(commandBuffers[currentFrame], 0, 1, &viewport);
 
 	VkRect2D scissor{};
 	scissor.offset = { 0, 0 };
-	scissor.extent = swapChainExtent;
+	scissor.extent = extent;
 	vkCmdSetScissor(commandBuffers[currentFrame], 0, 1, &scissor);
 
 	vkCmdBindDescriptorSets(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
 	vkCmdDraw(commandBuffers[currentFrame], 3, 1, 0, 0);
 
-	drawGUI(commandBuffers[currentFrame]);
+	if (lastPass) {
+		profiler->writeTimestamp(commandBuffers[currentFrame], currentFrame, GpuSection::TRACE, true);
+
+		// written without a GUI as well, the results of a frame are only available once all queries are
+		profiler->writeTimestamp(commandBuffers[currentFrame], currentFrame, GpuSection::GUI, false);
+		if (!headless)
+			drawGUI(commandBuffers[currentFrame]);
+		profiler->writeTimestamp(commandBuffers[currentFrame], currentFrame, GpuSection::GUI, true);
+	}
 
 	vkCmdEndRenderPass(commandBuffers[currentFrame]);
 }
 
+void Renderer::drawScreenQuad(uint32_t image_nr)
+{
+	const TierVariant& tier = tiers[size_t(qualityTier)];
+	profiler->writeTimestamp(commandBuffers[currentFrame], currentFrame, GpuSection::TRACE, false);
+
+	// the previous frame may still be writing the accumulation image
+	const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	VkMemoryBarrier accumulationBarrier{};
+	accumulationBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	accumulationBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	accumulationBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffers[currentFrame], shaderStages, shaderStages, 0, 1, &accumulationBarrier, 0, nullptr, 0, nullptr);
+
+	if (tracePath != TracePath::FRAGMENT) {
+		vkCmdBindDescriptorSets(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
+		if (tracePath == TracePath::COMPUTE) {
+			vkCmdBindPipeline(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_COMPUTE, tier.tracePipeline);
+			vkCmdDispatch(commandBuffers[currentFrame], (renderExtent.width + workgroupSize.x - 1) / workgroupSize.x, (renderExtent.height + workgroupSize.y - 1) / workgroupSize.y, 1);
+		}
+		else {
+			traceWavefront();
+		}
+
+		// present.frag reads what the dispatches wrote
+		VkMemoryBarrier traceBarrier{};
+		traceBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		traceBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		traceBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffers[currentFrame], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &traceBarrier, 0, nullptr, 0, nullptr);
+	}
+	else if (usesPresentPass()) {
+		// trace into the top left of the accumulation image, then scale it up over the whole image
+		drawQuadPass(image_nr, tier.graphicsPipeline, renderExtent, false);
+
+		VkMemoryBarrier traceBarrier{};
+		traceBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		traceBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		traceBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		const VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		vkCmdPipelineBarrier(commandBuffers[currentFrame], stages, stages, 0, 1, &traceBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	denoise();
+	drawQuadPass(image_nr, usesPresentPass() ? presentPipeline : tier.graphicsPipeline, swapChainExtent, true);
+}
+
+void Renderer::traceWavefront()
+{
+	const TierVariant& tier = tiers[size_t(qualityTier)];
+	const TraceSettings& traceSettings = getTraceSettings();
+	const VkCommandBuffer commandBuffer = commandBuffers[currentFrame];
+
+	const int32_t rounds = wavefrontRounds;
+	const uint32_t samples = uint32_t(std::max(traceSettings.max_samples, 1));
+	const uint32_t pixelsPerWave = std::max(wavefrontCapacity / samples, 1u);
+	const uint32_t pixelCount = renderExtent.width * renderExtent.height;
+
+	// WavefrontPass in wavefront.comp
+	struct {
+		int32_t mode;
+		uint32_t firstPixel;
+		uint32_t pixelCount;
+	} pass{};
+
+	// every kernel consumes the queues, and PREPARE the queue sizes, the kernel before wrote
+	VkMemoryBarrier kernelBarrier{};
+	kernelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	kernelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	kernelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	auto wait = [&]() {
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &kernelBarrier, 0, nullptr, 0, nullptr);
+	};
+	auto run = [&](WavefrontKernel kernel, int32_t mode) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, tier.wavefrontPipelines[kernel]);
+		pass.mode = mode;
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pass), &pass);
+	};
+	auto prepare = [&](int32_t mode) {
+		run(WAVEFRONT_PREPARE, mode);
+		vkCmdDispatch(commandBuffer, 1, 1, 1);
+		wait();
+	};
+	// the dispatch that PREPARE wrote for a queue
+	auto dispatchQueue = [&](int32_t queue) {
+		vkCmdDispatchIndirect(commandBuffer, wavefrontQueueBuffer, VkDeviceSize(queue) * 4 * sizeof(uint32_t));
+	};
+
+	// the last frame's copy of the truncated path count reads the header the first RESET clears
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+	for (pass.firstPixel = 0; pass.firstPixel < pixelCount; pass.firstPixel += pixelsPerWave) {
+		pass.pixelCount = std::min(pixelsPerWave, pixelCount - pass.firstPixel);
+		prepare(WAVEFRONT_PREPARE_RESET);
+		run(WAVEFRONT_GENERATE, 0);
+		vkCmdDispatch(commandBuffer, (pass.pixelCount * samples + 63) / 64, 1, 1);
+		wait();
+		prepare(WAVEFRONT_PREPARE_EXTENSION);
+
+		for (int32_t round = 0; round < rounds; ++round) {
+			run(WAVEFRONT_EXTEND, 0);
+			dispatchQueue(WAVEFRONT_QUEUE_EXTEND);
+			wait();
+			prepare(WAVEFRONT_PREPARE_SHADING);
+			// one material after the other, both append to the extension queue
+			run(WAVEFRONT_SHADE, WAVEFRONT_QUEUE_DIFFUSE);
+			dispatchQueue(WAVEFRONT_QUEUE_DIFFUSE);
+			run(WAVEFRONT_SHADE, WAVEFRONT_QUEUE_WATER);
+			dispatchQueue(WAVEFRONT_QUEUE_WATER);
+			wait();
+			prepare(WAVEFRONT_PREPARE_EXTENSION);
+		}
+
+		run(WAVEFRONT_RESOLVE, 0);
+		vkCmdDispatch(commandBuffer, (pass.pixelCount + 63) / 64, 1, 1);
+		// the next wave starts over with the path buffer
+		wait();
+	}
+
+	// RESOLVE counted the paths all waves cut short, the host reads them once the slot's fence signals
+	VkMemoryBarrier statsBarrier{};
+	statsBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	statsBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	statsBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &statsBarrier, 0, nullptr, 0, nullptr);
+	VkBufferCopy region{};
+	region.srcOffset = WAVEFRONT_TRUNCATED_OFFSET;
+	region.dstOffset = currentFrame * sizeof(uint32_t);
+	region.size = sizeof(uint32_t);
+	vkCmdCopyBuffer(commandBuffer, wavefrontQueueBuffer, wavefrontStatsBuffer, 1, &region);
+	statsBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	statsBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &statsBarrier, 0, nullptr, 0, nullptr);
+	wavefrontFrameRounds[currentFrame] = rounds;
+}
+
+void Renderer::collectWavefrontStats(uint32_t frame)
+{
+	const int32_t rounds = wavefrontFrameRounds[frame];
+	if (rounds == 0)
+		return;
+
+	wavefrontFrameRounds[frame] = 0;
+	wavefrontTruncatedPaths = wavefrontStatsMapped[frame];
+	// frames recorded before the last change report what the new rounds already address
+	const int32_t maxRounds = std::max(getTraceSettings().max_steps, 0) + 1;
+	if (wavefrontTruncatedPaths != 0 && rounds == wavefrontRounds && wavefrontRounds < maxRounds)
+		wavefrontRounds = std::min(wavefrontRounds * 2, maxRounds);
+}
+
+void Renderer::denoise()
+{
+	// written without denoising as well, the results of a frame are only available once all queries are
+	profiler->writeTimestamp(commandBuffers[currentFrame], currentFrame, GpuSection::DENOISE, false);
+	if (denoisePasses > 0) {
+		vkCmdBindPipeline(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_COMPUTE, denoisePipeline);
+		vkCmdBindDescriptorSets(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
+
+		// every pass reads what the trace or the pass before wrote, and overwrites a layer the last frame's present may still read
+		const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		VkMemoryBarrier passBarrier{};
+		passBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		passBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		passBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		for (int32_t pass = 0; pass < int32_t(denoisePasses); ++pass) {
+			vkCmdPipelineBarrier(commandBuffers[currentFrame], shaderStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &passBarrier, 0, nullptr, 0, nullptr);
+			vkCmdPushConstants(commandBuffers[currentFrame], pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pass), &pass);
+			vkCmdDispatch(commandBuffers[currentFrame], (renderExtent.width + 7) / 8, (renderExtent.height + 7) / 8, 1);
+		}
+
+		// present.frag reads the last pass
+		VkMemoryBarrier denoiseBarrier{};
+		denoiseBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		denoiseBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		denoiseBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffers[currentFrame], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &denoiseBarrier, 0, nullptr, 0, nullptr);
+	}
+	profiler->writeTimestamp(commandBuffers[currentFrame], currentFrame, GpuSection::DENOISE, true);
+}
+
 void Renderer::reloadModifiedShaders()
 {
-}
\ No newline at end of file
+	// swap in what finished compiling
+	for (auto it = pendingShaders.begin(); it != pendingShaders.end();) {
+		if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			++it;
+			continue;
+		}
+		takeCompiledShader(it->first, it->second);
+		it = pendingShaders.erase(it);
+	}
+
+	// polling the file system every frame is wasteful, a few times per second is plenty
+	const auto now = std::chrono::steady_clock::now();
+	if (now - lastShaderCheck < std::chrono::milliseconds(100))
+		return;
+	lastShaderCheck = now;
+
+	for (Shader* shader : shaders) {
+		if (pendingShaders.count(shader) || !shader->isModified())
+			continue;
+		std::cout << "Recompiling " << shader->getFileLocation() << std::endl;
+		pendingShaders[shader] = shaderCompiler->submit(shader);
+	}
+}
+
+void Renderer::takeCompiledShader(Shader* shader, std::future<VkShaderModule>& module)
+{
+	try {
+		const VkShaderModule newModule = module.get();
+		if (newModule == VK_NULL_HANDLE)
+			return; // the errors are printed, keep the last working pipelines
+		shader->setModule(newModule);
+
+		// rebuild the pipelines that exist already, the old ones are destroyed once no frame in flight uses them
+		for (TierVariant& tier : tiers) {
+			if (tier.graphicsPipeline != VK_NULL_HANDLE && (shader == screenQuadVS || shader == tier.screenQuadFS)) {
+				const VkPipeline pipeline = createScreenQuadPipeline(tier.screenQuadFS);
+				retirePipeline(tier.graphicsPipeline);
+				tier.graphicsPipeline = pipeline;
+				resetAccumulation(); // the image may look different now
+			}
+			if (tier.tracePipeline != VK_NULL_HANDLE && shader == tier.traceCS) {
+				createTracePipeline(tier);
+				resetAccumulation();
+			}
+			for (int kernel = 0; kernel < WAVEFRONT_KERNEL_COUNT; ++kernel) {
+				if (tier.wavefrontPipelines[kernel] != VK_NULL_HANDLE && shader == tier.wavefrontCS[kernel]) {
+					createWavefrontPipeline(tier, WavefrontKernel(kernel));
+					resetAccumulation();
+				}
+			}
+		}
+		if (presentPipeline != VK_NULL_HANDLE && (shader == screenQuadVS || shader == presentFS)) {
+			const VkPipeline pipeline = createScreenQuadPipeline(presentFS);
+			retirePipeline(presentPipeline);
+			presentPipeline = pipeline;
+			resetAccumulation();
+		}
+		if (denoisePipeline != VK_NULL_HANDLE && shader == denoiseCS)
+			createDenoisePipeline(); // only filters what is shown, the accumulation stays valid
+	}
+	catch (const std::runtime_error& e) {
+		std::cerr << e.what() << std::endl;
+	}
+}
+
+void Renderer::preparePipelines()
+{
+	const bool compute = tracePath == TracePath::COMPUTE;
+	const bool wavefront = tracePath == TracePath::WAVEFRONT;
+	const bool present = usesPresentPass();
+	const bool denoising = denoisePasses > 0;
+	TierVariant& tier = tiers[size_t(qualityTier)];
+	// more samples than the wavefront buffers were made for need larger ones
+	const bool wavefrontBuffersReady = wavefrontCapacity >= getWavefrontCapacity(swapChainExtent, getTraceSettings());
+	const bool traceReady = wavefront
+		? wavefrontBuffersReady && std::find(std::begin(tier.wavefrontPipelines), std::end(tier.wavefrontPipelines), VkPipeline(VK_NULL_HANDLE)) == std::end(tier.wavefrontPipelines)
+		: (compute ? tier.tracePipeline : tier.graphicsPipeline) != VK_NULL_HANDLE;
+	if ((!present || presentPipeline != VK_NULL_HANDLE) && (!denoising || denoisePipeline != VK_NULL_HANDLE) && traceReady)
+		return;
+
+	std::vector<Shader*> needed = { screenQuadVS };
+	if (wavefront)
+		needed.insert(needed.end(), std::begin(tier.wavefrontCS), std::end(tier.wavefrontCS));
+	else
+		needed.push_back(compute ? tier.traceCS : tier.screenQuadFS);
+	if (present)
+		needed.push_back(presentFS);
+	if (denoising)
+		needed.push_back(denoiseCS);
+	for (Shader* shader : needed) {
+		auto pending = pendingShaders.find(shader);
+		if (pending != pendingShaders.end()) {
+			takeCompiledShader(shader, pending->second);
+			pendingShaders.erase(pending);
+		}
+		if (!shader->hasModule())
+			throw std::runtime_error("Shader " + shader->getFileLocation() + " could not be compiled!");
+	}
+
+	if (!compute && !wavefront && tier.graphicsPipeline == VK_NULL_HANDLE)
+		tier.graphicsPipeline = createScreenQuadPipeline(tier.screenQuadFS);
+	if (present && presentPipeline == VK_NULL_HANDLE)
+		presentPipeline = createScreenQuadPipeline(presentFS);
+	if (compute && tier.tracePipeline == VK_NULL_HANDLE)
+		createTracePipeline(tier);
+	if (wavefront) {
+		if (!wavefrontBuffersReady)
+			createWavefrontBuffers();
+		for (int kernel = 0; kernel < WAVEFRONT_KERNEL_COUNT; ++kernel) {
+			if (tier.wavefrontPipelines[kernel] == VK_NULL_HANDLE)
+				createWavefrontPipeline(tier, WavefrontKernel(kernel));
+		}
+	}
+	if (denoising && denoisePipeline == VK_NULL_HANDLE)
+		createDenoisePipeline();
+}
+
+const TraceSettings& Renderer::getTraceSettings() const
+{
+	return qualityTier == QualityTier::CUSTOM ? settings : getQualityTierInfo(qualityTier).settings;
+}
@@ -0,0 +1,190 @@
+#include "Sampler.h"
+#include "StringUtil.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const char* const SAMPLER_NAMES[] = { "Random", "Sobol", "BlueNoise" };
+
+uint32_t reverseBits(uint32_t x) {
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+	x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+// Laine and Karras' hash: every bit is flipped depending on the bits below it only,
+// an Owen scramble of the bit reversed value
+uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed) {
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return x;
+}
+
+uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+	return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+// second dimension of the Sobol sequence, the first one is the bit reversed index
+uint32_t sobol1(uint32_t index) {
+	uint32_t result = 0;
+	for (uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+		if (index & 1)
+			result ^= v;
+	return result;
+}
+
+// the upper 24 bits, exact in a float
+float toUnitFloat(uint32_t x) {
+	return float(x >> 8) * (1.0f / 16777216.0f);
+}
+
+// shuffling the index keeps every power of two long run of samples a (0, m, 2)-net
+glm::vec2 sobolOwen(uint32_t index, uint32_t seed) {
+	index = nestedUniformScramble(index, seed);
+	return glm::vec2(toUnitFloat(nestedUniformScramble(reverseBits(index), pcg(seed ^ 0xa511e9b3u))),
+		toUnitFloat(nestedUniformScramble(sobol1(index), pcg(seed ^ 0x63d83595u))));
+}
+
+glm::vec2 blueNoise(glm::uvec2 pixel, uint32_t index, uint32_t seed) {
+	const std::vector<float>& mask = getBlueNoiseMask();
+	const uint32_t wrap = BLUE_NOISE_SIZE - 1;
+	const uint32_t x0 = (pixel.x + seed) & wrap, y0 = (pixel.y + (seed >> 8)) & wrap;
+	// the second coordinate from the opposite quarter of the mask
+	const uint32_t x1 = (x0 + BLUE_NOISE_SIZE / 2) & wrap, y1 = (y0 + BLUE_NOISE_SIZE / 2) & wrap;
+	const glm::vec2 value(mask[y0 * BLUE_NOISE_SIZE + x0], mask[y1 * BLUE_NOISE_SIZE + x1]);
+	// the R2 sequence in 0.32 fixed point
+	return glm::fract(value + glm::vec2(toUnitFloat(index * 3242174889u), toUnitFloat(index * 2447445414u)));
+}
+
+glm::vec2 randomSample(uint32_t index, uint32_t seed) {
+	const uint32_t hash = pcg(seed ^ pcg(index));
+	return glm::vec2(toUnitFloat(hash), toUnitFloat(pcg(hash)));
+}
+
+std::vector<float> generateBlueNoiseMask() {
+	constexpr int SIZE = int(BLUE_NOISE_SIZE);
+	constexpr int COUNT = SIZE * SIZE;
+	constexpr float SIGMA = 1.5f;
+
+	// Gaussian of the distance on the torus
+	std::vector<float> kernel(COUNT);
+	for (int y = 0; y < SIZE; ++y) {
+		for (int x = 0; x < SIZE; ++x) {
+			const float dx = float(std::min(x, SIZE - x)), dy = float(std::min(y, SIZE - y));
+			kernel[y * SIZE + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * SIGMA * SIGMA));
+		}
+	}
+
+	std::vector<uint8_t> pattern(COUNT, 0);
+	std::vector<float> energy(COUNT, 0.0f);
+	auto toggle = [&](int p, bool set) {
+		pattern[p] = set;
+		const float sign = set ? 1.0f : -1.0f;
+		const int px = p % SIZE, py = p / SIZE;
+		for (int y = 0; y < SIZE; ++y) {
+			const float* row = &kernel[((y - py) & (SIZE - 1)) * SIZE];
+			for (int x = 0; x < SIZE; ++x)
+				energy[y * SIZE + x] += sign * row[(x - px) & (SIZE - 1)];
+		}
+	};
+	// the set pixel with the most energy around it and the unset one with the least
+	auto tightestCluster = [&]() {
+		int best = -1;
+		for (int p = 0; p < COUNT; ++p)
+			if (pattern[p] && (best < 0 || energy[p] > energy[best]))
+				best = p;
+		return best;
+	};
+	auto largestVoid = [&]() {
+		int best = -1;
+		for (int p = 0; p < COUNT; ++p)
+			if (!pattern[p] && (best < 0 || energy[p] < energy[best]))
+				best = p;
+		return best;
+	};
+
+	// a tenth of the pixels at random, then moved from the clusters into the voids until they are spread evenly
+	const int initialCount = COUNT / 10;
+	uint32_t state = 1;
+	for (int placed = 0; placed < initialCount;) {
+		state = pcg(state);
+		const int p = int(state % COUNT);
+		if (!pattern[p]) {
+			toggle(p, true);
+			++placed;
+		}
+	}
+	for (int i = 0; i < COUNT; ++i) {
+		const int cluster = tightestCluster();
+		toggle(cluster, false);
+		const int hole = largestVoid();
+		toggle(hole, true);
+		if (hole == cluster)
+			break;
+	}
+
+	// the initial pixels are ranked by taking away the tightest clusters, all others by filling the largest voids
+	std::vector<int> rank(COUNT);
+	const std::vector<uint8_t> initialPattern = pattern;
+	const std::vector<float> initialEnergy = energy;
+	for (int r = initialCount - 1; r >= 0; --r) {
+		const int p = tightestCluster();
+		toggle(p, false);
+		rank[p] = r;
+	}
+	pattern = initialPattern;
+	energy = initialEnergy;
+	for (int r = initialCount; r < COUNT; ++r) {
+		const int p = largestVoid();
+		toggle(p, true);
+		rank[p] = r;
+	}
+
+	std::vector<float> mask(COUNT);
+	for (int p = 0; p < COUNT; ++p)
+		mask[p] = (float(rank[p]) + 0.5f) / float(COUNT);
+	return mask;
+}
+
+}
+
+const char* getSamplerName(SamplerType type) {
+	return SAMPLER_NAMES[size_t(type)];
+}
+
+bool findSampler(const std::string& name, SamplerType& type) {
+	for (size_t i = 0; i < size_t(SamplerType::COUNT); ++i) {
+		if (equalsIgnoreCase(name, SAMPLER_NAMES[i])) {
+			type = SamplerType(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+SampleStream startSampleStream(SamplerType type, glm::uvec2 pixel, uint32_t index, uint32_t sequenceSeed) {
+	// the blue noise mask decorrelates the pixels by itself, a seed per pixel would destroy its structure
+	const uint32_t seed = type == SamplerType::BLUE_NOISE ? pcg(sequenceSeed) : pcg(sequenceSeed ^ pcg(pixel.x ^ pcg(pixel.y)));
+	return SampleStream{ type, pixel, index, seed, 0 };
+}
+
+glm::vec2 nextSample(SampleStream& stream) {
+	const uint32_t seed = pcg(stream.seed ^ pcg(stream.dimension++));
+	switch (stream.type) {
+	case SamplerType::SOBOL: return sobolOwen(stream.index, seed);
+	case SamplerType::BLUE_NOISE: return blueNoise(stream.pixel, stream.index, seed);
+	default: return randomSample(stream.index, seed);
+	}
+}
+
+const std::vector<float>& getBlueNoiseMask() {
+	static const std::vector<float> mask = generateBlueNoiseMask();
+	return mask;
+}
@@ -1,8 +1,111 @@
 #include "Shader.h"
 
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#include <chrono>
 
-Shader::Shader(VkDevice device, std::string fileName, std::string shaderFolder) : device(device) {
+// resolves #include "file" relative to the including file and #include <file> relative to the shader folder
+class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface {
+public:
+	// every successfully included file is appended to includedFiles
+	ShaderIncluder(std::filesystem::path shaderFolder, std::vector<std::filesystem::path>* includedFiles) :
+		shaderFolder(shaderFolder), includedFiles(includedFiles) {}
+
+	shaderc_include_result* GetInclude(const char* requested_source, shaderc_include_type type, const char* requesting_source, size_t include_depth) override {
+		IncludeData* data = new IncludeData;
+		const std::filesystem::path base = type == shaderc_include_type_relative ? std::filesystem::path(requesting_source).parent_path() : shaderFolder;
+		const std::filesystem::path file = base / requested_source;
+
+		std::ifstream fileStream(file, std::ios::binary);
+		if (fileStream.is_open()) {
+			data->name = file.generic_string();
+			data->content.assign(std::istreambuf_iterator<char>(fileStream), std::istreambuf_iterator<char>());
+			includedFiles->push_back(file);
+		}
+		else {
+			// an empty name tells shaderc the include failed, the content is the error message
+			data->content = "Could not open file " + file.generic_string() + "!";
+		}
+
+		data->result.source_name = data->name.c_str();
+		data->result.source_name_length = data->name.size();
+		data->result.content = data->content.c_str();
+		data->result.content_length = data->content.size();
+		data->result.user_data = data;
+		return &data->result;
+	}
+
+	void ReleaseInclude(shaderc_include_result* result) override {
+		delete static_cast<IncludeData*>(result->user_data);
+	}
+
+private:
+	struct IncludeData {
+		shaderc_include_result result;
+		std::string name;
+		std::string content;
+	};
+
+	std::filesystem::path shaderFolder;
+	std::vector<std::filesystem::path>* includedFiles;
+};
+
+// shaderc compilers hold no mutable state and may be used from several threads at once
+static shaderc::Compiler& getCompiler() {
+	static shaderc::Compiler compiler;
+	return compiler;
+}
+
+static std::filesystem::path cacheDirectory = "shader_cache";
+
+// bump whenever something that affects the output but not the key changes
+static constexpr uint32_t SHADER_CACHE_VERSION = 1;
+static constexpr shaderc_optimization_level SHADER_OPTIMIZATION = shaderc_optimization_level_performance;
+static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+// 64 bit FNV-1a
+static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	return hash;
+}
+
+static uint64_t hashString(const std::string& s, uint64_t hash) {
+	// the length keeps "ab" + "c" and "a" + "bc" apart
+	const uint64_t size = s.size();
+	return hashBytes(s.data(), s.size(), hashBytes(&size, sizeof(size), hash));
+}
+
+static std::vector<uint32_t> readSpirv(const std::filesystem::path& file) {
+	std::ifstream fileStream(file, std::ios::binary | std::ios::ate);
+	if (!fileStream.is_open())
+		return {};
+	const size_t size = fileStream.tellg();
+	if (size == 0 || size % sizeof(uint32_t) != 0)
+		return {};
+	std::vector<uint32_t> spirv(size / sizeof(uint32_t));
+	fileStream.seekg(0, std::ios::beg);
+	fileStream.read(reinterpret_cast<char*>(spirv.data()), size);
+	if (!fileStream || spirv[0] != SPIRV_MAGIC)
+		return {};
+	return spirv;
+}
+
+void Shader::setCacheDirectory(const std::filesystem::path& directory) {
+	cacheDirectory = directory;
+}
+
+const std::filesystem::path& Shader::getCacheDirectory() {
+	return cacheDirectory;
+}
+
+Shader::Shader(VkDevice device, std::string fileName, ShaderMacros macros, std::string shaderFolder) : device(device) {
 	const std::string current_path = std::filesystem::current_path().generic_string();
 	fileLocation = current_path + std::string("/") + shaderFolder + fileName;
 
@@ -20,6 +123,7 @@ Shader::Shader(VkDevice device, std::string fileName, std::string shaderFolder)
 
 		if (extension == "comp") {
 			type = COMPUTE_SHADER;
+			shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
 		}
 		else if (extension == "vert") {
 			type = VERTEX_SHADER;
@@ -35,19 +139,17 @@ Shader::Shader(VkDevice device, std::string fileName, std::string shaderFolder)
 	}
 
 	if (type != SPIR_V_BINARY) {
-		// TODO: Add Importer for GLSL Import files
+		compileOptions.SetIncluder(std::make_unique<ShaderIncluder>(std::filesystem::path(fileLocation).parent_path(), &includedFiles));
 		compileOptions.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
 		compileOptions.SetSourceLanguage(shaderc_source_language_glsl);
-		compileOptions.SetOptimizationLevel(shaderc_optimization_level_performance);
+		compileOptions.SetOptimizationLevel(SHADER_OPTIMIZATION);
 
-		std::vector<std::pair<std::string, std::string>> defs;
-		defs.push_back(std::make_pair("__VK_GLSL__", "1"));
+		definitions.push_back(std::make_pair("__VK_GLSL__", "1"));
+		definitions.insert(definitions.end(), macros.begin(), macros.end());
 
-		for (auto& defPair : defs) // Add given definitions to compiler
+		for (auto& defPair : definitions) // Add given definitions to compiler
 			compileOptions.AddMacroDefinition(defPair.first, defPair.second);
 	}
-
-	reload();
 }
 
 Shader::~Shader() {
@@ -56,63 +158,152 @@ Shader::~Shader() {
 }
 
 void Shader::reload() {
+	if (!isModified())
+		return; // no update required
+
+	const std::vector<uint32_t> spirv = compile();
+	if (!spirv.empty())
+		createModule(spirv);
+}
+
+bool Shader::isModified() const {
+	if (dependencies.empty())
+		return true;
+
+	std::error_code error;
+	for (const auto& [file, lastWrite] : dependencies) {
+		// a file that is missing for a moment (editors replacing it on save) counts as unchanged
+		const auto time = std::filesystem::last_write_time(file, error);
+		if (!error && time != lastWrite)
+			return true;
+	}
+	return false;
+}
+
+std::vector<uint32_t> Shader::compile() {
 	if (type == NONE)
 		throw std::runtime_error("Shader has NONE-Type!");
 
-	// check for updated file
-	auto last_write = std::filesystem::last_write_time(fileLocation);
-	if (last_write == last_updated)
-		return; // no update required
+	// remember the write times before reading, changes made during the compile trigger another one
+	includedFiles.clear();
+	std::error_code error;
+	const auto lastWrite = std::filesystem::last_write_time(fileLocation, error);
+	if (error) {
+		std::cerr << "Could not read " << fileLocation << ": " << error.message() << std::endl;
+		return {};
+	}
+	std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>> newDependencies;
+	newDependencies.emplace_back(fileLocation, lastWrite);
 
-	// update last update timestamp
-	last_updated = last_write;
+	// the includes of a failed compile are still tracked, fixing one of them has to trigger a retry
+	auto trackIncludes = [&]() {
+		for (const std::filesystem::path& file : includedFiles) {
+			const bool known = std::any_of(newDependencies.begin(), newDependencies.end(), [&](const auto& dep) { return dep.first == file; });
+			if (!known)
+				newDependencies.emplace_back(file, std::filesystem::last_write_time(file, error));
+		}
+		dependencies = newDependencies;
+	};
 
-	// Get new shader before the old one is removed in case of an error
 	std::vector<uint32_t> shaderBinary;
 	if (type == SPIR_V_BINARY) { // No need to compile
-		std::vector<char> binary = readBinaryFile(fileLocation);
-		shaderBinary = std::vector<uint32_t>(reinterpret_cast<uint32_t>(binary.data()), binary.size());
+		shaderBinary = readSpirv(fileLocation);
+		if (shaderBinary.empty())
+			std::cerr << fileLocation << " is not a SPIR-V binary!" << std::endl;
 	}
 	else { // compile GLSL shader
 		const std::string sourceString = readTextFile(fileLocation); // Get source of shader
 
 		// preprocess shader
 		const shaderc::PreprocessedSourceCompilationResult preprocess = 
-			shaderCompiler.PreprocessGlsl(sourceString, (shaderc_shader_kind) type, fileLocation.c_str(), compileOptions);
+			getCompiler().PreprocessGlsl(sourceString, (shaderc_shader_kind) type, fileLocation.c_str(), compileOptions);
 		if (preprocess.GetCompilationStatus() != shaderc_compilation_status_success)
 		{
 			std::cerr << preprocess.GetErrorMessage() << std::endl;
-			return; // recompilation failed
+			trackIncludes();
+			return {}; // recompilation failed
 		}
 		const std::string postpre(preprocess.cbegin(), preprocess.cend());
 
+		// the preprocessed source already contains the includes, anything else that changes the output goes into the key as well
+		uint64_t key = hashBytes(&SHADER_CACHE_VERSION, sizeof(SHADER_CACHE_VERSION));
+		const int32_t options[] = { int32_t(type), int32_t(SHADER_OPTIMIZATION), int32_t(shaderc_env_version_vulkan_1_3) };
+		key = hashBytes(options, sizeof(options), key);
+		for (const auto& [name, value] : definitions)
+			key = hashString(value, hashString(name, key));
+		key = hashString(postpre, key);
+
+		std::filesystem::path cacheFile;
+		if (!cacheDirectory.empty()) {
+			char name[32];
+			snprintf(name, sizeof(name), "%016llx.spv", (unsigned long long) key);
+			cacheFile = cacheDirectory / name;
+			shaderBinary = readSpirv(cacheFile);
+			if (!shaderBinary.empty()) {
+				trackIncludes();
+				return shaderBinary;
+			}
+		}
+
 		// compile shader
 		const shaderc::SpvCompilationResult binary =
-			shaderCompiler.CompileGlslToSpv(postpre, (shaderc_shader_kind)type, fileLocation.c_str(), compileOptions);
+			getCompiler().CompileGlslToSpv(postpre, (shaderc_shader_kind)type, fileLocation.c_str(), compileOptions);
 		if (binary.GetCompilationStatus() != shaderc_compilation_status_success)
 		{
 			std::cerr << binary.GetErrorMessage() << std::endl;
-			return; // recompilation failed
+			trackIncludes();
+			return {}; // recompilation failed
 		}
 
 		shaderBinary = std::vector<uint32_t>(binary.cbegin(), binary.end());
+
+		// write to a temporary file first, other processes may read the cache at the same time
+		if (!cacheFile.empty()) {
+			std::error_code error;
+			std::filesystem::create_directories(cacheDirectory, error);
+			std::filesystem::path tempFile = cacheFile;
+			tempFile += ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()) ^ size_t(std::chrono::steady_clock::now().time_since_epoch().count()));
+			std::ofstream out(tempFile, std::ios::binary);
+			out.write(reinterpret_cast<const char*>(shaderBinary.data()), shaderBinary.size() * sizeof(uint32_t));
+			out.close();
+			if (out)
+				std::filesystem::rename(tempFile, cacheFile, error);
+			if (!out || error) {
+				std::cerr << "Could not write " << cacheFile.generic_string() << " to the shader cache" << std::endl;
+				std::filesystem::remove(tempFile, error);
+			}
+		}
 	}
 
-	// Remove old shader
-	cleanup();
+	trackIncludes();
+	return shaderBinary;
+}
 
+VkShaderModule Shader::createShaderModule(VkDevice device, const std::vector<uint32_t>& shaderBinary) {
 	VkShaderModuleCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 	createInfo.flags = VkShaderModuleCreateFlags();
 	createInfo.codeSize = shaderBinary.size() * sizeof(uint32_t);
 	createInfo.pCode = reinterpret_cast<const uint32_t*>(shaderBinary.data());
 
-	if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+	VkShaderModule newModule;
+	if (vkCreateShaderModule(device, &createInfo, nullptr, &newModule) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create Shader Module!");
 	}
+	return newModule;
+}
+
+void Shader::createModule(const std::vector<uint32_t>& shaderBinary) {
+	setModule(createShaderModule(device, shaderBinary));
+}
+
+void Shader::setModule(VkShaderModule newModule) {
+	// Remove old shader
+	cleanup();
+	shaderModule = newModule;
 
 	shaderStageInfo.module = shaderModule;
 	shaderStageInfo.pName = "main";
 
 	std::cout << "Successfully loaded Shader: " << fileLocation << std::endl;
-}
\ No newline at end of file
+}
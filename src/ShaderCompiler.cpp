@@ -0,0 +1,54 @@
+#include "ShaderCompiler.h"
+
+#include <algorithm>
+
+ShaderCompiler::ShaderCompiler(VkDevice device, uint32_t threadCount) :
+	device(device)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	for (uint32_t i = 0; i < threadCount; ++i)
+		workers.emplace_back(&ShaderCompiler::workerLoop, this);
+}
+
+ShaderCompiler::~ShaderCompiler() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobAdded.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+std::future<VkShaderModule> ShaderCompiler::submit(Shader* shader) {
+	std::packaged_task<VkShaderModule()> job([this, shader]() {
+		const std::vector<uint32_t> spirv = shader->compile();
+		if (spirv.empty())
+			return VkShaderModule(VK_NULL_HANDLE);
+		return Shader::createShaderModule(device, spirv);
+	});
+	std::future<VkShaderModule> result = job.get_future();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	jobAdded.notify_one();
+	return result;
+}
+
+void ShaderCompiler::workerLoop() {
+	while (true) {
+		std::packaged_task<VkShaderModule()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobAdded.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			// the queue is drained before stopping, nobody is left waiting on a broken promise
+			if (jobs.empty())
+				return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		job(); // exceptions end up in the future
+	}
+}
@@ -0,0 +1,115 @@
+#include "TiledRenderer.h"
+#include "ImageIO.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+TiledRenderer::TiledRenderer(uint32_t width, uint32_t height, uint32_t tileSize) :
+	width(width), height(height), tileSize(tileSize)
+{
+	if (width == 0 || height == 0 || tileSize == 0)
+		throw std::runtime_error("Tiled render needs a non-empty image and tile size!");
+	tilesX = (width + tileSize - 1) / tileSize;
+	tilesY = (height + tileSize - 1) / tileSize;
+}
+
+TiledRenderer::~TiledRenderer() {
+
+}
+
+Camera TiledRenderer::getTileCamera(const Camera& camera, uint32_t width, uint32_t height, glm::uvec2 from, uint32_t size) {
+	// extents of the whole image on the near plane (perspective) or in view space (orthographic)
+	float left = camera.left, right = camera.right, bottom = camera.bottom, top = camera.top;
+	if (camera.perspective && !camera.skewed) {
+		top = camera.near * std::tan(camera.fov_degree * 3.14159265f / 360.0f);
+		bottom = -top;
+		right = top * camera.aspect_ratio;
+		left = -right;
+	}
+
+	// edge tiles reach past the image, their frustum keeps the same pixel size
+	Camera tile = camera;
+	tile.left = left + (right - left) * float(from.x) / float(width);
+	tile.right = left + (right - left) * float(from.x + size) / float(width);
+	tile.top = top - (top - bottom) * float(from.y) / float(height);
+	tile.bottom = top - (top - bottom) * float(from.y + size) / float(height);
+	tile.skewed = true;
+	tile.aspect_ratio = 1.0f;
+	tile.update();
+	return tile;
+}
+
+std::string TiledRenderer::getProgressFileName(const std::string& fileName) {
+	return fileName + ".tiles";
+}
+
+std::string TiledRenderer::getProgressHeader() const {
+	return "grayv-tiles " + std::to_string(width) + " " + std::to_string(height) + " " + std::to_string(tileSize);
+}
+
+std::vector<bool> TiledRenderer::readProgress(const std::string& progressFile) const {
+	std::vector<bool> done(getTileCount(), false);
+	std::ifstream file(progressFile);
+	if (!file.is_open())
+		throw std::runtime_error("Could not open progress log " + progressFile + "!");
+
+	std::string line;
+	if (!std::getline(file, line) || line != getProgressHeader())
+		throw std::runtime_error(progressFile + " belongs to a different image or tile size!");
+
+	// a line cut short by a crash is ignored, that tile is simply rendered again
+	while (std::getline(file, line)) {
+		std::istringstream stream(line);
+		uint32_t tile;
+		std::string rest;
+		if (stream >> tile && !(stream >> rest) && tile < done.size())
+			done[tile] = true;
+	}
+	return done;
+}
+
+uint32_t TiledRenderer::render(const Camera& camera, const std::string& fileName, bool resume, const TileFunc& renderTile) {
+	const std::string progressFile = getProgressFileName(fileName);
+	std::vector<bool> done = resume ? readProgress(progressFile) : std::vector<bool>(getTileCount(), false);
+	const uint32_t remaining = uint32_t(std::count(done.begin(), done.end(), false));
+
+	PPMTileFile image(fileName, width, height, !resume);
+	std::ofstream progress(progressFile, resume ? std::ios::app : std::ios::trunc);
+	if (!progress.is_open())
+		throw std::runtime_error("Could not open progress log " + progressFile + "!");
+	if (!resume)
+		progress << getProgressHeader() << std::endl;
+
+	std::cout << "Tiled render " << width << "x" << height << " in " << getTileCount() << " tiles of " << tileSize << "x" << tileSize;
+	if (resume)
+		std::cout << ", resuming with " << remaining << " left";
+	std::cout << std::endl;
+
+	std::vector<uint8_t> pixels(size_t(tileSize) * tileSize * 4);
+	const auto start = std::chrono::steady_clock::now();
+	uint32_t rendered = 0;
+	for (uint32_t tile = 0; tile < getTileCount(); ++tile) {
+		if (done[tile])
+			continue;
+
+		const glm::uvec2 from(tile % tilesX * tileSize, tile / tilesX * tileSize);
+		renderTile(getTileCamera(camera, width, height, from, tileSize), tileSize, tile, pixels.data());
+
+		// the image has to be on disk before the log claims the tile
+		image.write(from.x, from.y, std::min(tileSize, width - from.x), std::min(tileSize, height - from.y), pixels.data(), tileSize);
+		image.flush();
+		progress << tile << std::endl;
+		++rendered;
+
+		const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		const double eta = elapsed / rendered * (remaining - rendered);
+		std::cout << "Tile " << tile + 1 << "/" << getTileCount() << " (" << rendered << "/" << remaining << " this run, "
+			<< int(elapsed) << " s elapsed, ~" << int(eta) << " s left)" << std::endl;
+	}
+	return rendered;
+}
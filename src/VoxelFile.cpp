@@ -0,0 +1,280 @@
+#include "VoxelFile.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <thread>
+#include <atomic>
+
+static const char GVOX_MAGIC[4] = { 'G', 'V', 'O', 'X' };
+static const uint32_t GVOX_VERSION = 1;
+// bricks per decoding thread at least, smaller files are not worth a thread
+static const size_t BRICKS_PER_THREAD = 4096;
+
+// bits per index of a brick using count palette entries
+static uint32_t getIndexBits(uint32_t count) {
+	return count <= 2 ? 1 : count <= 4 ? 2 : count <= 16 ? 4 : 8;
+}
+
+// 0xff in byte i of the result for every bit i that is set
+static uint64_t spreadBits(uint8_t bits) {
+	// bit i is kept in byte i only, adding 0x7f sets the top bit of the bytes that are not zero without carrying over
+	const uint64_t each = uint64_t(bits) * 0x0101010101010101ull & 0x8040201008040201ull;
+	const uint64_t tops = ((each + 0x7f7f7f7f7f7f7f7full) | each) & 0x8080808080808080ull;
+	return (tops >> 7) * 0xff;
+}
+
+static size_t getBrickSize(uint32_t count) {
+	return 1 + count + BRICK_VOXELS * getIndexBits(count) / 8;
+}
+
+VoxelFile::VoxelFile(const std::string& fileName) :
+	file(fileName)
+{
+	if (file.size() < sizeof(GvoxHeader))
+		throw std::runtime_error(fileName + " is too small for a voxel file!");
+	header = reinterpret_cast<const GvoxHeader*>(file.data());
+	if (memcmp(header->magic, GVOX_MAGIC, sizeof(GVOX_MAGIC)) != 0)
+		throw std::runtime_error(fileName + " is not a voxel file!");
+	if (header->version != GVOX_VERSION)
+		throw std::runtime_error(fileName + " has unsupported version " + std::to_string(header->version) + "!");
+
+	const glm::ivec3 brickDims = getBrickDims();
+	if (brickDims.x <= 0 || brickDims.y <= 0 || brickDims.z <= 0 || header->paletteSize == 0 || header->paletteSize > 256 || header->outsidePalette >= header->paletteSize)
+		throw std::runtime_error(fileName + " has an invalid header!");
+	const glm::ivec3 coarseDims = (brickDims + COARSE_BRICKS - 1) / COARSE_BRICKS;
+	brickTableSize = size_t(brickDims.x) * brickDims.y * brickDims.z;
+	coarseTableSize = size_t(coarseDims.x) * coarseDims.y * coarseDims.z;
+
+	// every section has to be within the file and aligned for its type, the mapping itself is page aligned
+	auto checkSection = [&](uint64_t offset, uint64_t size, uint64_t alignment) {
+		if (offset % alignment != 0 || offset > file.size() || size > file.size() - offset)
+			throw std::runtime_error(fileName + " is truncated or corrupt!");
+		return file.data() + offset;
+	};
+	const uint32_t* palette = reinterpret_cast<const uint32_t*>(checkSection(header->paletteOffset, uint64_t(header->paletteSize) * sizeof(uint32_t), sizeof(uint32_t)));
+	brickTable = reinterpret_cast<const uint32_t*>(checkSection(header->tableOffset, brickTableSize * sizeof(uint32_t), sizeof(uint32_t)));
+	coarseTable = reinterpret_cast<const uint32_t*>(checkSection(header->coarseOffset, coarseTableSize * sizeof(uint32_t), sizeof(uint32_t)));
+	brickIndex = reinterpret_cast<const uint64_t*>(checkSection(header->indexOffset, (uint64_t(header->brickCount) + 1) * sizeof(uint64_t), sizeof(uint64_t)));
+	brickData = checkSection(header->brickDataOffset, brickIndex[header->brickCount], 1);
+
+	for (uint32_t i = 0; i < header->paletteSize; ++i) {
+		if (palette[i] > VOXEL_WATER)
+			throw std::runtime_error(fileName + " uses unknown material " + std::to_string(palette[i]) + "!");
+		materials[i] = uint8_t(palette[i]);
+	}
+
+	// the bricks are read once by the decoder, in order
+	file.prefetch(header->brickDataOffset, brickIndex[header->brickCount]);
+}
+
+VoxelFile::~VoxelFile() {
+
+}
+
+size_t VoxelFile::getGpuSize() const {
+	return sizeof(VoxelWorldGpuHeader) + (brickTableSize + coarseTableSize) * sizeof(uint32_t) + size_t(header->brickCount) * BRICK_VOXELS;
+}
+
+void VoxelFile::writeGpuData(void* dst) const {
+	const glm::ivec3 brickDims = getBrickDims();
+	const glm::ivec3 coarseDims = (brickDims + COARSE_BRICKS - 1) / COARSE_BRICKS;
+
+	VoxelWorldGpuHeader gpuHeader{};
+	gpuHeader.origin[0] = header->origin[0];
+	gpuHeader.origin[1] = header->origin[1];
+	gpuHeader.origin[2] = header->origin[2];
+	gpuHeader.outsideMaterial = materials[header->outsidePalette];
+	gpuHeader.brickDims[0] = brickDims.x;
+	gpuHeader.brickDims[1] = brickDims.y;
+	gpuHeader.brickDims[2] = brickDims.z;
+	gpuHeader.brickOffset = int32_t(brickTableSize + coarseTableSize);
+	gpuHeader.coarseDims[0] = coarseDims.x;
+	gpuHeader.coarseDims[1] = coarseDims.y;
+	gpuHeader.coarseDims[2] = coarseDims.z;
+	gpuHeader.coarseOffset = int32_t(brickTableSize);
+
+	uint8_t* out = static_cast<uint8_t*>(dst);
+	memcpy(out, &gpuHeader, sizeof(gpuHeader));
+	out += sizeof(gpuHeader);
+
+	// uniform bricks store a palette index, the brick numbers are the pool slots already
+	uint32_t* table = reinterpret_cast<uint32_t*>(out);
+	for (size_t i = 0; i < brickTableSize; ++i) {
+		const uint32_t entry = brickTable[i];
+		if (entry & BRICK_UNIFORM) {
+			if ((entry & ~BRICK_UNIFORM) >= header->paletteSize)
+				throw std::runtime_error("Voxel file has a corrupt brick table!");
+			table[i] = BRICK_UNIFORM | materials[entry & 0xff];
+		}
+		else {
+			if (entry >= header->brickCount)
+				throw std::runtime_error("Voxel file has a corrupt brick table!");
+			table[i] = entry;
+		}
+	}
+	out += brickTableSize * sizeof(uint32_t);
+	memcpy(out, coarseTable, coarseTableSize * sizeof(uint32_t));
+	out += coarseTableSize * sizeof(uint32_t);
+
+	// decoding is cheap next to reading the pages, the threads mostly keep several page faults in flight
+	const size_t brickCount = header->brickCount;
+	const size_t threadCount = std::clamp<size_t>(brickCount / BRICKS_PER_THREAD, 1, std::max(1u, std::thread::hardware_concurrency()));
+	std::atomic<bool> valid = true;
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t < threadCount; ++t) {
+		threads.emplace_back([this, t, threadCount, brickCount, out, &valid]() {
+			if (!decodeBricks(brickCount * t / threadCount, brickCount * (t + 1) / threadCount, out))
+				valid = false;
+		});
+	}
+	if (!decodeBricks(0, brickCount / threadCount, out))
+		valid = false;
+	for (std::thread& thread : threads)
+		thread.join();
+	if (!valid)
+		throw std::runtime_error("Voxel file has corrupt bricks!");
+}
+
+bool VoxelFile::decodeBricks(size_t first, size_t last, uint8_t* pool) const {
+	const uint64_t dataSize = brickIndex[header->brickCount];
+	uint8_t lookup[256];
+	for (size_t b = first; b < last; ++b) {
+		const uint64_t begin = brickIndex[b];
+		if (begin >= dataSize || brickIndex[b + 1] > dataSize || brickIndex[b + 1] < begin)
+			return false;
+		const uint8_t* brick = brickData + begin;
+		const uint32_t count = brick[0];
+		if (count == 0 || brickIndex[b + 1] - begin != getBrickSize(count))
+			return false;
+
+		// indices beyond the brick's palette hit the marker
+		memset(lookup, 0xff, sizeof(lookup));
+		for (uint32_t i = 0; i < count; ++i) {
+			if (brick[1 + i] >= header->paletteSize)
+				return false;
+			lookup[i] = materials[brick[1 + i]];
+		}
+
+		const uint8_t* indices = brick + 1 + count;
+		uint8_t* voxels = pool + b * BRICK_VOXELS;
+		if (count == 2) {
+			// the common case of two materials: 8 voxels at a time, every set bit selects the second one
+			const uint64_t first = 0x0101010101010101ull * lookup[0];
+			const uint64_t flip = first ^ (0x0101010101010101ull * lookup[1]);
+			for (int v = 0; v < BRICK_VOXELS; v += 8) {
+				const uint64_t mask = spreadBits(indices[v / 8]);
+				const uint64_t eight = first ^ (flip & mask);
+				memcpy(voxels + v, &eight, sizeof(eight));
+			}
+			continue;
+		}
+
+		const uint32_t bits = getIndexBits(count);
+		const uint32_t perByte = 8 / bits;
+		const uint8_t mask = uint8_t((1u << bits) - 1);
+		uint8_t invalid = 0;
+		for (int v = 0; v < BRICK_VOXELS; v += perByte) {
+			const uint8_t byte = indices[v / perByte];
+			for (uint32_t i = 0; i < perByte; ++i) {
+				voxels[v + i] = lookup[(byte >> (i * bits)) & mask];
+				invalid |= voxels[v + i] == 0xff;
+			}
+		}
+		if (invalid)
+			return false;
+	}
+	return true;
+}
+
+VoxelWorld VoxelFile::createWorld() const {
+	std::vector<uint8_t> data(getGpuSize());
+	writeGpuData(data.data());
+	return VoxelWorld::fromGpuData(data.data(), data.size());
+}
+
+void VoxelFile::write(const VoxelWorld& world, const std::string& fileName) {
+	// the palette is the materials themselves, the bricks only list the ones they use
+	const uint32_t palette[] = { VOXEL_EMPTY, VOXEL_SOLID, VOXEL_WATER };
+	const glm::ivec3 brickDims = world.getBrickDims();
+	const glm::ivec3 coarseDims = world.getCoarseDims();
+	const size_t brickTableSize = size_t(brickDims.x) * brickDims.y * brickDims.z;
+	const size_t coarseTableSize = size_t(coarseDims.x) * coarseDims.y * coarseDims.z;
+	const size_t brickCount = world.getBrickCount();
+
+	std::vector<uint64_t> index;
+	index.reserve(brickCount + 1);
+	std::vector<uint8_t> data;
+	const uint8_t* pool = world.getBrickPool();
+	for (size_t b = 0; b < brickCount; ++b) {
+		const uint8_t* voxels = pool + b * BRICK_VOXELS;
+		bool used[256] = {};
+		for (int v = 0; v < BRICK_VOXELS; ++v)
+			used[voxels[v]] = true;
+		uint8_t slots[256];
+		uint32_t count = 0;
+		const size_t start = data.size();
+		data.push_back(0);
+		for (uint32_t m = 0; m < 256; ++m) {
+			if (used[m]) {
+				slots[m] = uint8_t(count++);
+				data.push_back(uint8_t(m));
+			}
+		}
+		data[start] = uint8_t(count);
+
+		const uint32_t bits = getIndexBits(count);
+		const uint32_t perByte = 8 / bits;
+		for (int v = 0; v < BRICK_VOXELS; v += perByte) {
+			uint8_t byte = 0;
+			for (uint32_t i = 0; i < perByte; ++i)
+				byte |= uint8_t(slots[voxels[v + i]] << (i * bits));
+			data.push_back(byte);
+		}
+		index.push_back(start);
+	}
+	index.push_back(data.size());
+
+	auto align = [](uint64_t offset) { return (offset + 7) / 8 * 8; };
+	GvoxHeader header{};
+	memcpy(header.magic, GVOX_MAGIC, sizeof(GVOX_MAGIC));
+	header.version = GVOX_VERSION;
+	header.origin[0] = world.getOrigin().x;
+	header.origin[1] = world.getOrigin().y;
+	header.origin[2] = world.getOrigin().z;
+	header.outsidePalette = world.getOutsideMaterial();
+	header.brickDims[0] = brickDims.x;
+	header.brickDims[1] = brickDims.y;
+	header.brickDims[2] = brickDims.z;
+	header.paletteSize = uint32_t(std::size(palette));
+	header.brickCount = uint32_t(brickCount);
+	header.paletteOffset = align(sizeof(GvoxHeader));
+	header.tableOffset = align(header.paletteOffset + sizeof(palette));
+	header.coarseOffset = align(header.tableOffset + brickTableSize * sizeof(uint32_t));
+	header.indexOffset = align(header.coarseOffset + coarseTableSize * sizeof(uint32_t));
+	header.brickDataOffset = align(header.indexOffset + index.size() * sizeof(uint64_t));
+
+	std::ofstream out(fileName, std::ios::binary | std::ios::out | std::ios::trunc);
+	if (!out.is_open())
+		throw std::runtime_error("Could not open file " + fileName + "!");
+	auto writeAt = [&out](uint64_t offset, const void* section, size_t size) {
+		// zero padding up to the aligned offset
+		static const char padding[8] = {};
+		out.write(padding, std::streamsize(offset - uint64_t(out.tellp())));
+		out.write(static_cast<const char*>(section), std::streamsize(size));
+	};
+	// the palette is the identity, so the uniform entries of the world's table stay as they are
+	writeAt(0, &header, sizeof(header));
+	writeAt(header.paletteOffset, palette, sizeof(palette));
+	writeAt(header.tableOffset, world.getBrickTable(), brickTableSize * sizeof(uint32_t));
+	writeAt(header.coarseOffset, world.getCoarseTable(), coarseTableSize * sizeof(uint32_t));
+	writeAt(header.indexOffset, index.data(), index.size() * sizeof(uint64_t));
+	writeAt(header.brickDataOffset, data.data(), data.size());
+	if (!out)
+		throw std::runtime_error("Could not write file " + fileName + "!");
+
+	std::cout << "Wrote " << fileName << ": " << brickCount << " bricks, " << (header.brickDataOffset + data.size()) / 1024 << " KiB ("
+		<< (world.getGpuSize() / 1024) << " KiB uncompressed)" << std::endl;
+}
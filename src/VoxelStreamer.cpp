@@ -0,0 +1,476 @@
+#include "VoxelStreamer.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+
+static const char CHUNK_MAGIC[4] = { 'G', 'V', 'C', 'K' };
+static const uint32_t CHUNK_VERSION = 1;
+// loaded chunks waiting for update(), bounds the mappings held by the loader
+static const size_t MAX_LOADED_CHUNKS = 64;
+
+static int floorDiv(int a, int b) {
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+VoxelStreamer::VoxelStreamer(const std::string& directory, glm::ivec3 windowChunks, size_t budgetBytes) :
+	directory(directory), windowChunks(windowChunks), poolCapacity(budgetBytes / BRICK_VOXELS)
+{
+	if (windowChunks.x <= 0 || windowChunks.y <= 0 || windowChunks.z <= 0)
+		throw std::runtime_error("The streaming window needs at least one chunk in every dimension!");
+	if (poolCapacity < size_t(CHUNK_BRICK_COUNT))
+		throw std::runtime_error("The streaming budget has to hold at least one chunk (" + std::to_string(CHUNK_BRICK_COUNT * BRICK_VOXELS / 1024) + " KiB)!");
+	if (!std::filesystem::is_directory(directory))
+		throw std::runtime_error("Chunk directory " + directory + " does not exist!");
+
+	// lowest slots are handed out first
+	freeBricks.resize(poolCapacity);
+	for (size_t i = 0; i < poolCapacity; ++i)
+		freeBricks[i] = uint32_t(poolCapacity - 1 - i);
+
+	const glm::ivec3 brickDims = windowChunks * CHUNK_BRICKS;
+	const glm::ivec3 coarseDims = windowChunks * (CHUNK_BRICKS / COARSE_BRICKS);
+	brickTable.resize(size_t(brickDims.x) * brickDims.y * brickDims.z, BRICK_UNIFORM | VOXEL_EMPTY);
+	coarseTable.resize(size_t(coarseDims.x) * coarseDims.y * coarseDims.z, 1);
+
+	loader = std::thread(&VoxelStreamer::loaderLoop, this);
+}
+
+VoxelStreamer::~VoxelStreamer() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	loaderWake.notify_all();
+	loader.join();
+}
+
+uint64_t VoxelStreamer::getKey(glm::ivec3 chunk) {
+	// 21 bits per axis, far more chunks than any disk holds
+	return (uint64_t(uint32_t(chunk.x) & 0x1FFFFFu) << 42) | (uint64_t(uint32_t(chunk.y) & 0x1FFFFFu) << 21) | uint64_t(uint32_t(chunk.z) & 0x1FFFFFu);
+}
+
+glm::ivec3 VoxelStreamer::getChunk(uint64_t key) {
+	auto axis = [key](int shift) { return int32_t(uint32_t(key >> shift & 0x1FFFFFu) << 11) >> 11; };
+	return glm::ivec3(axis(42), axis(21), axis(0));
+}
+
+bool VoxelStreamer::isInWindow(glm::ivec3 chunk) const {
+	const glm::ivec3 p = chunk - windowOrigin;
+	return p.x >= 0 && p.y >= 0 && p.z >= 0 && p.x < windowChunks.x && p.y < windowChunks.y && p.z < windowChunks.z;
+}
+
+size_t VoxelStreamer::getTableSize() const {
+	return sizeof(VoxelWorldGpuHeader) + (brickTable.size() + coarseTable.size()) * sizeof(uint32_t);
+}
+
+size_t VoxelStreamer::getGpuSize() const {
+	return getTableSize() + poolCapacity * BRICK_VOXELS;
+}
+
+size_t VoxelStreamer::getMinUploadBudget() const {
+	return getTableSize() + size_t(CHUNK_BRICK_COUNT) * BRICK_VOXELS;
+}
+
+size_t VoxelStreamer::getPoolOffset(uint32_t slot) const {
+	return getTableSize() + size_t(slot) * BRICK_VOXELS;
+}
+
+size_t VoxelStreamer::getPendingLoads() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return requests.size() + loading.size();
+}
+
+void VoxelStreamer::writeTables(void* dst) const {
+	const glm::ivec3 origin = windowOrigin == glm::ivec3(std::numeric_limits<int>::min()) ? glm::ivec3(0) : windowOrigin * CHUNK_SIZE;
+	const glm::ivec3 brickDims = windowChunks * CHUNK_BRICKS;
+	const glm::ivec3 coarseDims = windowChunks * (CHUNK_BRICKS / COARSE_BRICKS);
+
+	VoxelWorldGpuHeader header{};
+	header.origin[0] = origin.x;
+	header.origin[1] = origin.y;
+	header.origin[2] = origin.z;
+	header.outsideMaterial = VOXEL_EMPTY;
+	header.brickDims[0] = brickDims.x;
+	header.brickDims[1] = brickDims.y;
+	header.brickDims[2] = brickDims.z;
+	header.brickOffset = int32_t(brickTable.size() + coarseTable.size());
+	header.coarseDims[0] = coarseDims.x;
+	header.coarseDims[1] = coarseDims.y;
+	header.coarseDims[2] = coarseDims.z;
+	header.coarseOffset = int32_t(brickTable.size());
+
+	uint8_t* out = static_cast<uint8_t*>(dst);
+	memcpy(out, &header, sizeof(header));
+	out += sizeof(header);
+	memcpy(out, brickTable.data(), brickTable.size() * sizeof(uint32_t));
+	out += brickTable.size() * sizeof(uint32_t);
+	memcpy(out, coarseTable.data(), coarseTable.size() * sizeof(uint32_t));
+}
+
+bool VoxelStreamer::update(glm::vec3 cameraPos, size_t uploadBudget, const WriteFunc& write) {
+	++updateCount;
+	const glm::ivec3 cameraChunk = glm::ivec3(glm::floor(cameraPos / float(CHUNK_SIZE)));
+	const glm::ivec3 origin = cameraChunk - windowChunks / 2;
+	auto distanceTo = [&cameraPos](glm::ivec3 chunk) {
+		return glm::length((glm::vec3(chunk) + 0.5f) * float(CHUNK_SIZE) - cameraPos);
+	};
+
+	if (origin != windowOrigin) {
+		windowOrigin = origin;
+		tablesDirty = true;
+
+		// chunks without bricks only cost bookkeeping, the ones that left are dropped right away
+		for (auto it = resident.begin(); it != resident.end();) {
+			const glm::ivec3 chunk = getChunk(it->first);
+			if (it->second.bricks.empty() && !isInWindow(chunk))
+				it = resident.erase(it);
+			else
+				++it;
+		}
+
+		std::vector<glm::ivec3> wanted;
+		for (int z = 0; z < windowChunks.z; ++z)
+			for (int y = 0; y < windowChunks.y; ++y)
+				for (int x = 0; x < windowChunks.x; ++x)
+					if (resident.count(getKey(origin + glm::ivec3(x, y, z))) == 0)
+						wanted.push_back(origin + glm::ivec3(x, y, z));
+		std::sort(wanted.begin(), wanted.end(), [&](glm::ivec3 a, glm::ivec3 b) { return distanceTo(a) < distanceTo(b); });
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			requests.clear();
+			for (glm::ivec3 chunk : wanted)
+				if (loading.count(getKey(chunk)) == 0)
+					requests.push_back(chunk);
+		}
+		loaderWake.notify_one();
+	}
+
+	for (auto& [key, chunk] : resident)
+		if (isInWindow(getChunk(key)))
+			chunk.lastUsed = updateCount;
+
+	// the tables go up whenever anything changed, the rest of the budget is for bricks
+	size_t budget = uploadBudget > getTableSize() ? uploadBudget - getTableSize() : 0;
+	while (true) {
+		LoadedChunk loaded;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (results.empty())
+				break;
+			const size_t bytes = results.front().header ? size_t(results.front().header->brickCount) * BRICK_VOXELS : 0;
+			if (bytes > budget)
+				break;
+			loaded = std::move(results.front());
+			results.pop_front();
+			loading.erase(getKey(loaded.chunk));
+		}
+		loaderWake.notify_one();
+
+		// left the window while it was loading
+		if (!isInWindow(loaded.chunk))
+			continue;
+		// even a chunk that does not fit changes the window: it shows its coarse material from now on
+		makeResident(loaded, cameraPos, budget, write);
+		tablesDirty = true;
+	}
+
+	if (!tablesDirty)
+		return false;
+
+	rebuildTables();
+	std::vector<uint8_t> tables(getTableSize());
+	writeTables(tables.data());
+	write(0, tables.data(), tables.size());
+	tablesDirty = false;
+	return true;
+}
+
+bool VoxelStreamer::makeResident(const LoadedChunk& loaded, glm::vec3 cameraPos, size_t& budget, const WriteFunc& write) {
+	const uint64_t key = getKey(loaded.chunk);
+	const uint32_t brickCount = loaded.header ? loaded.header->brickCount : 0;
+	coarseMaterials[key] = loaded.header ? uint8_t(loaded.header->coarseMaterial) : uint8_t(VOXEL_EMPTY);
+
+	const float distance = glm::length((glm::vec3(loaded.chunk) + 0.5f) * float(CHUNK_SIZE) - cameraPos);
+	if (brickCount > freeBricks.size() && !evictFor(brickCount, distance, cameraPos))
+		return false; // stays coarse until the window moves
+
+	ResidentChunk chunk;
+	chunk.lastUsed = updateCount;
+	chunk.residentSince = updateCount;
+	if (loaded.header) {
+		chunk.bricks.resize(brickCount);
+		for (uint32_t& slot : chunk.bricks) {
+			slot = freeBricks.back();
+			freeBricks.pop_back();
+		}
+		chunk.table.assign(loaded.table, loaded.table + CHUNK_BRICK_COUNT);
+		for (uint32_t& entry : chunk.table)
+			if (!(entry & BRICK_UNIFORM))
+				entry = chunk.bricks[entry];
+
+		// bricks in consecutive slots go up in a single write
+		for (uint32_t first = 0; first < brickCount;) {
+			uint32_t last = first + 1;
+			while (last < brickCount && chunk.bricks[last] == chunk.bricks[last - 1] + 1)
+				++last;
+			write(getPoolOffset(chunk.bricks[first]), loaded.bricks + size_t(first) * BRICK_VOXELS, size_t(last - first) * BRICK_VOXELS);
+			first = last;
+		}
+		budget -= size_t(brickCount) * BRICK_VOXELS;
+	}
+	resident[key] = std::move(chunk);
+	return true;
+}
+
+bool VoxelStreamer::evictFor(size_t brickCount, float distance, glm::vec3 cameraPos) {
+	while (freeBricks.size() < brickCount) {
+		// chunks that left the window go first, least recently used first; then chunks in the window
+		// farther away than the new one, farthest first
+		auto victim = resident.end();
+		bool victimInWindow = true;
+		float victimDistance = distance;
+		for (auto it = resident.begin(); it != resident.end(); ++it) {
+			// slots written in this update are not reused before it went up, the copies of one update never overlap
+			if (it->second.bricks.empty() || it->second.residentSince == updateCount)
+				continue;
+			const glm::ivec3 chunk = getChunk(it->first);
+			const bool inWindow = isInWindow(chunk);
+			const float chunkDistance = glm::length((glm::vec3(chunk) + 0.5f) * float(CHUNK_SIZE) - cameraPos);
+			bool better;
+			if (inWindow != victimInWindow)
+				better = !inWindow;
+			else if (!inWindow)
+				better = victim == resident.end() || it->second.lastUsed < victim->second.lastUsed;
+			else
+				better = chunkDistance > victimDistance;
+			if (better) {
+				victim = it;
+				victimInWindow = inWindow;
+				victimDistance = chunkDistance;
+			}
+		}
+		if (victim == resident.end())
+			return false;
+
+		freeBricks.insert(freeBricks.end(), victim->second.bricks.rbegin(), victim->second.bricks.rend());
+		if (victimInWindow)
+			tablesDirty = true;
+		resident.erase(victim);
+		++evictions;
+	}
+	return true;
+}
+
+void VoxelStreamer::rebuildTables() {
+	const glm::ivec3 brickDims = windowChunks * CHUNK_BRICKS;
+	const glm::ivec3 coarseDims = windowChunks * (CHUNK_BRICKS / COARSE_BRICKS);
+
+	for (int cz = 0; cz < windowChunks.z; ++cz) {
+		for (int cy = 0; cy < windowChunks.y; ++cy) {
+			for (int cx = 0; cx < windowChunks.x; ++cx) {
+				const uint64_t key = getKey(windowOrigin + glm::ivec3(cx, cy, cz));
+				const auto it = resident.find(key);
+				const uint32_t* table = it != resident.end() && !it->second.table.empty() ? it->second.table.data() : nullptr;
+				uint32_t uniform = BRICK_UNIFORM | VOXEL_EMPTY;
+				if (it == resident.end()) {
+					const auto coarse = coarseMaterials.find(key);
+					if (coarse != coarseMaterials.end())
+						uniform = BRICK_UNIFORM | coarse->second;
+				}
+
+				for (int bz = 0; bz < CHUNK_BRICKS; ++bz) {
+					for (int by = 0; by < CHUNK_BRICKS; ++by) {
+						const size_t row = (size_t(cz * CHUNK_BRICKS + bz) * brickDims.y + cy * CHUNK_BRICKS + by) * brickDims.x + cx * CHUNK_BRICKS;
+						for (int bx = 0; bx < CHUNK_BRICKS; ++bx)
+							brickTable[row + bx] = table ? table[(bz * CHUNK_BRICKS + by) * CHUNK_BRICKS + bx] : uniform;
+					}
+				}
+			}
+		}
+	}
+
+	for (int z = 0; z < coarseDims.z; ++z) {
+		for (int y = 0; y < coarseDims.y; ++y) {
+			for (int x = 0; x < coarseDims.x; ++x) {
+				bool empty = true;
+				for (int bz = z * COARSE_BRICKS; bz < (z + 1) * COARSE_BRICKS && empty; ++bz)
+					for (int by = y * COARSE_BRICKS; by < (y + 1) * COARSE_BRICKS && empty; ++by)
+						for (int bx = x * COARSE_BRICKS; bx < (x + 1) * COARSE_BRICKS && empty; ++bx)
+							empty = brickTable[(size_t(bz) * brickDims.y + by) * brickDims.x + bx] == (BRICK_UNIFORM | VOXEL_EMPTY);
+				coarseTable[(size_t(z) * coarseDims.y + y) * coarseDims.x + x] = empty ? 1 : 0;
+			}
+		}
+	}
+}
+
+void VoxelStreamer::loaderLoop() {
+	while (true) {
+		glm::ivec3 chunk;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			loaderWake.wait(lock, [this]() { return stopping || (!requests.empty() && results.size() < MAX_LOADED_CHUNKS); });
+			if (stopping)
+				return;
+			chunk = requests.front();
+			requests.pop_front();
+			loading.insert(getKey(chunk));
+		}
+
+		LoadedChunk loaded = load(chunk);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			results.push_back(std::move(loaded));
+		}
+	}
+}
+
+VoxelStreamer::LoadedChunk VoxelStreamer::load(glm::ivec3 chunk) const {
+	LoadedChunk loaded;
+	loaded.chunk = chunk;
+	const std::string fileName = getChunkFileName(directory, chunk);
+	std::error_code error;
+	if (!std::filesystem::exists(fileName, error))
+		return loaded; // nothing was ever written there
+
+	try {
+		std::unique_ptr<MappedFile> file(new MappedFile(fileName));
+		const size_t tableOffset = sizeof(ChunkFileHeader);
+		const size_t brickOffset = tableOffset + CHUNK_BRICK_COUNT * sizeof(uint32_t);
+		const ChunkFileHeader* header = reinterpret_cast<const ChunkFileHeader*>(file->data());
+		if (file->size() < brickOffset || memcmp(header->magic, CHUNK_MAGIC, 4) != 0 || header->version != CHUNK_VERSION
+			|| glm::ivec3(header->chunk[0], header->chunk[1], header->chunk[2]) != chunk
+			|| file->size() != brickOffset + size_t(header->brickCount) * BRICK_VOXELS)
+			throw std::runtime_error(fileName + " is not a valid chunk file!");
+
+		const uint32_t* table = reinterpret_cast<const uint32_t*>(file->data() + tableOffset);
+		for (int i = 0; i < CHUNK_BRICK_COUNT; ++i)
+			if (!(table[i] & BRICK_UNIFORM) && table[i] >= header->brickCount)
+				throw std::runtime_error(fileName + " refers to a brick it does not have!");
+
+		// fault the bricks in here, the render thread copies them out of the mapping
+		file->prefetch(brickOffset, size_t(header->brickCount) * BRICK_VOXELS);
+		volatile uint8_t touch = 0;
+		for (size_t offset = brickOffset; offset < file->size(); offset += 4096)
+			touch = touch + file->data()[offset];
+
+		loaded.header = header;
+		loaded.table = table;
+		loaded.bricks = file->data() + brickOffset;
+		loaded.file = std::move(file);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << " Treating the chunk as empty." << std::endl;
+	}
+	return loaded;
+}
+
+std::string VoxelStreamer::getChunkFileName(const std::string& directory, glm::ivec3 chunk) {
+	return directory + "/chunk_" + std::to_string(chunk.x) + "_" + std::to_string(chunk.y) + "_" + std::to_string(chunk.z) + ".bin";
+}
+
+// bricks the chunk from the material function, nothing is written for empty chunks
+template<typename Func>
+static bool writeChunkFile(const std::string& directory, glm::ivec3 chunk, Func getMaterial) {
+	std::vector<uint32_t> table(CHUNK_BRICK_COUNT);
+	std::vector<uint8_t> bricks;
+	size_t counts[256] = {};
+	uint8_t voxels[BRICK_VOXELS];
+	const glm::ivec3 base = chunk * CHUNK_SIZE;
+
+	for (int bz = 0; bz < CHUNK_BRICKS; ++bz) {
+		for (int by = 0; by < CHUNK_BRICKS; ++by) {
+			for (int bx = 0; bx < CHUNK_BRICKS; ++bx) {
+				const glm::ivec3 brick = base + glm::ivec3(bx, by, bz) * BRICK_SIZE;
+				for (int z = 0; z < BRICK_SIZE; ++z)
+					for (int y = 0; y < BRICK_SIZE; ++y)
+						for (int x = 0; x < BRICK_SIZE; ++x)
+							voxels[(z * BRICK_SIZE + y) * BRICK_SIZE + x] = uint8_t(getMaterial(brick + glm::ivec3(x, y, z)));
+				for (uint8_t m : voxels)
+					++counts[m];
+
+				uint32_t& entry = table[(bz * CHUNK_BRICKS + by) * CHUNK_BRICKS + bx];
+				if (std::all_of(voxels, voxels + BRICK_VOXELS, [&voxels](uint8_t m) { return m == voxels[0]; })) {
+					entry = BRICK_UNIFORM | voxels[0];
+				}
+				else {
+					entry = uint32_t(bricks.size() / BRICK_VOXELS);
+					bricks.insert(bricks.end(), voxels, voxels + BRICK_VOXELS);
+				}
+			}
+		}
+	}
+	if (counts[VOXEL_EMPTY] == size_t(CHUNK_BRICK_COUNT) * BRICK_VOXELS)
+		return false;
+
+	ChunkFileHeader header{};
+	memcpy(header.magic, CHUNK_MAGIC, 4);
+	header.version = CHUNK_VERSION;
+	header.chunk[0] = chunk.x;
+	header.chunk[1] = chunk.y;
+	header.chunk[2] = chunk.z;
+	header.coarseMaterial = uint32_t(std::max_element(counts, counts + 256) - counts);
+	header.brickCount = uint32_t(bricks.size() / BRICK_VOXELS);
+
+	const std::string fileName = VoxelStreamer::getChunkFileName(directory, chunk);
+	std::ofstream file(fileName, std::ios::binary | std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+		throw std::runtime_error("Could not open file " + fileName + "!");
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(uint32_t));
+	file.write(reinterpret_cast<const char*>(bricks.data()), bricks.size());
+	if (!file)
+		throw std::runtime_error("Could not write to " + fileName + "!");
+	return true;
+}
+
+void VoxelStreamer::writeChunks(const VoxelWorld& world, const std::string& directory) {
+	std::filesystem::create_directories(directory);
+	const glm::ivec3 first = world.getOrigin();
+	const glm::ivec3 last = first + world.getVoxelDims() - 1;
+	const glm::ivec3 chunkMin(floorDiv(first.x, CHUNK_SIZE), floorDiv(first.y, CHUNK_SIZE), floorDiv(first.z, CHUNK_SIZE));
+	const glm::ivec3 chunkMax(floorDiv(last.x, CHUNK_SIZE), floorDiv(last.y, CHUNK_SIZE), floorDiv(last.z, CHUNK_SIZE));
+
+	size_t written = 0;
+	for (int z = chunkMin.z; z <= chunkMax.z; ++z)
+		for (int y = chunkMin.y; y <= chunkMax.y; ++y)
+			for (int x = chunkMin.x; x <= chunkMax.x; ++x)
+				written += writeChunkFile(directory, glm::ivec3(x, y, z), [&world](glm::ivec3 c) { return world.get(c); });
+	std::cout << "Wrote " << written << " chunks to " << directory << std::endl;
+}
+
+void VoxelStreamer::generateTerrain(const std::string& directory, int chunks) {
+	std::filesystem::create_directories(directory);
+	const int waterLevel = -12;
+	const int minChunkY = -1, maxChunkY = 0; // heights stay within [-64, 64)
+
+	std::vector<float> heights(CHUNK_SIZE * CHUNK_SIZE);
+	size_t written = 0;
+	for (int cz = -chunks / 2; cz < chunks - chunks / 2; ++cz) {
+		for (int cx = -chunks / 2; cx < chunks - chunks / 2; ++cx) {
+			// long hills with ridges and small bumps on top, lakes below the water level
+			for (int z = 0; z < CHUNK_SIZE; ++z) {
+				for (int x = 0; x < CHUNK_SIZE; ++x) {
+					const float wx = float(cx * CHUNK_SIZE + x), wz = float(cz * CHUNK_SIZE + z);
+					heights[z * CHUNK_SIZE + x] = -8.0f + 24.0f * std::sin(wx * 0.0031f) * std::cos(wz * 0.0027f)
+						+ 10.0f * std::sin(wx * 0.013f + wz * 0.007f) + 4.0f * std::sin(wx * 0.05f) * std::cos(wz * 0.043f);
+				}
+			}
+
+			for (int cy = minChunkY; cy <= maxChunkY; ++cy) {
+				const glm::ivec3 chunk(cx, cy, cz);
+				written += writeChunkFile(directory, chunk, [&](glm::ivec3 c) {
+					const float height = heights[(c.z - cz * CHUNK_SIZE) * CHUNK_SIZE + c.x - cx * CHUNK_SIZE];
+					return c.y < height ? VOXEL_SOLID : c.y < waterLevel ? VOXEL_WATER : VOXEL_EMPTY;
+				});
+			}
+		}
+		std::cout << "\rGenerated " << (cz + chunks / 2 + 1) * chunks << "/" << chunks * chunks << " columns" << std::flush;
+	}
+	std::cout << std::endl << "Wrote " << written << " chunks to " << directory << std::endl;
+}
@@ -0,0 +1,426 @@
+#include "VoxelWorld.h"
+#include "VoxelFile.h"
+#include "MagicaVoxel.h"
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <limits>
+
+VoxelWorld::VoxelWorld(glm::ivec3 origin, glm::ivec3 brickDims, VoxelMaterial outside) :
+	origin(origin), brickDims(brickDims), coarseDims((brickDims + COARSE_BRICKS - 1) / COARSE_BRICKS), outside(outside)
+{
+	if (brickDims.x <= 0 || brickDims.y <= 0 || brickDims.z <= 0)
+		throw std::runtime_error("VoxelWorld needs at least one brick in every dimension!");
+
+	brickTable.resize(size_t(brickDims.x) * brickDims.y * brickDims.z, BRICK_UNIFORM | VOXEL_EMPTY);
+	coarseTable.resize(size_t(coarseDims.x) * coarseDims.y * coarseDims.z, 0);
+	brickDirty.resize(brickTable.size(), false);
+	updateCoarseLevel();
+}
+
+VoxelWorld::~VoxelWorld() {
+
+}
+
+void VoxelWorld::set(glm::ivec3 c, VoxelMaterial material) {
+	const glm::ivec3 p = c - origin;
+	const glm::ivec3 brick = p >> BRICK_SIZE_LOG2;
+	if (p.x < 0 || p.y < 0 || p.z < 0 || brick.x >= brickDims.x || brick.y >= brickDims.y || brick.z >= brickDims.z)
+		throw std::runtime_error("Voxel outside of the world!");
+
+	if (material != VOXEL_EMPTY)
+		coarseTable[getCoarseIndex(brick >> COARSE_BRICKS_LOG2)] = 0;
+
+	const size_t index = getBrickIndex(brick);
+	uint32_t& entry = brickTable[index];
+	if (entry & BRICK_UNIFORM) {
+		if (VoxelMaterial(entry & 0xff) == material)
+			return; // nothing changes
+
+		// give the brick its own storage, filled with its former material; slots freed by edits go first
+		const uint8_t former = uint8_t(entry & 0xff);
+		if (!freeBricks.empty()) {
+			entry = freeBricks.back();
+			freeBricks.pop_back();
+			std::fill_n(&brickPool[size_t(entry) * BRICK_VOXELS], BRICK_VOXELS, former);
+		}
+		else {
+			entry = uint32_t(getBrickCount());
+			brickPool.resize(brickPool.size() + BRICK_VOXELS, former);
+		}
+	}
+
+	const glm::ivec3 v = p & (BRICK_SIZE - 1);
+	uint8_t& voxel = brickPool[size_t(entry) * BRICK_VOXELS + (v.z * BRICK_SIZE + v.y) * BRICK_SIZE + v.x];
+	if (voxel == material)
+		return;
+	voxel = material;
+	markDirty(index);
+}
+
+template<typename Inside, typename Covers>
+void VoxelWorld::fillRegion(glm::ivec3 min, glm::ivec3 max, VoxelMaterial material, Inside inside, Covers covers) {
+	min = glm::max(min, origin);
+	max = glm::min(max, origin + getVoxelDims() - 1);
+	if (max.x < min.x || max.y < min.y || max.z < min.z)
+		return;
+
+	const glm::ivec3 first = (min - origin) >> BRICK_SIZE_LOG2, last = (max - origin) >> BRICK_SIZE_LOG2;
+	for (int bz = first.z; bz <= last.z; ++bz) {
+		for (int by = first.y; by <= last.y; ++by) {
+			for (int bx = first.x; bx <= last.x; ++bx) {
+				const glm::ivec3 brick(bx, by, bz);
+				const glm::ivec3 brickMin = origin + brick * BRICK_SIZE, brickMax = brickMin + BRICK_SIZE - 1;
+				const glm::ivec3 from = glm::max(min, brickMin), to = glm::min(max, brickMax);
+				if (from != brickMin || to != brickMax || !covers(brickMin, brickMax)) {
+					for (int z = from.z; z <= to.z; ++z)
+						for (int y = from.y; y <= to.y; ++y)
+							for (int x = from.x; x <= to.x; ++x)
+								if (inside(glm::ivec3(x, y, z)))
+									set(glm::ivec3(x, y, z), material);
+					continue;
+				}
+
+				if (material != VOXEL_EMPTY)
+					coarseTable[getCoarseIndex(brick >> COARSE_BRICKS_LOG2)] = 0;
+				const size_t index = getBrickIndex(brick);
+				uint32_t& entry = brickTable[index];
+				if (entry & BRICK_UNIFORM) {
+					if (entry != (BRICK_UNIFORM | material)) {
+						entry = BRICK_UNIFORM | material;
+						markDirty(index);
+					}
+				}
+				else {
+					// the GPU copy uses the slot until the brick is flushed, it collapses and frees the slot there
+					std::fill_n(&brickPool[size_t(entry) * BRICK_VOXELS], BRICK_VOXELS, uint8_t(material));
+					markDirty(index);
+				}
+			}
+		}
+	}
+}
+
+void VoxelWorld::fill(glm::ivec3 min, glm::ivec3 max, VoxelMaterial material) {
+	fillRegion(min, max, material, [](glm::ivec3) { return true; }, [](glm::ivec3, glm::ivec3) { return true; });
+}
+
+void VoxelWorld::fillSphere(glm::vec3 center, float radius, VoxelMaterial material) {
+	const float radius2 = radius * radius;
+	auto distance2 = [center](glm::vec3 p) { return glm::dot(p - center, p - center); };
+	fillRegion(glm::ivec3(glm::floor(center - radius)), glm::ivec3(glm::floor(center + radius)), material,
+		[&](glm::ivec3 c) { return distance2(glm::vec3(c) + 0.5f) <= radius2; },
+		[&](glm::ivec3 brickMin, glm::ivec3 brickMax) {
+			// the voxel center farthest from the sphere's
+			const glm::vec3 far = glm::max(glm::abs(glm::vec3(brickMin) + 0.5f - center), glm::abs(glm::vec3(brickMax) + 0.5f - center));
+			return glm::dot(far, far) <= radius2;
+		});
+}
+
+bool VoxelWorld::raycast(glm::vec3 rayOrigin, glm::vec3 dir, float maxDistance, glm::ivec3& hit, glm::ivec3& previous) const {
+	// voxel by voxel, side holds the distance to the next boundary along each axis
+	glm::ivec3 voxel = glm::ivec3(glm::floor(rayOrigin));
+	const glm::vec3 step = glm::sign(dir);
+	const glm::vec3 delta = glm::abs(1.0f / dir);
+	glm::vec3 side = (step * (glm::vec3(voxel) - rayOrigin) + step * 0.5f + 0.5f) * delta;
+	previous = voxel;
+	float distance = 0.0f;
+	while (distance <= maxDistance) {
+		if (get(voxel) != VOXEL_EMPTY) {
+			hit = voxel;
+			return true;
+		}
+		previous = voxel;
+		const int axis = side.x < side.y ? (side.x < side.z ? 0 : 2) : (side.y < side.z ? 1 : 2);
+		distance = side[axis];
+		side[axis] += delta[axis];
+		voxel[axis] += int(step[axis]);
+	}
+	return false;
+}
+
+void VoxelWorld::markDirty(size_t brickIndex) {
+	if (brickDirty[brickIndex])
+		return;
+	brickDirty[brickIndex] = true;
+	dirtyBricks.push_back(uint32_t(brickIndex));
+}
+
+void VoxelWorld::clearEdits() {
+	for (uint32_t index : dirtyBricks)
+		brickDirty[index] = false;
+	dirtyBricks.clear();
+	fullUploadNeeded = false;
+}
+
+namespace {
+
+// writes the items at the sorted indices, neighbours with a single call
+void writeRuns(const std::vector<uint32_t>& indices, size_t offset, const void* items, size_t itemSize, const GpuWriteFunc& write) {
+	for (size_t i = 0; i < indices.size();) {
+		size_t j = i + 1;
+		while (j < indices.size() && indices[j] == indices[j - 1] + 1)
+			++j;
+		write(offset + indices[i] * itemSize, static_cast<const uint8_t*>(items) + indices[i] * itemSize, (j - i) * itemSize);
+		i = j;
+	}
+}
+
+}
+
+size_t VoxelWorld::flushEdits(size_t budget, const GpuWriteFunc& write, glm::ivec3& boundsMin, glm::ivec3& boundsMax) {
+	// a table entry, the brick and its coarse cell at most
+	const size_t brickCost = 2 * sizeof(uint32_t) + BRICK_VOXELS;
+	const size_t count = std::min(dirtyBricks.size(), budget / brickCost);
+	if (count == 0)
+		return 0;
+
+	std::vector<uint32_t> flushed(dirtyBricks.begin(), dirtyBricks.begin() + count);
+	dirtyBricks.erase(dirtyBricks.begin(), dirtyBricks.begin() + count);
+	std::sort(flushed.begin(), flushed.end());
+
+	std::vector<uint32_t> slots, cells;
+	boundsMin = glm::ivec3(std::numeric_limits<int>::max());
+	boundsMax = glm::ivec3(std::numeric_limits<int>::min());
+	for (uint32_t index : flushed) {
+		brickDirty[index] = false;
+		uint32_t& entry = brickTable[index];
+		if (!(entry & BRICK_UNIFORM)) {
+			const uint8_t* voxels = &brickPool[size_t(entry) * BRICK_VOXELS];
+			if (std::all_of(voxels, voxels + BRICK_VOXELS, [voxels](uint8_t m) { return m == voxels[0]; })) {
+				freeBricks.push_back(entry);
+				entry = BRICK_UNIFORM | voxels[0];
+			}
+			else {
+				slots.push_back(entry);
+			}
+		}
+
+		const glm::ivec3 brick(int(index % brickDims.x), int(index / brickDims.x % brickDims.y), int(index / brickDims.x / brickDims.y));
+		boundsMin = glm::min(boundsMin, origin + brick * BRICK_SIZE);
+		boundsMax = glm::max(boundsMax, origin + (brick + 1) * BRICK_SIZE);
+		cells.push_back(uint32_t(getCoarseIndex(brick >> COARSE_BRICKS_LOG2)));
+	}
+	std::sort(slots.begin(), slots.end());
+	std::sort(cells.begin(), cells.end());
+	cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+	// a cell is only flagged empty if the bricks still waiting are empty as well, skipping them early shows the edit
+	for (uint32_t cell : cells) {
+		const glm::ivec3 c(int(cell % coarseDims.x), int(cell / coarseDims.x % coarseDims.y), int(cell / coarseDims.x / coarseDims.y));
+		coarseTable[cell] = isCoarseCellEmpty(c) ? 1 : 0;
+	}
+
+	const size_t tableOffset = sizeof(VoxelWorldGpuHeader);
+	const size_t coarseOffset = tableOffset + brickTable.size() * sizeof(uint32_t);
+	const size_t poolOffset = coarseOffset + coarseTable.size() * sizeof(uint32_t);
+	writeRuns(flushed, tableOffset, brickTable.data(), sizeof(uint32_t), write);
+	writeRuns(slots, poolOffset, brickPool.data(), BRICK_VOXELS, write);
+	writeRuns(cells, coarseOffset, coarseTable.data(), sizeof(uint32_t), write);
+	return count;
+}
+
+void VoxelWorld::compact() {
+	std::vector<uint8_t> pool;
+	pool.reserve(brickPool.size());
+
+	for (uint32_t& entry : brickTable) {
+		if (entry & BRICK_UNIFORM)
+			continue;
+
+		const uint8_t* voxels = &brickPool[size_t(entry) * BRICK_VOXELS];
+		if (std::all_of(voxels, voxels + BRICK_VOXELS, [voxels](uint8_t m) { return m == voxels[0]; })) {
+			entry = BRICK_UNIFORM | voxels[0];
+		}
+		else {
+			const uint32_t brickNr = uint32_t(pool.size() / BRICK_VOXELS);
+			pool.insert(pool.end(), voxels, voxels + BRICK_VOXELS);
+			entry = brickNr;
+		}
+	}
+
+	brickPool = std::move(pool);
+	updateCoarseLevel();
+
+	// the slots moved, the GPU copy has to be written anew
+	for (uint32_t index : dirtyBricks)
+		brickDirty[index] = false;
+	dirtyBricks.clear();
+	freeBricks.clear();
+	fullUploadNeeded = true;
+}
+
+void VoxelWorld::updateCoarseLevel() {
+	for (int z = 0; z < coarseDims.z; ++z)
+		for (int y = 0; y < coarseDims.y; ++y)
+			for (int x = 0; x < coarseDims.x; ++x)
+				coarseTable[getCoarseIndex(glm::ivec3(x, y, z))] = isCoarseCellEmpty(glm::ivec3(x, y, z)) ? 1 : 0;
+}
+
+bool VoxelWorld::isCoarseCellEmpty(glm::ivec3 cell) const {
+	// bricks beyond the world border are made of the outside material
+	for (int bz = cell.z * COARSE_BRICKS; bz < (cell.z + 1) * COARSE_BRICKS; ++bz) {
+		for (int by = cell.y * COARSE_BRICKS; by < (cell.y + 1) * COARSE_BRICKS; ++by) {
+			for (int bx = cell.x * COARSE_BRICKS; bx < (cell.x + 1) * COARSE_BRICKS; ++bx) {
+				const bool empty = bx >= brickDims.x || by >= brickDims.y || bz >= brickDims.z ? outside == VOXEL_EMPTY
+					: brickTable[getBrickIndex(glm::ivec3(bx, by, bz))] == (BRICK_UNIFORM | VOXEL_EMPTY);
+				if (!empty)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+size_t VoxelWorld::getGpuSize() const {
+	return sizeof(VoxelWorldGpuHeader) + (brickTable.size() + coarseTable.size()) * sizeof(uint32_t) + brickPool.size();
+}
+
+void VoxelWorld::writeGpuData(void* dst) const {
+	VoxelWorldGpuHeader header{};
+	header.origin[0] = origin.x;
+	header.origin[1] = origin.y;
+	header.origin[2] = origin.z;
+	header.outsideMaterial = outside;
+	header.brickDims[0] = brickDims.x;
+	header.brickDims[1] = brickDims.y;
+	header.brickDims[2] = brickDims.z;
+	header.brickOffset = int32_t(brickTable.size() + coarseTable.size());
+	header.coarseDims[0] = coarseDims.x;
+	header.coarseDims[1] = coarseDims.y;
+	header.coarseDims[2] = coarseDims.z;
+	header.coarseOffset = int32_t(brickTable.size());
+
+	// a brick is 128 uints with 4 voxels each, the first voxel in the lowest byte (little endian)
+	uint8_t* out = static_cast<uint8_t*>(dst);
+	memcpy(out, &header, sizeof(header));
+	out += sizeof(header);
+	memcpy(out, brickTable.data(), brickTable.size() * sizeof(uint32_t));
+	out += brickTable.size() * sizeof(uint32_t);
+	memcpy(out, coarseTable.data(), coarseTable.size() * sizeof(uint32_t));
+	out += coarseTable.size() * sizeof(uint32_t);
+	memcpy(out, brickPool.data(), brickPool.size());
+}
+
+VoxelWorld VoxelWorld::fromGpuData(const void* src, size_t size) {
+	if (size < sizeof(VoxelWorldGpuHeader))
+		throw std::runtime_error("Voxel data too small for its header!");
+	VoxelWorldGpuHeader header;
+	memcpy(&header, src, sizeof(header));
+
+	VoxelWorld world(glm::ivec3(header.origin[0], header.origin[1], header.origin[2]), glm::ivec3(header.brickDims[0], header.brickDims[1], header.brickDims[2]),
+		VoxelMaterial(header.outsideMaterial));
+	const size_t tableSize = (world.brickTable.size() + world.coarseTable.size()) * sizeof(uint32_t);
+	if (glm::ivec3(header.coarseDims[0], header.coarseDims[1], header.coarseDims[2]) != world.coarseDims || size_t(header.coarseOffset) != world.brickTable.size()
+		|| size_t(header.brickOffset) * sizeof(uint32_t) != tableSize || size < sizeof(header) + tableSize || (size - sizeof(header) - tableSize) % BRICK_VOXELS != 0)
+		throw std::runtime_error("Voxel data does not match its header!");
+
+	const uint8_t* in = static_cast<const uint8_t*>(src) + sizeof(header);
+	memcpy(world.brickTable.data(), in, world.brickTable.size() * sizeof(uint32_t));
+	in += world.brickTable.size() * sizeof(uint32_t);
+	memcpy(world.coarseTable.data(), in, world.coarseTable.size() * sizeof(uint32_t));
+	in += world.coarseTable.size() * sizeof(uint32_t);
+	world.brickPool.assign(in, static_cast<const uint8_t*>(src) + size);
+	for (uint32_t entry : world.brickTable)
+		if (!(entry & BRICK_UNIFORM) && entry >= world.getBrickCount())
+			throw std::runtime_error("Voxel data refers to a brick it does not have!");
+	return world;
+}
+
+VoxelWorld VoxelWorld::createDefaultScene() {
+	auto sdSphere = [](glm::vec3 p, float d) { return glm::length(p) - d; };
+	auto sdBox = [](glm::vec3 p, glm::vec3 b) {
+		glm::vec3 d = glm::abs(p) - b;
+		return std::min(std::max(d.x, std::max(d.y, d.z)), 0.0f) + glm::length(glm::max(d, 0.0f));
+	};
+
+	// the cavity has a radius of 25 voxels, everything beyond is solid rock
+	VoxelWorld world(glm::ivec3(-32), glm::ivec3(8), VOXEL_SOLID);
+	const glm::ivec3 dims = world.getVoxelDims();
+	for (int z = 0; z < dims.z; ++z) {
+		for (int y = 0; y < dims.y; ++y) {
+			for (int x = 0; x < dims.x; ++x) {
+				const glm::ivec3 c = world.origin + glm::ivec3(x, y, z);
+				const glm::vec3 p = glm::vec3(c) + glm::vec3(0.5f);
+				const float water = std::max(-sdSphere(p, 3.5f), sdBox(p, glm::vec3(6.0f)));
+				const float solid = std::min(water, -sdSphere(p, 25.0f));
+				world.set(c, water < 0.0f ? VOXEL_WATER : solid < 0.0f ? VOXEL_SOLID : VOXEL_EMPTY);
+			}
+		}
+	}
+	world.compact();
+
+	return world;
+}
+
+VoxelWorld VoxelWorld::createTerrainScene() {
+	VoxelWorld world(glm::ivec3(-128, -32, -128), glm::ivec3(32, 8, 32), VOXEL_EMPTY);
+	const glm::ivec3 dims = world.getVoxelDims();
+	const int waterLevel = -22;
+	for (int z = 0; z < dims.z; ++z) {
+		for (int x = 0; x < dims.x; ++x) {
+			const glm::ivec2 c = glm::ivec2(world.origin.x, world.origin.z) + glm::ivec2(x, z);
+			const float height = -20.0f + 8.0f * std::sin(c.x * 0.05f) * std::cos(c.y * 0.07f) + 4.0f * std::sin((c.x + c.y) * 0.11f);
+			for (int y = world.origin.y; y < std::max(int(std::floor(height)), waterLevel); ++y)
+				world.set(glm::ivec3(c.x, y, c.y), y < height ? VOXEL_SOLID : VOXEL_WATER);
+		}
+	}
+	world.compact();
+
+	return world;
+}
+
+VoxelWorld VoxelWorld::createSparseScene() {
+	VoxelWorld world(glm::ivec3(-128), glm::ivec3(32), VOXEL_EMPTY);
+	const glm::ivec3 dims = world.getVoxelDims();
+	const int floor = -64;
+	for (int z = world.origin.z; z < world.origin.z + dims.z; ++z)
+		for (int x = world.origin.x; x < world.origin.x + dims.x; ++x)
+			for (int y = floor - 4; y < floor; ++y)
+				world.set(glm::ivec3(x, y, z), VOXEL_SOLID);
+
+	// 4x4 pillars every 32 voxels, keeping clear of the center where the benchmark camera flies
+	const int spacing = 32;
+	for (int pz = world.origin.z + 14; pz < world.origin.z + dims.z; pz += spacing) {
+		for (int px = world.origin.x + 14; px < world.origin.x + dims.x; px += spacing) {
+			if (px * px + pz * pz < 24 * 24)
+				continue;
+			const uint32_t hash = uint32_t(px) * 73856093u ^ uint32_t(pz) * 19349663u;
+			const int height = 8 + int(hash % 150u);
+			const VoxelMaterial material = hash & 0x100u ? VOXEL_WATER : VOXEL_SOLID;
+			for (int y = floor; y < std::min(floor + height, world.origin.y + dims.y); ++y)
+				for (int z = pz; z < pz + 4; ++z)
+					for (int x = px; x < px + 4; ++x)
+						world.set(glm::ivec3(x, y, z), material);
+		}
+	}
+	world.compact();
+
+	return world;
+}
+
+VoxelWorld VoxelWorld::createScene(const std::string& preset) {
+	if (preset == "default")
+		return createDefaultScene();
+	if (preset == "terrain")
+		return createTerrainScene();
+	if (preset == "sparse")
+		return createSparseScene();
+	if (isSceneFile(preset, ".gvox"))
+		return VoxelFile(preset).createWorld();
+	if (isSceneFile(preset, ".vox"))
+		return importMagicaVoxel(preset);
+	throw std::runtime_error("Unknown scene preset " + preset + "!");
+}
+
+bool VoxelWorld::isSceneFile(const std::string& name, const char* extension) {
+	const size_t length = strlen(extension);
+	return name.size() > length && name.compare(name.size() - length, length, extension) == 0;
+}
+
+const std::vector<std::string>& VoxelWorld::getScenePresets() {
+	static const std::vector<std::string> presets = { "default", "terrain", "sparse" };
+	return presets;
+}
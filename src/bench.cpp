@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+
+#include "Renderer.h"
+#include "CpuTracer.h"
+#include "CameraPath.h"
+#include "ImageIO.h"
+#include "FrameRecorder.h"
+
+// grayv-bench: replays a camera path through a scene preset with fixed settings and seed,
+// so runs can be compared across commits and devices
+
+struct BenchOptions {
+	std::string scene = "default";
+	std::string pathFile;               // empty: orbit around the center
+	uint32_t width = 1280, height = 720;
+	int warmup = 16;
+	int frames = 128;
+	int seed = 1;
+	TraceSettings settings;
+	QualityTier quality = QualityTier::CUSTOM;  // replaces settings unless CUSTOM
+	SamplerType sampler = SamplerType::SOBOL;
+	bool cpu = false;
+	bool simd = true;
+	TracePath tracePath = TracePath::FRAGMENT;
+	glm::uvec2 workgroup{ 8, 8 };
+	uint32_t framesInFlight = 2;
+	float renderScale = 1.0f;
+	uint32_t interleave = 1;
+	uint32_t denoise = 0;
+	std::string output;                 // last measured frame
+	std::string timings;                // per frame timings of the measured frames
+	std::string capture;                // every measured frame, to see what recording costs
+};
+
+// the settings the tracers run with: the tier's when one is chosen, the GPU compiles them in
+static const TraceSettings& getBenchSettings(const BenchOptions& options)
+{
+	return options.quality != QualityTier::CUSTOM ? getQualityTierInfo(options.quality).settings : options.settings;
+}
+
+// nearest rank percentile of sorted values
+static double percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty())
+		return 0.0;
+	const size_t rank = size_t(std::ceil(p / 100.0 * sorted.size()));
+	return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+static void report(const std::string& label, std::vector<double> times_ms, double raysPerFrame)
+{
+	if (times_ms.empty())
+		return;
+	std::sort(times_ms.begin(), times_ms.end());
+	double sum = 0.0;
+	for (double t : times_ms)
+		sum += t;
+	const double mean = sum / times_ms.size();
+
+	char line[256];
+	snprintf(line, sizeof(line), "%-10s mean %8.3f ms  p50 %8.3f ms  p99 %8.3f ms  %8.2f Mrays/s", label.c_str(),
+		mean, percentile(times_ms, 50.0), percentile(times_ms, 99.0), raysPerFrame / (mean * 1e-3) * 1e-6);
+	std::cout << line << std::endl;
+}
+
+// time of measured frame i, the path is sampled evenly from start to end
+static float pathTime(const CameraPath& path, int frame, int frames)
+{
+	return path.getStartTime() + (frames > 1 ? path.getDuration() * frame / (frames - 1) : 0.0f);
+}
+
+static int benchGpu(const BenchOptions& options, const VoxelWorld& world, const CameraPath& path)
+{
+	Camera cam;
+	cam.aspect_ratio = float(options.width) / float(options.height);
+
+	// outlives the renderer, which may still hand it frames
+	std::unique_ptr<FrameRecorder> recorder;
+	if (!options.capture.empty()) {
+		CaptureFormat format;
+		if (!FrameRecorder::findFormat(options.capture, format))
+			throw std::runtime_error("Unknown capture format " + options.capture + ", expected .png, .exr, .ppm or .raw!");
+		recorder.reset(new FrameRecorder(options.capture, format));
+	}
+
+	Renderer ren(options.width, options.height);
+	ren.setCamera(&cam);
+	ren.setVoxelWorld(world);
+	ren.setTracePath(options.tracePath);
+	ren.setWorkgroupSize(options.workgroup.x, options.workgroup.y);
+	ren.setFramesInFlight(options.framesInFlight);
+	ren.setRenderScale(options.renderScale);
+	ren.setInterleave(options.interleave);
+	ren.setDenoise(options.denoise);
+	ren.settings = options.settings;
+	ren.setQualityTier(options.quality);
+	ren.setSampler(options.sampler);
+	ren.accumulate = false;
+	ren.setFixedSeed(options.seed);
+
+	path.apply(cam, pathTime(path, 0, options.frames));
+	for (int i = 0; i < options.warmup; ++i)
+		ren.render();
+	ren.finish();
+
+	// frame times are taken between consecutive render() calls with the frames in flight kept busy,
+	// so they measure throughput rather than the latency of a single frame
+	ren.getProfiler().resetHistory(size_t(std::max(options.frames, 1)));
+	if (recorder) {
+		ren.setCaptureCallback([&recorder](const float* pixels, uint32_t w, uint32_t h) {
+			recorder->submit(pixels, w, h);
+		});
+	}
+	// only the last measured frame is read back, the copy and memcpy would otherwise cost every frame
+	std::vector<uint8_t> lastFrame;
+	std::vector<double> frameTimes;
+	auto last = std::chrono::steady_clock::now();
+	for (int i = 0; i < options.frames; ++i) {
+		path.apply(cam, pathTime(path, i, options.frames));
+		if (i == options.frames - 1 && !options.output.empty()) {
+			ren.setFrameCallback([&lastFrame](const uint8_t* pixels, uint32_t w, uint32_t h) {
+				lastFrame.assign(pixels, pixels + size_t(w) * h * 4);
+			});
+		}
+		ren.render();
+		const auto now = std::chrono::steady_clock::now();
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(now - last).count());
+		last = now;
+	}
+	ren.finish();
+
+	const VkExtent2D traced = ren.getRenderExtent();
+	const double raysPerFrame = double(traced.width) * traced.height * ren.getTraceSettings().max_samples / options.interleave;
+	report("frame", frameTimes, raysPerFrame);
+	const Profiler& profiler = ren.getProfiler();
+	if (profiler.hasGpuTimes()) {
+		const std::vector<float> traceTimes = profiler.getGpuTimes(GpuSection::TRACE);
+		report("gpu trace", std::vector<double>(traceTimes.begin(), traceTimes.end()), raysPerFrame);
+	}
+	if (options.tracePath == TracePath::WAVEFRONT) {
+		std::cout << "wavefront  " << ren.getWavefrontRounds() << " rounds, " << ren.getWavefrontTruncatedPaths()
+			<< " paths cut short in the last frame" << std::endl;
+	}
+
+	if (recorder) {
+		// only the time the render loop waited counts against the frame rate, encoding what is left happens after
+		std::cout << "capture    " << FrameRecorder::getFormatName(recorder->getFormat()) << ", render loop waited " << recorder->getStallMs() << " ms for the encoders" << std::endl;
+		recorder->finish();
+	}
+
+	if (!options.timings.empty()) {
+		profiler.writeFile(options.timings);
+		std::cout << "Wrote " << options.timings << std::endl;
+	}
+	if (!lastFrame.empty() && !options.output.empty()) {
+		writePPM(options.output, lastFrame.data(), options.width, options.height);
+		std::cout << "Wrote " << options.output << std::endl;
+	}
+
+	return 0;
+}
+
+static int benchCpu(const BenchOptions& options, const VoxelWorld& world, const CameraPath& path)
+{
+	Camera cam;
+	cam.aspect_ratio = float(options.width) / float(options.height);
+
+	CpuTracer tracer(world);
+	if (!options.simd)
+		tracer.isa = SimdIsa::SCALAR;
+	tracer.settings = getBenchSettings(options);
+	tracer.sampler = options.sampler;
+	std::vector<glm::vec4> image;
+
+	path.apply(cam, pathTime(path, 0, options.frames));
+	for (int i = 0; i < options.warmup; ++i) {
+		tracer.settings.time = options.seed + i;
+		tracer.render(cam, options.width, options.height, image);
+	}
+
+	std::vector<double> frameTimes;
+	for (int i = 0; i < options.frames; ++i) {
+		path.apply(cam, pathTime(path, i, options.frames));
+		tracer.settings.time = options.seed + options.warmup + i;
+		const auto start = std::chrono::steady_clock::now();
+		tracer.render(cam, options.width, options.height, image);
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	report("cpu frame", frameTimes, double(options.width) * options.height * tracer.settings.max_samples);
+
+	if (!image.empty() && !options.output.empty()) {
+		std::vector<uint8_t> pixels(image.size() * 4);
+		linearToSRGB8(&image[0].x, image.size(), pixels.data());
+		writePPM(options.output, pixels.data(), options.width, options.height);
+		std::cout << "Wrote " << options.output << std::endl;
+	}
+
+	return 0;
+}
+
+static void printUsage()
+{
+	std::cerr << "Usage: grayv-bench [--scene name|file.gvox|file.vox] [--path file] [--warmup N] [--frames M] [--seed S]" << std::endl
+		<< "                   [--max-steps N] [--max-samples N] [--max-reflections N] [--max-bounces N] [--roulette-depth N]" << std::endl
+		<< "                   [--quality custom|low|medium|high] [--sampler random|sobol|bluenoise] [--width W] [--height H]" << std::endl
+		<< "                   [--cpu [--no-simd] | --compute [--workgroup XxY] | --wavefront] [--frames-in-flight 1-4] [--render-scale S] [--interleave 1|2|4] [--denoise 0-5]" << std::endl
+		<< "                   [--output file.ppm] [--timings file.csv|file.json] [--capture frames.png|.exr|.ppm|.raw]" << std::endl
+		<< "                   [--shader-cache dir | --no-shader-cache]" << std::endl
+		<< "Scenes:";
+	for (const std::string& preset : VoxelWorld::getScenePresets())
+		std::cerr << " " << preset;
+	std::cerr << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--scene" && hasValue) options.scene = argv[++i];
+		else if (arg == "--path" && hasValue) options.pathFile = argv[++i];
+		else if (arg == "--warmup" && hasValue) options.warmup = std::stoi(argv[++i]);
+		else if (arg == "--frames" && hasValue) options.frames = std::stoi(argv[++i]);
+		else if (arg == "--seed" && hasValue) options.seed = std::stoi(argv[++i]);
+		else if (arg == "--max-steps" && hasValue) options.settings.max_steps = std::stoi(argv[++i]);
+		else if (arg == "--max-samples" && hasValue) options.settings.max_samples = std::stoi(argv[++i]);
+		else if (arg == "--max-reflections" && hasValue) options.settings.max_total_reflections = std::stoi(argv[++i]);
+		else if (arg == "--max-bounces" && hasValue) options.settings.max_diffuse_bounces = std::stoi(argv[++i]);
+		else if (arg == "--roulette-depth" && hasValue) options.settings.roulette_depth = std::stoi(argv[++i]);
+		else if (arg == "--quality" && hasValue) {
+			if (!findQualityTier(argv[++i], options.quality)) {
+				std::cerr << "Unknown quality tier " << argv[i] << ", expected custom, low, medium or high" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--sampler" && hasValue) {
+			if (!findSampler(argv[++i], options.sampler)) {
+				std::cerr << "Unknown sampler " << argv[i] << ", expected random, sobol or bluenoise" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--width" && hasValue) options.width = std::stoul(argv[++i]);
+		else if (arg == "--height" && hasValue) options.height = std::stoul(argv[++i]);
+		else if (arg == "--cpu") options.cpu = true;
+		else if (arg == "--no-simd") options.simd = false;
+		else if (arg == "--compute") options.tracePath = TracePath::COMPUTE;
+		else if (arg == "--wavefront") options.tracePath = TracePath::WAVEFRONT;
+		else if (arg == "--workgroup" && hasValue) {
+			if (std::sscanf(argv[++i], "%ux%u", &options.workgroup.x, &options.workgroup.y) != 2) {
+				std::cerr << "Invalid workgroup size " << argv[i] << ", expected XxY" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--frames-in-flight" && hasValue) {
+			options.framesInFlight = std::stoul(argv[++i]);
+			if (options.framesInFlight < 1 || options.framesInFlight > Renderer::MAX_FRAMES_IN_FLIGHT) {
+				std::cerr << "Frames in flight must be between 1 and " << Renderer::MAX_FRAMES_IN_FLIGHT << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--render-scale" && hasValue) options.renderScale = std::stof(argv[++i]);
+		else if (arg == "--interleave" && hasValue) {
+			options.interleave = std::stoul(argv[++i]);
+			if (options.interleave != 1 && options.interleave != 2 && options.interleave != 4) {
+				std::cerr << "Interleave must be 1, 2 or 4" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--denoise" && hasValue) {
+			options.denoise = std::stoul(argv[++i]);
+			if (options.denoise > Renderer::MAX_DENOISE_PASSES) {
+				std::cerr << "Denoise takes 0 to " << Renderer::MAX_DENOISE_PASSES << " passes" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--output" && hasValue) options.output = argv[++i];
+		else if (arg == "--timings" && hasValue) options.timings = argv[++i];
+		else if (arg == "--capture" && hasValue) options.capture = argv[++i];
+		else if (arg == "--shader-cache" && hasValue) Shader::setCacheDirectory(argv[++i]);
+		else if (arg == "--no-shader-cache") Shader::setCacheDirectory("");
+		else {
+			std::cerr << "Unknown argument " << arg << std::endl;
+			printUsage();
+			return 1;
+		}
+	}
+
+	try {
+		const VoxelWorld world = VoxelWorld::createScene(options.scene);
+		const CameraPath path = options.pathFile.empty() ? CameraPath::createOrbit(15.0f, 8.0f, 10.0f) : CameraPath::load(options.pathFile);
+
+		const TraceSettings& settings = getBenchSettings(options);
+		std::cout << "Scene " << options.scene << ", " << (options.pathFile.empty() ? std::string("orbit") : options.pathFile)
+			<< ", " << options.width << "x" << options.height << ", " << options.warmup << " warm-up + " << options.frames << " frames"
+			<< ", max_steps " << settings.max_steps << ", max_samples " << settings.max_samples
+			<< ", max_total_reflections " << settings.max_total_reflections
+			<< ", max_diffuse_bounces " << settings.max_diffuse_bounces << ", roulette_depth " << settings.roulette_depth
+			<< ", quality " << getQualityTierInfo(options.quality).name << ", seed " << options.seed << std::endl;
+
+		return options.cpu ? benchCpu(options, world, path) : benchGpu(options, world, path);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+}
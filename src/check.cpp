@@ -0,0 +1,70 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "CpuTracer.h"
+#include "VoxelWorld.h"
+#include "TraceSettings.h"
+
+// grayv-check: regression check of the CPU reference tracer. Renders small images of the scene presets
+// with scalar traversal and with every packet instruction set the machine supports; the packet kernels
+// round exactly like the scalar path, so the images have to match bit for bit
+
+static const uint32_t WIDTH = 48, HEIGHT = 32;
+
+static std::vector<glm::vec4> renderImage(const VoxelWorld& world, const TraceSettings& settings, SimdIsa isa)
+{
+	Camera cam;
+	cam.aspect_ratio = float(WIDTH) / float(HEIGHT);
+	cam.update();
+
+	CpuTracer tracer(world);
+	tracer.isa = isa;
+	tracer.settings = settings;
+	tracer.sampler = SamplerType::SOBOL;
+	std::vector<glm::vec4> image;
+	tracer.render(cam, WIDTH, HEIGHT, image);
+	return image;
+}
+
+int main()
+{
+	const SimdIsa best = detectSimdIsa();
+	if (best == SimdIsa::SCALAR) {
+		std::cout << "No packet traversal on this machine, nothing to compare" << std::endl;
+		return 0;
+	}
+
+	int failures = 0;
+	try {
+		for (const std::string& preset : VoxelWorld::getScenePresets()) {
+			const VoxelWorld world = VoxelWorld::createScene(preset);
+			for (QualityTier tier : { QualityTier::CUSTOM, QualityTier::LOW }) {
+				TraceSettings settings = getQualityTierInfo(tier).settings;
+				settings.time = 1;
+				const std::vector<glm::vec4> reference = renderImage(world, settings, SimdIsa::SCALAR);
+
+				for (SimdIsa isa : { SimdIsa::SSE41, SimdIsa::AVX2, SimdIsa::AVX512 }) {
+					if (int(isa) > int(best))
+						continue;
+					const std::vector<glm::vec4> image = renderImage(world, settings, isa);
+					size_t mismatches = 0;
+					for (size_t i = 0; i < image.size(); ++i) {
+						if (image[i] != reference[i])
+							++mismatches;
+					}
+					std::cout << preset << ", " << getQualityTierInfo(tier).name << ", " << getSimdIsaName(isa) << ": "
+						<< (mismatches ? std::to_string(mismatches) + " of " + std::to_string(image.size()) + " pixels differ" : std::string("ok"))
+						<< std::endl;
+					if (mismatches)
+						++failures;
+				}
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return failures ? 1 : 0;
+}
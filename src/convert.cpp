@@ -0,0 +1,76 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstring>
+
+#include "VoxelWorld.h"
+#include "VoxelFile.h"
+#include "VoxelStreamer.h"
+
+// grayv-convert: turns MagicaVoxel files, .gvox files and the scene presets into .gvox files
+// or chunk directories for --stream
+
+static void printUsage()
+{
+	std::cerr << "Usage: grayv-convert input.vox|input.gvox|preset [output.gvox] [--chunks dir] [--check]" << std::endl
+		<< "Presets:";
+	for (const std::string& preset : VoxelWorld::getScenePresets())
+		std::cerr << " " << preset;
+	std::cerr << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	std::string input, output, chunks;
+	bool check = false;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--chunks" && i + 1 < argc) chunks = argv[++i];
+		else if (arg == "--check") check = true;
+		else if (arg.rfind("--", 0) != 0 && input.empty()) input = arg;
+		else if (arg.rfind("--", 0) != 0 && output.empty()) output = arg;
+		else {
+			std::cerr << "Unknown argument " << arg << std::endl;
+			printUsage();
+			return 1;
+		}
+	}
+	if (input.empty() || (output.empty() && chunks.empty())) {
+		printUsage();
+		return 1;
+	}
+
+	try {
+		const VoxelWorld world = VoxelWorld::createScene(input);
+		if (!chunks.empty())
+			VoxelStreamer::writeChunks(world, chunks);
+		if (output.empty())
+			return 0;
+		VoxelFile::write(world, output);
+
+		if (check) {
+			// loads the file the way the renderer does and compares it with the source
+			const auto start = std::chrono::steady_clock::now();
+			const VoxelFile file(output);
+			std::vector<uint8_t> loaded(file.getGpuSize());
+			file.writeGpuData(loaded.data());
+			const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			std::vector<uint8_t> expected(world.getGpuSize());
+			world.writeGpuData(expected.data());
+			if (loaded != expected) {
+				std::cerr << "Check failed, " << output << " does not load as the scene it was written from!" << std::endl;
+				return 1;
+			}
+			std::cout << "Checked " << output << ": loaded in " << ms << " ms (" << file.getFileSize() / (ms * 1000.0) << " MB/s from the file, "
+				<< loaded.size() / (ms * 1000.0) << " MB/s decoded)" << std::endl;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
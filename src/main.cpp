@@ -2,12 +2,424 @@
 #include <iostream>
 #include <chrono>
 #include <thread>
+#include <string>
+#include <cstdio>
+#include <memory>
 
 #include "Renderer.h"
+#include "ImageIO.h"
+#include "CpuTracer.h"
+#include "TiledRenderer.h"
+#include "FrameRecorder.h"
+#include "CameraPath.h"
+#include "VoxelStreamer.h"
 #include <imgui.h>
 
-int main()
+// recorder for --capture, the format follows the extension
+static std::unique_ptr<FrameRecorder> createRecorder(const std::string& capture)
 {
+	CaptureFormat format;
+	if (!FrameRecorder::findFormat(capture, format))
+		throw std::runtime_error("Unknown capture format " + capture + ", expected .png, .exr, .ppm or .raw!");
+	std::unique_ptr<FrameRecorder> recorder(new FrameRecorder(capture, format));
+	std::cout << "Capturing " << FrameRecorder::getFormatName(format) << " frames to " << capture << std::endl;
+	return recorder;
+}
+
+static void reportCapture(const FrameRecorder& recorder)
+{
+	std::cout << "Captured " << recorder.getWrittenFrames() << " frames, the render loop waited " << recorder.getStallMs() << " ms for the encoders" << std::endl;
+}
+
+// --scene for the GPU: .gvox files go from the mapping straight into the upload, the renderer starts with the default scene
+static void setScene(Renderer& ren, const std::string& scene)
+{
+	if (VoxelWorld::isSceneFile(scene, ".gvox"))
+		ren.setVoxelFile(VoxelFile(scene));
+	else if (scene != "default")
+		ren.setVoxelWorld(VoxelWorld::createScene(scene));
+}
+
+// --scene for interactive mode, kept on the host to be edited
+static VoxelWorld createEditableScene(const std::string& scene)
+{
+	try {
+		return VoxelWorld::createScene(scene);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << ", showing the default scene" << std::endl;
+		return VoxelWorld::createDefaultScene();
+	}
+}
+
+// streamer for --stream, the budget is in MiB
+static std::unique_ptr<VoxelStreamer> createStreamer(const std::string& directory, glm::ivec3 window, size_t budgetMiB)
+{
+	std::unique_ptr<VoxelStreamer> streamer(new VoxelStreamer(directory, window, budgetMiB << 20));
+	std::cout << "Streaming chunks from " << directory << " in a " << window.x << "x" << window.y << "x" << window.z << " chunk window, " << budgetMiB << " MiB brick pool" << std::endl;
+	return streamer;
+}
+
+// renders a fixed number of frames without a window and writes the last one to disk,
+// cameraPath is played from start to end over the frames; the scene is streamed if streamer is set
+static int runHeadless(uint32_t width, uint32_t height, int frames, const std::string& output, const std::string& scene, TracePath path, glm::uvec2 workgroup,
+	QualityTier quality, SamplerType sampler, uint32_t framesInFlight, float renderScale, float targetMs, uint32_t interleave, uint32_t denoise, const std::string& timings, const std::string& capture,
+	const std::string& cameraPath, VoxelStreamer* streamer)
+{
+	Camera cam;
+	cam.aspect_ratio = float(width) / float(height);
+	cam.update();
+
+	// declared before the renderer, which hands it the frames still in flight when it goes away
+	std::unique_ptr<FrameRecorder> recorder;
+	if (!capture.empty())
+		recorder = createRecorder(capture);
+	std::unique_ptr<CameraPath> animation;
+	if (!cameraPath.empty())
+		animation.reset(new CameraPath(CameraPath::load(cameraPath)));
+
+	Renderer ren(width, height);
+	ren.setCamera(&cam);
+	if (streamer)
+		ren.setVoxelStreamer(streamer);
+	else
+		setScene(ren, scene);
+	ren.setTracePath(path);
+	ren.setWorkgroupSize(workgroup.x, workgroup.y);
+	ren.setQualityTier(quality);
+	ren.setSampler(sampler);
+	ren.setFramesInFlight(framesInFlight);
+	ren.setRenderScale(renderScale);
+	if (targetMs > 0.0f)
+		ren.setAdaptiveResolution(true, targetMs);
+	ren.setInterleave(interleave);
+	ren.setDenoise(denoise);
+
+	std::vector<uint8_t> lastFrame;
+	ren.setFrameCallback([&lastFrame](const uint8_t* pixels, uint32_t w, uint32_t h) {
+		lastFrame.assign(pixels, pixels + size_t(w) * h * 4);
+	});
+	if (recorder) {
+		ren.setCaptureCallback([&recorder](const float* pixels, uint32_t w, uint32_t h) {
+			recorder->submit(pixels, w, h);
+		});
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frames; ++i) {
+		if (animation)
+			animation->apply(cam, animation->getStartTime() + (frames > 1 ? animation->getDuration() * i / (frames - 1) : 0.0f));
+		ren.render();
+	}
+	ren.finish();
+	if (recorder) {
+		recorder->finish();
+		reportCapture(*recorder);
+	}
+	const double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	const std::string pathName = path == TracePath::COMPUTE ? "compute " + std::to_string(workgroup.x) + "x" + std::to_string(workgroup.y)
+		: path == TracePath::WAVEFRONT ? "wavefront" : "fragment";
+	std::cout << "Rendered " << frames << " frames (" << pathName << ") in " << total_ms << " ms (" << total_ms / std::max(frames, 1) << " ms/frame)" << std::endl;
+	if (renderScale != 1.0f || targetMs > 0.0f)
+		std::cout << "Traced at " << ren.getRenderExtent().width << "x" << ren.getRenderExtent().height << " (render scale " << ren.getRenderScale() << ")" << std::endl;
+
+	const Profiler& profiler = ren.getProfiler();
+	if (profiler.hasGpuTimes())
+		std::cout << "GPU trace " << profiler.getGpuMean(GpuSection::TRACE) << " ms/frame (mean of the last " << std::min<size_t>(frames, Profiler::HISTORY_SIZE) << " frames)" << std::endl;
+	if (streamer)
+		std::cout << "Streamed " << streamer->getResidentChunks() << " resident chunks, " << streamer->getPoolUsed() << "/" << streamer->getPoolCapacity() << " pool bricks, "
+			<< streamer->getPendingLoads() << " still loading, " << streamer->getEvictions() << " evictions" << std::endl;
+	if (!timings.empty()) {
+		profiler.writeFile(timings);
+		std::cout << "Wrote " << timings << std::endl;
+	}
+
+	if (!lastFrame.empty() && !output.empty()) {
+		writePPM(output, lastFrame.data(), width, height);
+		std::cout << "Wrote " << output << std::endl;
+	}
+
+	return 0;
+}
+
+// traces frames with the CPU reference tracer, no Vulkan involved
+static int runCpu(uint32_t width, uint32_t height, int frames, const std::string& output, const std::string& scene, bool simd, QualityTier quality,
+	SamplerType sampler)
+{
+	Camera cam;
+	cam.aspect_ratio = float(width) / float(height);
+	cam.update();
+
+	VoxelWorld world = VoxelWorld::createScene(scene);
+	CpuTracer tracer(world);
+	if (!simd)
+		tracer.isa = SimdIsa::SCALAR;
+	if (quality != QualityTier::CUSTOM)
+		tracer.settings = getQualityTierInfo(quality).settings;
+	tracer.sampler = sampler;
+	std::vector<glm::vec4> image;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frames; ++i) {
+		tracer.render(cam, width, height, image);
+	}
+	const double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Traced " << frames << " frames on " << tracer.getThreadCount() << " threads (" << getSimdIsaName(tracer.isa) << ") in " << total_ms << " ms (" << total_ms / std::max(frames, 1) << " ms/frame)" << std::endl;
+
+	if (!image.empty() && !output.empty()) {
+		std::vector<uint8_t> pixels(image.size() * 4);
+		linearToSRGB8(&image[0].x, image.size(), pixels.data());
+		writePPM(output, pixels.data(), width, height);
+		std::cout << "Wrote " << output << std::endl;
+	}
+
+	return 0;
+}
+
+// renders a still of any size tile by tile into output, frames are accumulated per tile
+static int runTiled(uint32_t width, uint32_t height, uint32_t tileSize, int frames, const std::string& output, const std::string& scene, bool resume,
+	bool cpu, bool simd, TracePath path, glm::uvec2 workgroup, QualityTier quality, SamplerType sampler, uint32_t framesInFlight)
+{
+	Camera cam;
+	cam.aspect_ratio = float(width) / float(height);
+	cam.update();
+
+	TiledRenderer tiled(width, height, tileSize);
+	const uint32_t passes = uint32_t(std::max(frames, 1));
+	const auto start = std::chrono::steady_clock::now();
+	uint32_t rendered;
+
+	if (cpu) {
+		VoxelWorld world = VoxelWorld::createScene(scene);
+		CpuTracer tracer(world);
+		if (!simd)
+			tracer.isa = SimdIsa::SCALAR;
+		if (quality != QualityTier::CUSTOM)
+			tracer.settings = getQualityTierInfo(quality).settings;
+		tracer.sampler = sampler;
+		std::vector<glm::vec4> image, sum;
+
+		rendered = tiled.render(cam, output, resume, [&](const Camera& tileCam, uint32_t size, uint32_t tileIndex, uint8_t* rgba) {
+			sum.assign(size_t(size) * size, glm::vec4(0.0f));
+			// the passes continue one sequence of samples, like the accumulation on the GPU
+			tracer.settings.time = int(tileIndex * passes + 1);
+			for (uint32_t i = 0; i < passes; ++i) {
+				tracer.accumulatedFrames = i;
+				tracer.render(tileCam, size, size, image);
+				for (size_t p = 0; p < sum.size(); ++p)
+					sum[p] += image[p] / float(passes);
+			}
+			linearToSRGB8(&sum[0].x, sum.size(), rgba);
+		});
+	}
+	else {
+		// every render() is a submission of its own, the tile size bounds the work per submission
+		Camera tileCam;
+		Renderer ren(tileSize, tileSize);
+		ren.setCamera(&tileCam);
+		setScene(ren, scene);
+		ren.setTracePath(path);
+		ren.setWorkgroupSize(workgroup.x, workgroup.y);
+		ren.setQualityTier(quality);
+		ren.setSampler(sampler);
+		ren.setFramesInFlight(framesInFlight);
+		ren.accumulate = true;
+
+		std::vector<uint8_t> lastFrame;
+		ren.setFrameCallback([&lastFrame](const uint8_t* pixels, uint32_t w, uint32_t h) {
+			lastFrame.assign(pixels, pixels + size_t(w) * h * 4);
+		});
+
+		rendered = tiled.render(cam, output, resume, [&](const Camera& camera, uint32_t size, uint32_t tileIndex, uint8_t* rgba) {
+			// the new frustum restarts the accumulation
+			tileCam = camera;
+			ren.setFixedSeed(int32_t(tileIndex * passes + 1));
+			for (uint32_t i = 0; i < passes; ++i)
+				ren.render();
+			ren.finish();
+			std::copy(lastFrame.begin(), lastFrame.begin() + size_t(size) * size * 4, rgba);
+		});
+	}
+
+	const double total_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Rendered " << rendered << " tiles with " << passes << " frames each in " << total_s << " s, wrote " << output << std::endl;
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	bool headless = false;
+	bool cpu = false;
+	bool simd = true;
+	TracePath path = TracePath::FRAGMENT;
+	glm::uvec2 workgroup(8, 8);
+	QualityTier quality = QualityTier::CUSTOM;
+	SamplerType sampler = SamplerType::SOBOL;
+	uint32_t framesInFlight = 2;
+	std::string presentMode;
+	float renderScale = 1.0f;
+	float targetMs = 0.0f;              // > 0: adaptive resolution
+	uint32_t interleave = 1;
+	uint32_t denoise = 0;               // a-trous passes
+	uint32_t width = 1280, height = 720;
+	int frames = 1;
+	std::string output = "frame.ppm";
+	std::string scene = "default";
+	std::string timings;
+	std::string capture;
+	std::string cameraPath;
+	bool tiled = false;
+	uint32_t tileSize = 512;
+	bool resume = false;
+	std::string streamDirectory;
+	size_t streamBudget = 256;          // MiB
+	glm::ivec3 streamWindow(8, 4, 8);
+	std::string terrainDirectory;
+	int terrainChunks = 16;
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--headless") headless = true;
+		else if (arg == "--cpu") cpu = true;
+		else if (arg == "--tiled") tiled = true;
+		else if (arg == "--tile" && i + 1 < argc) tileSize = std::stoul(argv[++i]);
+		else if (arg == "--resume") resume = true;
+		else if (arg == "--no-simd") simd = false;
+		else if (arg == "--compute") path = TracePath::COMPUTE;
+		else if (arg == "--wavefront") path = TracePath::WAVEFRONT;
+		else if (arg == "--workgroup" && i + 1 < argc) {
+			if (std::sscanf(argv[++i], "%ux%u", &workgroup.x, &workgroup.y) != 2) {
+				std::cerr << "Invalid workgroup size " << argv[i] << ", expected XxY" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--quality" && i + 1 < argc) {
+			if (!findQualityTier(argv[++i], quality)) {
+				std::cerr << "Unknown quality tier " << argv[i] << ", expected custom, low, medium or high" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--sampler" && i + 1 < argc) {
+			if (!findSampler(argv[++i], sampler)) {
+				std::cerr << "Unknown sampler " << argv[i] << ", expected random, sobol or bluenoise" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--frames-in-flight" && i + 1 < argc) {
+			framesInFlight = std::stoul(argv[++i]);
+			if (framesInFlight < 1 || framesInFlight > Renderer::MAX_FRAMES_IN_FLIGHT) {
+				std::cerr << "Frames in flight must be between 1 and " << Renderer::MAX_FRAMES_IN_FLIGHT << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--present-mode" && i + 1 < argc) presentMode = argv[++i];
+		else if (arg == "--render-scale" && i + 1 < argc) renderScale = std::stof(argv[++i]);
+		else if (arg == "--target-ms" && i + 1 < argc) targetMs = std::stof(argv[++i]);
+		else if (arg == "--interleave" && i + 1 < argc) {
+			interleave = std::stoul(argv[++i]);
+			if (interleave != 1 && interleave != 2 && interleave != 4) {
+				std::cerr << "Interleave must be 1, 2 or 4" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--denoise" && i + 1 < argc) {
+			denoise = std::stoul(argv[++i]);
+			if (denoise > Renderer::MAX_DENOISE_PASSES) {
+				std::cerr << "Denoise takes 0 to " << Renderer::MAX_DENOISE_PASSES << " passes" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--width" && i + 1 < argc) width = std::stoul(argv[++i]);
+		else if (arg == "--height" && i + 1 < argc) height = std::stoul(argv[++i]);
+		else if (arg == "--frames" && i + 1 < argc) frames = std::stoi(argv[++i]);
+		else if (arg == "--output" && i + 1 < argc) output = argv[++i];
+		else if (arg == "--scene" && i + 1 < argc) scene = argv[++i];
+		else if (arg == "--timings" && i + 1 < argc) timings = argv[++i];
+		else if (arg == "--capture" && i + 1 < argc) capture = argv[++i];
+		else if (arg == "--path" && i + 1 < argc) cameraPath = argv[++i];
+		else if (arg == "--stream" && i + 1 < argc) streamDirectory = argv[++i];
+		else if (arg == "--stream-budget" && i + 1 < argc) streamBudget = std::stoul(argv[++i]);
+		else if (arg == "--stream-window" && i + 1 < argc) {
+			if (std::sscanf(argv[++i], "%dx%dx%d", &streamWindow.x, &streamWindow.y, &streamWindow.z) != 3) {
+				std::cerr << "Invalid stream window " << argv[i] << ", expected XxYxZ" << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--generate-terrain" && i + 1 < argc) terrainDirectory = argv[++i];
+		else if (arg == "--chunks" && i + 1 < argc) terrainChunks = std::stoi(argv[++i]);
+		else if (arg == "--shader-cache" && i + 1 < argc) Shader::setCacheDirectory(argv[++i]);
+		else if (arg == "--no-shader-cache") Shader::setCacheDirectory("");
+		else {
+			std::cerr << "Unknown argument " << arg << std::endl;
+			std::cerr << "Usage: GRayV [--headless | --cpu [--no-simd]] [--tiled [--tile N] [--resume]] [--compute [--workgroup XxY] | --wavefront] [--quality custom|low|medium|high] [--sampler random|sobol|bluenoise] [--frames-in-flight 1-4] [--present-mode fifo|mailbox|immediate] [--render-scale S | --target-ms T] [--interleave 1|2|4] [--denoise 0-5] [--width W] [--height H] [--frames N] [--output file.ppm] [--scene name|file.gvox|file.vox] [--timings file.csv|file.json] [--capture frames.png|.exr|.ppm|.raw] [--path file] [--stream dir [--stream-budget MiB] [--stream-window XxYxZ]] [--generate-terrain dir [--chunks N]] [--shader-cache dir | --no-shader-cache]" << std::endl;
+			return 1;
+		}
+	}
+
+	if (!terrainDirectory.empty()) {
+		try {
+			VoxelStreamer::generateTerrain(terrainDirectory, terrainChunks);
+			return 0;
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	// declared before the renderer, which streams from it until it goes away; tiles and the CPU tracer use the built-in scene
+	std::unique_ptr<VoxelStreamer> streamer;
+	if (!streamDirectory.empty() && !cpu && !tiled) {
+		try {
+			streamer = createStreamer(streamDirectory, streamWindow, streamBudget);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	if (tiled) {
+		try {
+			return runTiled(width, height, tileSize, frames, output, scene, resume, cpu, simd, path, workgroup, quality, sampler, framesInFlight);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+	if (cpu) {
+		try {
+			return runCpu(width, height, frames, output, scene, simd, quality, sampler);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+	if (headless) {
+		try {
+			return runHeadless(width, height, frames, output, scene, path, workgroup, quality, sampler, framesInFlight, renderScale, targetMs, interleave, denoise, timings, capture, cameraPath, streamer.get());
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	std::unique_ptr<FrameRecorder> recorder;
+	if (!capture.empty()) {
+		try {
+			recorder = createRecorder(capture);
+		}
+		catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
 	// initialize GLFW
 	glfwInit();
 
@@ -20,6 +432,41 @@ int main()
 
 	Renderer ren(window);
 	ren.setCamera(&cam);
+	// the scene stays on the host for editing unless it is streamed
+	VoxelWorld world = streamer ? VoxelWorld::createDefaultScene() : createEditableScene(scene);
+	if (streamer)
+		ren.setVoxelStreamer(streamer.get());
+	else
+		ren.setEditableVoxelWorld(&world);
+	ren.setTracePath(path);
+	ren.setWorkgroupSize(workgroup.x, workgroup.y);
+	ren.setQualityTier(quality);
+	ren.setSampler(sampler);
+	ren.setFramesInFlight(framesInFlight);
+	ren.setRenderScale(renderScale);
+	if (targetMs > 0.0f)
+		ren.setAdaptiveResolution(true, targetMs);
+	ren.setInterleave(interleave);
+	ren.setDenoise(denoise);
+	if (!presentMode.empty()) {
+		const std::vector<VkPresentModeKHR> modes = ren.getSupportedPresentModes();
+		auto mode = std::find_if(modes.begin(), modes.end(), [&](VkPresentModeKHR m) { return presentMode == Renderer::getPresentModeName(m); });
+		if (mode != modes.end())
+			ren.setPresentMode(*mode);
+		else
+			std::cerr << "Present mode " << presentMode << " is not supported here, using " << Renderer::getPresentModeName(ren.getPresentMode()) << std::endl;
+	}
+	// F9 starts and stops recording
+	bool recording = bool(recorder);
+	auto setRecording = [&](bool on) {
+		recording = on;
+		if (on)
+			ren.setCaptureCallback([&recorder](const float* pixels, uint32_t w, uint32_t h) { recorder->submit(pixels, w, h); });
+		else
+			ren.setCaptureCallback(nullptr);
+	};
+	if (recorder)
+		setRecording(true);
 
 	double time = glfwGetTime() * 1000;
 	const float default_camera_movement_speed = 0.005;
@@ -31,6 +478,29 @@ int main()
 
 		glfwPollEvents();
 
+		static bool f9WasDown = false;
+		const bool f9Down = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+		if (recorder && f9Down && !f9WasDown) {
+			setRecording(!recording);
+			std::cout << (recording ? "Recording" : "Paused recording") << " at frame " << recorder->getSubmittedFrames() << std::endl;
+		}
+		f9WasDown = f9Down;
+
+		// edits at the voxel in the center of the view: right click digs, E builds, Q pours water
+		static bool editWasDown = false;
+		const bool digDown = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+		const bool buildDown = glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS;
+		const bool waterDown = glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS;
+		glm::ivec3 hit, previous;
+		if (!streamer && !editWasDown && !ImGui::GetIO().WantCaptureMouse && (digDown || buildDown || waterDown)
+			&& world.raycast(cam.pos, cam.dir, 256.0f, hit, previous)) {
+			if (digDown)
+				world.fillSphere(glm::vec3(hit) + 0.5f, 3.0f, VOXEL_EMPTY);
+			else
+				world.fillSphere(glm::vec3(previous) + 0.5f, 2.0f, buildDown ? VOXEL_SOLID : VOXEL_WATER);
+		}
+		editWasDown = digDown || buildDown || waterDown;
+
 		auto& io = ImGui::GetIO();
 		if (!io.WantCaptureMouse && !io.WantCaptureKeyboard) {
 			if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
@@ -70,9 +540,16 @@ int main()
 			cam.update();
 		}
 
+		ren.reloadModifiedShaders();
 		ren.render();
 	}
 
+	if (recorder) {
+		ren.finish();
+		recorder->finish();
+		reportCapture(*recorder);
+	}
+
 	// terminate GLFW
 	glfwDestroyWindow(window);
 	glfwTerminate();